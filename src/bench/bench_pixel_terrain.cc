@@ -0,0 +1,397 @@
+// SPDX-License-Identifier: MIT
+
+/* Benchmarks of each stage of image generation, and whole region render.
+   Inputs are generated by synthetic_region, so results are comparable
+   between runs as long as the same parameters are used. */
+
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <memory_resource>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include <regetopt.h>
+
+#include "bench/synthetic_region.hh"
+#include "config.h"
+#include "graphics/color.hh"
+#include "graphics/png.hh"
+#include "image/containers.hh"
+#include "image/worker.hh"
+#include "nbt/chunk.hh"
+#include "nbt/constants.hh"
+#include "nbt/pull_parser/nbt_pull_parser.hh"
+#include "nbt/region.hh"
+#include "nbt/unpack.hh"
+#include "nbt/utils.hh"
+#include "utils/array.hh"
+
+namespace pixel_terrain::bench {
+    class worker_bench {
+        image::worker worker_;
+        image::options options_;
+        image::worker::pixel_states *states_;
+
+    public:
+        worker_bench() : states_(new image::worker::pixel_states) {}
+        ~worker_bench() { delete states_; }
+
+        worker_bench(worker_bench const &) = delete;
+        auto operator=(worker_bench const &) -> worker_bench & = delete;
+
+        auto scan_chunk(anvil::chunk *chunk) -> std::uint32_t {
+            for (int z = 0; z < nbt::biomes::CHUNK_WIDTH; ++z) {
+                for (int x = 0; x < nbt::biomes::CHUNK_WIDTH; ++x) {
+                    image::worker::get_pixel_state(states_, x, z) = {};
+                }
+            }
+            image::worker::unknown_block_map unknown_blocks;
+            image::worker::scan_chunk(chunk, 0, 0, states_, &unknown_blocks,
+                                      options_);
+            return image::worker::get_pixel_state(states_, 0, 0).bg_color();
+        }
+
+        void generate_region(std::filesystem::path const &region_file,
+                             std::filesystem::path const &out_file) {
+            auto *item = new image::region_container(
+                new anvil::region(region_file), options_, out_file);
+            worker_.generate_region(item);
+            delete item;
+        }
+    };
+} // namespace pixel_terrain::bench
+
+namespace {
+    using namespace pixel_terrain;
+
+    struct result {
+        std::string name;
+        std::uint64_t iterations;
+        double ns_per_op;
+        std::size_t bytes_per_op;
+    };
+
+    std::chrono::milliseconds min_time(500);
+    std::string filter;
+    std::vector<result> results;
+
+    /* Results of benchmarked functions are accumulated here so that the
+       compiler can't discard the calls. */
+    volatile std::uint64_t sink;
+
+    template <typename F>
+    void run(std::string const &name, std::size_t bytes_per_op, F &&f) {
+        if (!filter.empty() && name.find(filter) == std::string::npos) {
+            return;
+        }
+
+        std::fprintf(stderr, "Running %s...\n", name.c_str());
+
+        /* warm-up */
+        sink = sink + f();
+
+        std::uint64_t iterations = 0;
+        auto start = std::chrono::steady_clock::now();
+        std::chrono::steady_clock::duration elapsed;
+        do {
+            sink = sink + f();
+            ++iterations;
+            elapsed = std::chrono::steady_clock::now() - start;
+        } while (elapsed < min_time);
+
+        double ns =
+            std::chrono::duration_cast<std::chrono::nanoseconds>(elapsed)
+                .count();
+        results.push_back({name, iterations, ns / iterations, bytes_per_op});
+    }
+
+    void write_json(std::ostream &out, bench::region_spec const &spec) {
+        constexpr double nanos_per_sec = 1e9;
+        constexpr double bytes_per_mib = 1024.0 * 1024.0;
+
+        out << "{\n";
+        out << "  \"context\": {\n";
+        out << "    \"version\": \"" << VERSION_MAJOR << '.' << VERSION_MINOR
+            << '.' << VERSION_REVISION << "\",\n";
+        out << "    \"seed\": " << spec.seed << ",\n";
+        out << "    \"palette_size\": " << spec.palette_size << ",\n";
+        out << "    \"sections\": " << spec.n_sections << ",\n";
+        out << "    \"compression_level\": " << spec.compression_level
+            << ",\n";
+        out << "    \"data_version\": " << spec.data_version << "\n";
+        out << "  },\n";
+        out << "  \"benchmarks\": [";
+        for (std::size_t i = 0; i < results.size(); ++i) {
+            result const &r = results[i];
+            out << (i == 0 ? "\n" : ",\n");
+            out << "    {\"name\": \"" << r.name << "\", ";
+            out << "\"iterations\": " << r.iterations << ", ";
+            out << "\"ns_per_op\": " << r.ns_per_op << ", ";
+            out << "\"bytes_per_op\": " << r.bytes_per_op << ", ";
+            out << "\"mib_per_sec\": "
+                << (r.ns_per_op == 0 ? 0
+                                     : r.bytes_per_op / bytes_per_mib *
+                                           nanos_per_sec / r.ns_per_op)
+                << "}";
+        }
+        out << "\n  ]\n}\n";
+    }
+
+    void run_all(bench::region_spec const &spec,
+                 std::filesystem::path const &work_dir) {
+        std::vector<std::uint8_t> raw = bench::make_chunk_nbt(spec, 0, 0);
+        std::vector<std::uint8_t> compressed =
+            nbt::utils::zlib_compress(raw.data(), raw.size());
+
+        run("zlib_decompress", compressed.size(), [&]() -> std::uint64_t {
+            std::vector<std::uint8_t> *data = nbt::utils::zlib_decompress(
+                compressed.data(), compressed.size());
+            std::uint64_t size = data->size();
+            delete data;
+            return size;
+        });
+
+        run("nbt_pull_parser", raw.size(), [&]() -> std::uint64_t {
+            nbt::nbt_pull_parser parser(raw.data(), raw.size());
+            std::uint64_t n_events = 0;
+            while (parser.next() != nbt::parser_event::DOCUMENT_END) {
+                ++n_events;
+            }
+            return n_events;
+        });
+
+        {
+            unsigned int bits = anvil::bits_per_entry(spec.palette_size);
+            bool stretches =
+                spec.data_version <
+                nbt::biomes::NEED_STRETCH_DATA_VERSION_THRESHOLD;
+            std::size_t n_words =
+                stretches ? anvil::BLOCK_STATES_ENTRIES * bits / 64
+                          : anvil::BLOCK_STATES_ENTRIES / (64 / bits) + 1;
+            std::vector<std::uint64_t> words(n_words);
+            for (std::size_t i = 0; i < n_words; ++i) {
+                words[i] = (i + 1) * 0x9e3779b97f4a7c15ULL;
+            }
+            std::vector<std::uint16_t> out(anvil::BLOCK_STATES_ENTRIES);
+
+            if (anvil::unpack_func unpack =
+                    anvil::get_unpacker(bits, stretches)) {
+                run("unpack_section", n_words * sizeof(std::uint64_t),
+                    [&]() -> std::uint64_t {
+                        unpack(words.data(), words.size(), out.data());
+                        return out[anvil::BLOCK_STATES_ENTRIES - 1];
+                    });
+            }
+            run("unpack_section_generic", n_words * sizeof(std::uint64_t),
+                [&]() -> std::uint64_t {
+                    anvil::unpack_generic(words.data(), words.size(), bits,
+                                          stretches, out.data());
+                    return out[anvil::BLOCK_STATES_ENTRIES - 1];
+                });
+        }
+
+        auto *chunk = new anvil::chunk(
+            std::pmr::vector<std::uint8_t>(raw.begin(), raw.end()));
+        int max_y = spec.n_sections * nbt::biomes::CHUNK_WIDTH;
+        run("chunk_get_block", 0, [&]() -> std::uint64_t {
+            std::uint64_t total = 0;
+            for (int y = 0; y < max_y; ++y) {
+                for (int z = 0; z < nbt::biomes::CHUNK_WIDTH; ++z) {
+                    for (int x = 0; x < nbt::biomes::CHUNK_WIDTH; ++x) {
+                        total += chunk->get_block(x, y, z).size();
+                    }
+                }
+            }
+            return total;
+        });
+
+        {
+            bench::worker_bench worker;
+            run("scan_chunk", 0, [&]() -> std::uint64_t {
+                return worker.scan_chunk(chunk);
+            });
+        }
+        delete chunk;
+
+        constexpr std::size_t n_colors = 1 << 16;
+        std::vector<std::uint32_t> colors(n_colors);
+        for (std::size_t i = 0; i < n_colors; ++i) {
+            /* arbitrary colors with various alpha */
+            colors[i] = static_cast<std::uint32_t>(i * 2654435761U);
+        }
+        run("blend_color", n_colors * sizeof(std::uint32_t),
+            [&]() -> std::uint64_t {
+                std::uint64_t total = 0;
+                for (std::size_t i = 1; i < n_colors; ++i) {
+                    total += graphics::blend_color(colors[i - 1], colors[i]);
+                }
+                return total;
+            });
+
+        {
+            graphics::png image(nbt::biomes::BLOCK_PER_REGION_WIDTH,
+                                nbt::biomes::BLOCK_PER_REGION_WIDTH);
+            for (int y = 0; y < nbt::biomes::BLOCK_PER_REGION_WIDTH; ++y) {
+                for (int x = 0; x < nbt::biomes::BLOCK_PER_REGION_WIDTH;
+                     ++x) {
+                    image.set_pixel(
+                        x, y,
+                        colors[(y * nbt::biomes::BLOCK_PER_REGION_WIDTH + x) %
+                               n_colors] |
+                            0xff);
+                }
+            }
+            std::filesystem::path out = work_dir / "png_save.png";
+            run("png_save",
+                nbt::biomes::BLOCK_PER_REGION_WIDTH *
+                    nbt::biomes::BLOCK_PER_REGION_WIDTH *
+                    sizeof(std::uint32_t),
+                [&]() -> std::uint64_t { return image.save(out) ? 1 : 0; });
+        }
+
+        std::filesystem::path region_file =
+            bench::write_region(work_dir, spec);
+        std::filesystem::path out = work_dir / "region_render.png";
+        {
+            bench::worker_bench worker;
+            run("region_render", std::filesystem::file_size(region_file),
+                [&]() -> std::uint64_t {
+                    std::filesystem::remove(out);
+                    worker.generate_region(region_file, out);
+                    return std::filesystem::exists(out) ? 1 : 0;
+                });
+        }
+    }
+
+    void print_usage() {
+        std::cout << &R"(
+Usage: bench_pixel_terrain [option]...
+
+Run benchmarks of pixel-terrain and print results as JSON.
+
+      --compression-level=N  zlib compression level of generated chunks.
+      --data-version=N       DataVersion of generated chunks.
+      --filter=NAME          Run only benchmarks whose name contains NAME.
+      --generate=DIR         Write synthetic region to DIR and exit.
+      --min-time=MS          Run each benchmark for at least MS milliseconds.
+  -o FILE, --out=FILE        Write results to FILE instead of stdout.
+      --palette-size=N       Number of palette entries in each section.
+      --sections=N           Number of sections in each chunk.
+      --seed=N               Seed of generated region.
+      --help                 Print this usage and exit.
+ )"[1];
+    }
+
+    auto long_options = pixel_terrain::make_array<::re_option>(
+        ::re_option{"compression-level", re_required_argument, nullptr, 'z'},
+        ::re_option{"data-version", re_required_argument, nullptr, 'D'},
+        ::re_option{"filter", re_required_argument, nullptr, 'f'},
+        ::re_option{"generate", re_required_argument, nullptr, 'G'},
+        ::re_option{"min-time", re_required_argument, nullptr, 't'},
+        ::re_option{"out", re_required_argument, nullptr, 'o'},
+        ::re_option{"palette-size", re_required_argument, nullptr, 'p'},
+        ::re_option{"sections", re_required_argument, nullptr, 's'},
+        ::re_option{"seed", re_required_argument, nullptr, 'S'},
+        ::re_option{"help", re_no_argument, nullptr, 'h'},
+        ::re_option{nullptr, 0, nullptr, 0});
+} // namespace
+
+auto main(int argc, char **argv) -> int {
+    bench::region_spec spec;
+    std::filesystem::path out_file;
+    std::filesystem::path generate_dir;
+
+    try {
+        for (;;) {
+            int opt =
+                regetopt(argc, argv, "o:", long_options.data(), nullptr);
+            if (opt < 0) {
+                break;
+            }
+
+            switch (opt) {
+            case 'z':
+                spec.compression_level = std::stoi(::re_optarg);
+                break;
+
+            case 'D':
+                spec.data_version = std::stoi(::re_optarg);
+                break;
+
+            case 'f':
+                filter = ::re_optarg;
+                break;
+
+            case 'G':
+                generate_dir = ::re_optarg;
+                break;
+
+            case 't':
+                min_time = std::chrono::milliseconds(std::stoi(::re_optarg));
+                break;
+
+            case 'o':
+                out_file = ::re_optarg;
+                break;
+
+            case 'p':
+                spec.palette_size = std::stoi(::re_optarg);
+                break;
+
+            case 's':
+                spec.n_sections = std::stoi(::re_optarg);
+                break;
+
+            case 'S':
+                spec.seed = std::stoull(::re_optarg);
+                break;
+
+            case 'h':
+                print_usage();
+                return 0;
+
+            default:
+                return 1;
+            }
+        }
+    } catch (std::logic_error const &) {
+        std::cerr << "Invalid argument.\n";
+        return 1;
+    }
+
+    try {
+        if (!generate_dir.empty()) {
+            std::filesystem::create_directories(generate_dir);
+            std::cout << bench::write_region(generate_dir, spec).string()
+                      << '\n';
+            return 0;
+        }
+
+        std::filesystem::path work_dir =
+            std::filesystem::temp_directory_path() / "pixel_terrain_bench";
+        std::filesystem::remove_all(work_dir);
+        std::filesystem::create_directories(work_dir);
+
+        run_all(spec, work_dir);
+
+        std::filesystem::remove_all(work_dir);
+    } catch (std::exception const &e) {
+        std::cerr << e.what() << '\n';
+        return 1;
+    }
+
+    if (out_file.empty()) {
+        write_json(std::cout, spec);
+    } else {
+        std::ofstream out(out_file);
+        write_json(out, spec);
+    }
+
+    return 0;
+}
@@ -0,0 +1,390 @@
+// SPDX-License-Identifier: MIT
+
+/* Deterministic generator of region files, used by benchmarks.
+   Chunks are written in the same format as Minecraft 1.16 writes, i.e.
+   Level.Sections with Palette and BlockStates, or as 1.18 writes, i.e.
+   sections with block_states and biomes at root, depending on data
+   version. */
+
+#include <algorithm>
+#include <array>
+#include <bit>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include <zlib.h>
+
+#include "bench/synthetic_region.hh"
+#include "nbt/constants.hh"
+#include "nbt/pull_parser/nbt_pull_parser.hh"
+
+namespace pixel_terrain::bench {
+    namespace {
+        constexpr std::size_t SECTOR_SIZE = 4096;
+        constexpr int ZLIB_COMPRESSION = 2;
+        constexpr int SECTION_HEIGHT = 16;
+        constexpr int BIOMES_LEN = 1024;
+        constexpr int STRETCH_DATA_VERSION_THRESHOLD = 2529;
+        constexpr int ROOT_SECTIONS_DATA_VERSION = 2844;
+        constexpr int BIOMES_PER_SECTION = 4 * 4 * 4;
+
+        constexpr int MAX_PALETTE_SIZE = 4096;
+        /* One in this many columns is covered with water. */
+        constexpr int WATER_RATIO = 8;
+
+        /* Palette of every section is air, grass block, water, followed by
+           blocks below, repeated as many times as needed to fill palette of
+           requested size. */
+        constexpr int PALETTE_GRASS = 1;
+        constexpr int PALETTE_WATER = 2;
+        constexpr int PALETTE_FILL = 3;
+        constexpr std::array<char const *, 14> FILL_BLOCKS = {
+            "minecraft:stone",       "minecraft:dirt",
+            "minecraft:gravel",      "minecraft:andesite",
+            "minecraft:diorite",     "minecraft:granite",
+            "minecraft:coal_ore",    "minecraft:iron_ore",
+            "minecraft:gold_ore",    "minecraft:clay",
+            "minecraft:sand",        "minecraft:sandstone",
+            "minecraft:cobblestone", "minecraft:oak_log",
+        };
+
+        auto mix(std::uint64_t x) -> std::uint64_t {
+            /* splitmix64 */
+            x += 0x9e3779b97f4a7c15ULL;
+            x = (x ^ (x >> 30U)) * 0xbf58476d1ce4e5b9ULL;
+            x = (x ^ (x >> 27U)) * 0x94d049bb133111ebULL;
+            return x ^ (x >> 31U);
+        }
+
+        auto hash(std::uint64_t seed, int x, int y, int z) -> std::uint64_t {
+            return mix(seed ^ mix(static_cast<std::uint32_t>(x) ^
+                                  mix(static_cast<std::uint32_t>(y) ^
+                                      mix(static_cast<std::uint32_t>(z)))));
+        }
+
+        /* Minimal big endian NBT writer. */
+        class nbt_writer {
+            std::vector<std::uint8_t> out_;
+
+            template <typename T> void put(T value) {
+                for (int i = sizeof(T) - 1; i >= 0; --i) {
+                    out_.push_back(
+                        static_cast<std::uint8_t>(value >> (i * 8)));
+                }
+            }
+
+            void put_string(std::string const &s) {
+                put<std::uint16_t>(s.size());
+                out_.insert(out_.end(), s.begin(), s.end());
+            }
+
+            void header(unsigned char type, std::string const &name) {
+                out_.push_back(type);
+                put_string(name);
+            }
+
+        public:
+            void begin_compound(std::string const &name) {
+                header(nbt::TAG_COMPOUND, name);
+            }
+
+            void end_compound() { out_.push_back(nbt::TAG_END); }
+
+            void begin_list(std::string const &name, unsigned char type,
+                            int n) {
+                header(nbt::TAG_LIST, name);
+                out_.push_back(type);
+                put<std::int32_t>(n);
+            }
+
+            void put_byte(std::string const &name, std::int8_t value) {
+                header(nbt::TAG_BYTE, name);
+                put<std::uint8_t>(value);
+            }
+
+            void put_int(std::string const &name, std::int32_t value) {
+                header(nbt::TAG_INT, name);
+                put<std::uint32_t>(value);
+            }
+
+            void put_long(std::string const &name, std::int64_t value) {
+                header(nbt::TAG_LONG, name);
+                put<std::uint64_t>(value);
+            }
+
+            void put_string(std::string const &name, std::string const &value) {
+                header(nbt::TAG_STRING, name);
+                put_string(value);
+            }
+
+            /* Write string element of a list. */
+            void put_list_string(std::string const &value) {
+                put_string(value);
+            }
+
+            void put_int_array(std::string const &name,
+                               std::vector<std::int32_t> const &values) {
+                header(nbt::TAG_INT_ARRAY, name);
+                put<std::int32_t>(values.size());
+                for (std::int32_t v : values) {
+                    put<std::uint32_t>(v);
+                }
+            }
+
+            void put_long_array(std::string const &name,
+                                std::vector<std::uint64_t> const &values) {
+                header(nbt::TAG_LONG_ARRAY, name);
+                put<std::int32_t>(values.size());
+                for (std::uint64_t v : values) {
+                    put<std::uint64_t>(v);
+                }
+            }
+
+            auto take() -> std::vector<std::uint8_t> { return std::move(out_); }
+        };
+
+        auto pack(std::vector<std::uint16_t> const &indices, int bits,
+                  bool stretch) -> std::vector<std::uint64_t> {
+            std::vector<std::uint64_t> result;
+            if (stretch) {
+                result.resize((indices.size() * bits + 63) / 64);
+                for (std::size_t i = 0; i < indices.size(); ++i) {
+                    std::size_t bit = i * bits;
+                    std::uint64_t v = indices[i];
+                    result[bit / 64] |= v << (bit % 64);
+                    if (bit % 64 + bits > 64) {
+                        result[bit / 64 + 1] |= v >> (64 - bit % 64);
+                    }
+                }
+            } else {
+                std::size_t per_long = 64 / bits;
+                result.resize((indices.size() + per_long - 1) / per_long);
+                for (std::size_t i = 0; i < indices.size(); ++i) {
+                    result[i / per_long] |= static_cast<std::uint64_t>(
+                                                indices[i])
+                                            << (i % per_long * bits);
+                }
+            }
+            return result;
+        }
+
+        /* Height of the surface of the column. */
+        auto surface_height(region_spec const &spec, int x, int z) -> int {
+            int max_y = spec.n_sections * SECTION_HEIGHT;
+            int range = max_y / 4 + 1;
+            return max_y - 1 - static_cast<int>(hash(spec.seed, x, -1, z) %
+                                                static_cast<unsigned>(range));
+        }
+    } // namespace
+
+    auto make_chunk_nbt(region_spec const &spec, int chunk_x, int chunk_z)
+        -> std::vector<std::uint8_t> {
+        if (spec.palette_size < 2 || MAX_PALETTE_SIZE < spec.palette_size) {
+            throw std::invalid_argument("palette size is out of range");
+        }
+
+        int global_x = (spec.region_x * nbt::biomes::CHUNK_PER_REGION_WIDTH +
+                        chunk_x) *
+                       nbt::biomes::CHUNK_WIDTH;
+        int global_z = (spec.region_z * nbt::biomes::CHUNK_PER_REGION_WIDTH +
+                        chunk_z) *
+                       nbt::biomes::CHUNK_WIDTH;
+
+        int n_fill = std::max(spec.palette_size - PALETTE_FILL, 0);
+        int bits = std::max(
+            4, static_cast<int>(std::bit_width(
+                   static_cast<unsigned>(spec.palette_size - 1))));
+        bool stretch = spec.data_version < STRETCH_DATA_VERSION_THRESHOLD;
+
+        std::array<int, nbt::biomes::CHUNK_WIDTH * nbt::biomes::CHUNK_WIDTH>
+            heights;
+        for (int z = 0; z < nbt::biomes::CHUNK_WIDTH; ++z) {
+            for (int x = 0; x < nbt::biomes::CHUNK_WIDTH; ++x) {
+                heights[z * nbt::biomes::CHUNK_WIDTH + x] =
+                    surface_height(spec, global_x + x, global_z + z);
+            }
+        }
+
+        bool root_sections = spec.data_version >= ROOT_SECTIONS_DATA_VERSION;
+
+        nbt_writer w;
+        w.begin_compound("");
+        w.put_int("DataVersion", spec.data_version);
+        if (!root_sections) {
+            w.begin_compound("Level");
+        }
+        w.put_int("xPos", global_x / nbt::biomes::CHUNK_WIDTH);
+        w.put_int("zPos", global_z / nbt::biomes::CHUNK_WIDTH);
+        w.put_long("LastUpdate", static_cast<std::int64_t>(
+                                     hash(spec.seed, chunk_x, -2, chunk_z) >>
+                                     16U));
+        w.put_string("Status", "full");
+
+        if (!root_sections) {
+            std::vector<std::int32_t> biomes(BIOMES_LEN);
+            for (int i = 0; i < BIOMES_LEN; ++i) {
+                biomes[i] = static_cast<std::int32_t>(
+                    hash(spec.seed, chunk_x, i, chunk_z) % 8);
+            }
+            w.put_int_array("Biomes", biomes);
+        }
+
+        w.begin_list(root_sections ? "sections" : "Sections",
+                     nbt::TAG_COMPOUND, spec.n_sections);
+        std::vector<std::uint16_t> indices(SECTION_HEIGHT *
+                                           nbt::biomes::CHUNK_WIDTH *
+                                           nbt::biomes::CHUNK_WIDTH);
+        for (int sy = 0; sy < spec.n_sections; ++sy) {
+            std::size_t i = 0;
+            bool all_air = true;
+            for (int y = sy * SECTION_HEIGHT; y < (sy + 1) * SECTION_HEIGHT;
+                 ++y) {
+                for (int z = 0; z < nbt::biomes::CHUNK_WIDTH; ++z) {
+                    for (int x = 0; x < nbt::biomes::CHUNK_WIDTH; ++x) {
+                        int h = heights[z * nbt::biomes::CHUNK_WIDTH + x];
+                        std::uint64_t r =
+                            hash(spec.seed, global_x + x, y, global_z + z);
+                        std::uint16_t index = 0;
+                        if (y == h) {
+                            index = PALETTE_WATER < spec.palette_size &&
+                                            r % WATER_RATIO == 0
+                                        ? PALETTE_WATER
+                                        : PALETTE_GRASS;
+                        } else if (y < h) {
+                            index = n_fill == 0 ? PALETTE_GRASS
+                                                : PALETTE_FILL + r % n_fill;
+                        }
+                        all_air = all_air && index == 0;
+                        indices[i++] = index;
+                    }
+                }
+            }
+
+            w.put_byte("Y", static_cast<std::int8_t>(sy));
+            if (root_sections) {
+                w.begin_compound("block_states");
+            }
+            /* 1.18 writes single entry palette without data for sections
+               of single block. */
+            int palette_size =
+                root_sections && all_air ? 1 : spec.palette_size;
+            w.begin_list(root_sections ? "palette" : "Palette",
+                         nbt::TAG_COMPOUND, palette_size);
+            for (int i = 0; i < palette_size; ++i) {
+                if (i == 0) {
+                    w.put_string("Name", "minecraft:air");
+                } else if (i == PALETTE_GRASS) {
+                    w.put_string("Name", "minecraft:grass_block");
+                } else if (i == PALETTE_WATER) {
+                    w.put_string("Name", "minecraft:water");
+                } else {
+                    w.put_string("Name",
+                                 FILL_BLOCKS[(i - PALETTE_FILL) %
+                                             FILL_BLOCKS.size()]);
+                }
+                w.end_compound();
+            }
+
+            if (!root_sections) {
+                w.put_long_array("BlockStates", pack(indices, bits, stretch));
+                w.end_compound();
+                continue;
+            }
+
+            if (palette_size > 1) {
+                w.put_long_array("data", pack(indices, bits, false));
+            }
+            w.end_compound();
+
+            w.begin_compound("biomes");
+            w.begin_list("palette", nbt::TAG_STRING, 2);
+            w.put_list_string("minecraft:plains");
+            w.put_list_string("minecraft:swamp");
+            std::vector<std::uint16_t> biomes(BIOMES_PER_SECTION);
+            for (int b = 0; b < BIOMES_PER_SECTION; ++b) {
+                int i = sy * BIOMES_PER_SECTION + b;
+                biomes[b] = hash(spec.seed, chunk_x, i, chunk_z) % 2;
+            }
+            w.put_long_array("data", pack(biomes, 1, false));
+            w.end_compound();
+
+            w.end_compound();
+        }
+
+        w.end_compound();
+        if (!root_sections) {
+            w.end_compound();
+        }
+
+        return w.take();
+    }
+
+    auto make_region(region_spec const &spec) -> std::vector<std::uint8_t> {
+        constexpr int n_chunks = nbt::biomes::CHUNK_PER_REGION_WIDTH *
+                                 nbt::biomes::CHUNK_PER_REGION_WIDTH;
+        constexpr int percent = 100;
+
+        std::vector<std::uint8_t> region(SECTOR_SIZE * 2);
+        auto put_u32 = [&region](std::size_t off, std::uint32_t v) {
+            for (int i = 0; i < 4; ++i) {
+                region[off + i] = static_cast<std::uint8_t>(v >> (24 - i * 8));
+            }
+        };
+
+        for (int index = 0; index < n_chunks; ++index) {
+            int chunk_x = index % nbt::biomes::CHUNK_PER_REGION_WIDTH;
+            int chunk_z = index / nbt::biomes::CHUNK_PER_REGION_WIDTH;
+            if (hash(spec.seed, chunk_x, -3, chunk_z) % percent >=
+                static_cast<unsigned>(spec.density)) {
+                continue;
+            }
+
+            std::vector<std::uint8_t> raw =
+                make_chunk_nbt(spec, chunk_x, chunk_z);
+            uLongf compressed_len = ::compressBound(raw.size());
+            std::vector<std::uint8_t> compressed(compressed_len);
+            if (::compress2(compressed.data(), &compressed_len, raw.data(),
+                            raw.size(), spec.compression_level) != Z_OK) {
+                throw std::runtime_error("failed to compress chunk");
+            }
+
+            std::size_t offset = region.size();
+            std::size_t sectors =
+                (compressed_len + 5 + SECTOR_SIZE - 1) / SECTOR_SIZE;
+            region.resize(offset + sectors * SECTOR_SIZE);
+            put_u32(offset, compressed_len + 1);
+            region[offset + 4] = ZLIB_COMPRESSION;
+            std::memcpy(region.data() + offset + 5, compressed.data(),
+                        compressed_len);
+
+            put_u32(index * 4, (offset / SECTOR_SIZE) << 8U | sectors);
+            put_u32(SECTOR_SIZE + index * 4,
+                    static_cast<std::uint32_t>(spec.seed));
+        }
+
+        return region;
+    }
+
+    auto write_region(std::filesystem::path const &dir,
+                      region_spec const &spec) -> std::filesystem::path {
+        std::filesystem::path path =
+            dir / ("r." + std::to_string(spec.region_x) + "." +
+                   std::to_string(spec.region_z) + ".mca");
+        std::vector<std::uint8_t> data = make_region(spec);
+
+        std::ofstream out(path, std::ios::binary);
+        out.write(reinterpret_cast<char const *>(data.data()),
+                  static_cast<std::streamsize>(data.size()));
+        if (!out) {
+            throw std::runtime_error("failed to write " + path.string());
+        }
+
+        return path;
+    }
+} // namespace pixel_terrain::bench
@@ -0,0 +1,42 @@
+// SPDX-License-Identifier: MIT
+
+#ifndef SYNTHETIC_REGION_HH
+#define SYNTHETIC_REGION_HH
+
+#include <cstdint>
+#include <filesystem>
+#include <vector>
+
+namespace pixel_terrain::bench {
+    /* Parameters of synthetic region.  Same parameters always produce
+       byte-identical output. */
+    struct region_spec {
+        int region_x = 0;
+        int region_z = 0;
+        std::uint64_t seed = 0;
+        /* Number of entries in palette of each section, including air. */
+        int palette_size = 8;
+        /* Number of sections in each chunk, counted from y = 0. */
+        int n_sections = 8;
+        /* zlib compression level, -1 for zlib's default. */
+        int compression_level = -1;
+        /* Data versions older than 2529 use packing spanning over longs,
+           and 2844 or newer use 1.18 layout. */
+        int data_version = 2586;
+        /* Percentage of chunks to exist in the region. */
+        int density = 100;
+    };
+
+    /* Return uncompressed NBT of the chunk. */
+    auto make_chunk_nbt(region_spec const &spec, int chunk_x, int chunk_z)
+        -> std::vector<std::uint8_t>;
+
+    /* Return content of the region file. */
+    auto make_region(region_spec const &spec) -> std::vector<std::uint8_t>;
+
+    /* Write region file to DIR and return its path. */
+    auto write_region(std::filesystem::path const &dir,
+                      region_spec const &spec) -> std::filesystem::path;
+} // namespace pixel_terrain::bench
+
+#endif
@@ -20,6 +20,10 @@ usage: pixel-terrain server [OPTIONS...]
   -o DIR, --overworld DIR  Read overworld data from DIR.
   -n DIR, --nether DIR     Read nether data from DIR.
   -e DIR, --end DIR        Read end data from DIR.
+          --metrics-file FILE
+                           Write metrics to FILE periodically and at exit.
+                           Metrics are written in JSON if FILE ends with
+                           ".json", and in Prometheus text format otherwise.
           --help           Print this usage and exit.
 
 Help for block info server's protocol and config
@@ -51,6 +55,7 @@ PROTOCOL:
         ::re_option{"overworld", re_required_argument, nullptr, 'o'},
         ::re_option{"nether", re_required_argument, nullptr, 'n'},
         ::re_option{"end", re_required_argument, nullptr, 'e'},
+        ::re_option{"metrics-file", re_required_argument, nullptr, 'M'},
         ::re_option{"help", re_no_argument, nullptr, 'h'},
         ::re_option{nullptr, 0, nullptr, 0});
 } // namespace
@@ -87,6 +92,10 @@ namespace pixel_terrain {
                 pixel_terrain::server::end_dir = re_optarg;
                 break;
 
+            case 'M':
+                pixel_terrain::server::metrics_file = re_optarg;
+                break;
+
             default:
                 return 1;
             }
@@ -1,11 +1,13 @@
 // SPDX-License-Identifier: MIT
 
 #include <algorithm>
+#include <atomic>
 #include <cstdio>
 #include <exception>
 #include <fstream>
 #include <iostream>
 #include <string>
+#include <thread>
 #include <utility>
 #include <vector>
 
@@ -18,8 +20,9 @@
 #include "utils/path_hack.hh"
 
 namespace {
-    auto dump_coord(const std::string &filename, const std::string &outfmt,
-                    int x, int z) -> bool {
+    auto format_out_name(const std::string &filename,
+                         const std::string &outfmt, int x, int z)
+        -> std::string {
         std::filesystem::path p(filename);
         std::string in_filename = p.filename().string();
         if (in_filename.size() > 4 &&
@@ -29,79 +32,97 @@ namespace {
 
         std::string outname = outfmt;
 
-        auto i = outname.begin();
-        for (;;) {
-            i = std::find(i, outname.end(), '%');
-            if (i == outname.end()) {
-                break;
-            }
-            switch (*(i + 1)) {
+        std::size_t i = 0;
+        while ((i = outname.find('%', i)) != std::string::npos &&
+               i + 1 < outname.size()) {
+            std::string replacement;
+            switch (outname[i + 1]) {
             case '1':
-                outname.erase(i, i + 2);
-                outname.insert(i, in_filename.begin(), in_filename.end());
-                i += in_filename.size();
+                replacement = in_filename;
                 break;
 
-            case '2': {
-                std::string x_str = std::to_string(x);
-                outname.erase(i, i + 2);
-                outname.insert(i, x_str.begin(), x_str.end());
-                i += x_str.size();
+            case '2':
+                replacement = std::to_string(x);
                 break;
-            }
 
-            case '3': {
-                std::string z_str = std::to_string(z);
-                outname.erase(i, i + 2);
-                outname.insert(i, z_str.begin(), z_str.end());
-                i += z_str.size();
+            case '3':
+                replacement = std::to_string(z);
                 break;
+
+            default:
+                ++i;
+                continue;
             }
-            }
+
+            /* Work with indices since replace() may reallocate. */
+            outname.replace(i, 2, replacement);
+            i += replacement.size();
         }
 
+        return outname;
+    }
+
+    auto write_chunk(const std::string &outname,
+                     std::vector<std::uint8_t> *data) -> bool {
+        if (data == nullptr) {
+            std::cerr << outname << ": Chunk not exists.\n";
+            return false;
+        }
+
+        std::filesystem::path outfile(outname);
+        std::ofstream out(outfile, std::ios::binary);
+        if (!out) {
+            std::cerr << outname << ": Unable to open output file.\n";
+            delete data;
+            return false;
+        }
+
+        out.write(reinterpret_cast<char *>(data->data()), data->size());
+        delete data;
+        return true;
+    }
+
+    auto dump_coord(const std::string &filename, const std::string &outfmt,
+                    int x, int z) -> bool {
+        std::string outname = format_out_name(filename, outfmt, x, z);
         try {
             std::filesystem::path infile(filename);
             pixel_terrain::anvil::region r =
                 pixel_terrain::anvil::region(infile);
-            std::vector<std::uint8_t> *data = r.chunk_data(x, z);
-            if (data == nullptr) {
-                std::cerr << outname << ": Chunk not exists.\n";
-                return false;
-            }
-
-            std::filesystem::path outfile(outname);
-            std::ofstream out(outfile, std::ios::binary);
-            if (!out) {
-                std::cerr << outname << ": Unable to open output file.\n";
-                return false;
-            }
-
-            out.write(reinterpret_cast<char *>(data->data()), data->size());
+            return write_chunk(outname, r.chunk_data(x, z));
         } catch (...) {
             std::cerr << outname << ": Error dumping nbt.\n";
             return false;
         }
-        return true;
     }
 
-    auto dump_all(const std::string &filename, const std::string &outfmt)
-        -> bool {
-        constexpr int chunk_size = 32;
-        for (int x = 0; x < chunk_size; ++x) {
-            for (int z = 0; z < chunk_size; ++z) {
-                if (!dump_coord(filename, outfmt, x, z)) {
-                    return false;
-                }
-            }
+    auto dump_all(const std::string &filename, const std::string &outfmt,
+                  unsigned int n_jobs) -> bool {
+        std::atomic_bool ok = true;
+        try {
+            std::filesystem::path infile(filename);
+            pixel_terrain::anvil::region r =
+                pixel_terrain::anvil::region(infile);
+            r.for_each_chunk_data(
+                [&](int x, int z, std::vector<std::uint8_t> *data) {
+                    if (!write_chunk(format_out_name(filename, outfmt, x, z),
+                                     data)) {
+                        ok = false;
+                    }
+                },
+                nullptr, n_jobs);
+        } catch (...) {
+            std::cerr << filename << ": Error dumping nbt.\n";
+            return false;
         }
-        return true;
+        return ok;
     }
 
     void print_usage() {
         std::cout << &R"(
 Usage: pixel-terrain dump-nbt [option]... [--] <in file>...
 
+  -j N, --jobs=N           Write N chunks in parallel when dumping all chunks.
   -o DIR, --out=DIR        Set output filename format. %1 is replaced by input filename,
                            %2  and %3 are replaced by chunk x, z coordinate.
   -s (X,Z), --where=(X,Z)  Select chunk. If not specified, dump all chunks.
@@ -110,6 +131,7 @@ Usage: pixel-terrain dump-nbt [option]... [--] <in file>...
     }
 
     auto long_options = pixel_terrain::make_array<::re_option>(
+        ::re_option{"jobs", re_required_argument, nullptr, 'j'},
         ::re_option{"out", re_required_argument, nullptr, 'o'},
         ::re_option{"where", re_required_argument, nullptr, 's'},
         ::re_option{"help", re_no_argument, nullptr, 'h'},
@@ -120,14 +142,28 @@ namespace pixel_terrain {
     auto dump_nbt_main(int argc, char **argv) -> int {
         const char *outfmt = "%1+%2+%3.nbt";
         std::vector<std::pair<int, int>> coords;
+        unsigned int n_jobs = std::thread::hardware_concurrency();
 
         for (;;) {
             int opt =
-                regetopt(argc, argv, "o:s:", long_options.data(), nullptr);
+                regetopt(argc, argv, "j:o:s:", long_options.data(), nullptr);
             if (opt < 0) {
                 break;
             }
             switch (opt) {
+            case 'j': {
+                int n = 0;
+                try {
+                    n = std::stoi(re_optarg);
+                } catch (std::exception const &) {
+                }
+                if (n <= 0) {
+                    std::cout << "Invalid concurrency.\n";
+                    return 1;
+                }
+                n_jobs = n;
+            } break;
+
             case 'o':
                 outfmt = re_optarg;
                 break;
@@ -153,7 +189,7 @@ namespace pixel_terrain {
 
         for (int i = re_optind; i < argc; ++i) {
             if (coords.empty()) {
-                dump_all(argv[i], outfmt);
+                dump_all(argv[i], outfmt, n_jobs);
             } else {
                 for (const std::pair<int, int> &coord : coords) {
                     dump_coord(argv[i], outfmt, coord.first, coord.second);
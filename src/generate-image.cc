@@ -1,44 +1,191 @@
 // SPDX-License-Identifier: MIT
 
+#include <algorithm>
+#include <chrono>
 #include <cstdlib>
 #include <filesystem>
 #include <iostream>
+#include <iterator>
 #include <stdexcept>
 #include <string>
 #include <thread>
+#include <utility>
+#include <vector>
 
 #include <regetopt.h>
 
 #include "config.h"
 #include "image/image.hh"
+#include "image/utils.hh"
 #include "logger/logger.hh"
+#include "logger/metrics.hh"
+#include "logger/profile.hh"
 #include "nbt/utils.hh"
 #include "pixel-terrain.hh"
 #include "utils/array.hh"
 #include "utils/path_hack.hh"
+#ifdef OS_LINUX
+#include "image/watcher.hh"
+#endif
 
 namespace {
     pixel_terrain::image::image_generator *generator;
 
-    void generate_image(std::string const &src,
-                        pixel_terrain::image::options options) {
-        using namespace pixel_terrain;
+    /* Sources to generate, with options given for them.  These are
+       generated together in one pool once all options are parsed. */
+    std::vector<std::pair<std::string, pixel_terrain::image::options>>
+        sources;
 
+    void add_source(std::string const &src,
+                    pixel_terrain::image::options options) {
         if (options.label().empty()) {
             options.set_label(src);
         }
 
-        if (generator == nullptr) {
-            generator = new image::image_generator(options);
-            generator->start();
+        sources.emplace_back(src, std::move(options));
+    }
+
+    void generate_all() {
+        using namespace pixel_terrain;
+
+        if (sources.empty()) {
+            return;
+        }
+
+        /* Pool is shared by all sources, so use the largest concurrency and
+           the tightest memory limit among them. */
+        unsigned int n_jobs = 1;
+        std::size_t max_memory = 0;
+        unsigned int prefetch_depth = 0;
+        for (auto const &[src, options] : sources) {
+            n_jobs = std::max(n_jobs, options.n_jobs());
+            prefetch_depth = std::max(prefetch_depth, options.prefetch_depth());
+            if (options.max_memory() != 0 &&
+                (max_memory == 0 || options.max_memory() < max_memory)) {
+                max_memory = options.max_memory();
+            }
         }
 
-        std::filesystem::path src_path(src);
-        if (std::filesystem::is_directory(src_path)) {
-            generator->queue_all_in_dir(src, options);
-        } else {
-            generator->queue_region(src, options);
+        generator =
+            new image::image_generator(n_jobs, max_memory, prefetch_depth);
+        generator->start();
+
+        for (auto const &[src, options] : sources) {
+            generator->add_source(src, options);
         }
+        sources.clear();
+
+        generator->queue_sources();
+    }
+
+#ifdef OS_LINUX
+    /* Autosave of the game writes regions over a few seconds. */
+    constexpr std::chrono::seconds WATCH_QUIET(2);
+    constexpr std::chrono::seconds WATCH_MAX_DELAY(30);
+
+    /* Source to generate again when its regions are written. */
+    struct watched_source {
+        std::filesystem::path dir;
+        /* Name of the region if the source is a single file. */
+        std::filesystem::path file;
+        pixel_terrain::image::options options;
+    };
+
+    /* Generate sources, and then keep generating regions written after
+       that.  This never returns. */
+    [[noreturn]] void generate_and_watch() {
+        using namespace pixel_terrain;
+
+        /* Start watching before the first pass, so that regions written
+           during it are not missed. */
+        image::region_watcher watcher;
+        std::vector<watched_source> watched;
+        for (auto const &[src, options] : sources) {
+            std::filesystem::path path =
+                std::filesystem::path(src).lexically_normal();
+            watched_source w{path, "", options};
+            if (!std::filesystem::is_directory(path)) {
+                w.dir = path.parent_path();
+                w.file = path.filename();
+            } else if (!path.has_filename()) {
+                /* Trailing separator. */
+                w.dir = path.parent_path();
+            }
+            if (w.dir.empty()) {
+                w.dir = ".";
+            }
+
+            try {
+                watcher.add_directory(w.dir);
+            } catch (std::runtime_error const &e) {
+                ELOG("Cannot watch %s\n", e.what());
+                std::exit(1);
+            }
+            watched.push_back(std::move(w));
+        }
+
+        generate_all();
+        generator->wait();
+
+        for (;;) {
+            ILOG("Waiting for regions to be written...\n");
+            std::vector<std::filesystem::path> changed =
+                watcher.wait(WATCH_QUIET, WATCH_MAX_DELAY);
+            ILOG("%zu region(s) written.\n", changed.size());
+
+            for (std::filesystem::path const &file : changed) {
+                for (watched_source const &w : watched) {
+                    if (file.parent_path() == w.dir &&
+                        (w.file.empty() || file.filename() == w.file)) {
+                        generator->queue_region(file, w.options);
+                    }
+                }
+            }
+            generator->wait();
+        }
+    }
+#endif
+
+    void start_metrics(std::filesystem::path const &path) {
+        using namespace pixel_terrain;
+
+        constexpr std::chrono::seconds interval(10);
+
+        auto start_time = std::chrono::steady_clock::now();
+
+        logger::metrics::add_counter_func(
+            "pixel_terrain_chunks_generated_total", "Chunks rendered.", [] {
+                return static_cast<double>(logger::get_total_stat().first);
+            });
+        logger::metrics::add_counter_func(
+            "pixel_terrain_chunks_reused_total",
+            "Chunks skipped since they were not updated.", [] {
+                return static_cast<double>(logger::get_total_stat().second);
+            });
+        logger::metrics::add_gauge_func(
+            "pixel_terrain_cache_hit_ratio",
+            "Ratio of chunks skipped since they were not updated.", [] {
+                auto [generated, reused] = logger::get_total_stat();
+                if (generated + reused == 0) {
+                    return 0.0;
+                }
+                return static_cast<double>(reused) / (generated + reused);
+            });
+        logger::metrics::add_gauge_func(
+            "pixel_terrain_chunks_per_second",
+            "Chunks rendered per second since start.", [start_time] {
+                std::chrono::duration<double> elapsed =
+                    std::chrono::steady_clock::now() - start_time;
+                return logger::get_total_stat().first / elapsed.count();
+            });
+        logger::metrics::add_gauge_func(
+            "pixel_terrain_queue_depth", "Regions waiting for a worker.", [] {
+                return generator == nullptr
+                           ? 0.0
+                           : static_cast<double>(generator->queue_size());
+            });
+
+        logger::metrics::start_export(path, interval);
     }
 
     void clean_up_generator() {
@@ -47,10 +194,20 @@ namespace {
         if (generator != nullptr) {
             DLOG("Waiting for worker to finish...\n");
             generator->finish();
+        }
 
+        /* Write final metrics before the generator is gone, since queue
+           depth is read from it. */
+        logger::metrics::stop_export();
+
+        if (generator != nullptr) {
             delete generator;
+            generator = nullptr;
 
             logger::show_stat();
+            if (logger::profile::enabled) {
+                logger::profile::show_profile();
+            }
         }
     }
 } // namespace
@@ -65,11 +222,25 @@ Usage: pixel-terrain image [option]... [--] <dir>    OR
 Generate map image.
 
   -c DIR, --cache-dir=DIR   Use DIR as cache direcotry.
+      --chunks=LIST         Generate only chunks in LIST, whether they are
+                            updated or not, and patch them into existing
+                            images. LIST is world chunk coordinates in form
+                            of X,Z separated by spaces, or "-" to read them
+                            from standard input.
       --clear               Reset current generator configuration.
       --generate=SRC        Generate image for SRC with current configuration.
-  -j N, --jobs=N            Execute N jobs concurrently. Take effects only if
-                            specified before --generate option specified.
+  -j N, --jobs=N            Execute N jobs concurrently. All sources share
+                            one pool, which uses the largest N given.
+      --max-memory=SIZE     Limit memory used by regions being generated to
+                            about SIZE bytes. SIZE may end with K, M or G.
+                            This is approximate: each region is estimated
+                            from its chunk sizes, and files read ahead are
+                            left to the page cache.
+                            The smallest SIZE given is used for all sources.
       --label               Label current configuration.
+      --metrics-file=FILE   Write metrics to FILE periodically and at exit.
+                            Metrics are written in JSON if FILE ends with
+                            ".json", and in Prometheus text format otherwise.
   -n, --nether              Use image generator optimized to nether.
   -o PATH, --out=PATH       Save generated images to PATH.
                             If PATH is a file, write output image to PATH eve if
@@ -79,6 +250,18 @@ Generate map image.
       --outname-format=FMT  Specify format for output filename. Default value is
                             original filename with extension appended. Note that
                             proper extension will be appended automatically.
+      --prefetch=N          Read files of N regions queued next ahead of
+                            workers. 0 disables it. Default is the number of
+                            jobs. The largest N given is used.
+      --priority=N          Share of workers given to the source relative to
+                            other sources, from 1 to 1000. Default is 1.
+                            Regions of all sources are interleaved, so that
+                            small sources don't wait for large ones.
+      --profile             Print time spent in each stage of generation.
+                            Note that --clear option does NOT clear this value.
+      --watch               Keep running, and generate regions again each time
+                            the game writes them. Caches are saved after each
+                            update. Only available on Linux.
   -V, -VV, -VVV             Set log level. Specifying multiple times increases log level.
                             Note that --clear option does NOT clear this value.
       --help                Print this usage and exit.
@@ -93,12 +276,19 @@ Output name format speficier:
     auto long_options = pixel_terrain::make_array<::re_option>(
         ::re_option{"jobs", re_required_argument, nullptr, 'j'},
         ::re_option{"cache-dir", re_required_argument, nullptr, 'c'},
+        ::re_option{"chunks", re_required_argument, nullptr, 'k'},
         ::re_option{"clear", re_no_argument, nullptr, 'C'},
         ::re_option{"generate", re_required_argument, nullptr, 'G'},
         ::re_option{"nether", re_no_argument, nullptr, 'n'},
         ::re_option{"out", re_required_argument, nullptr, 'o'},
         ::re_option{"outname-format", re_required_argument, nullptr, 'F'},
+        ::re_option{"prefetch", re_required_argument, nullptr, 'f'},
+        ::re_option{"priority", re_required_argument, nullptr, 'p'},
         ::re_option{"label", re_required_argument, nullptr, 'l'},
+        ::re_option{"max-memory", re_required_argument, nullptr, 'm'},
+        ::re_option{"metrics-file", re_required_argument, nullptr, 'M'},
+        ::re_option{"profile", re_no_argument, nullptr, 'P'},
+        ::re_option{"watch", re_no_argument, nullptr, 'W'},
         ::re_option{"help", re_no_argument, nullptr, 'h'},
         ::re_option{nullptr, 0, nullptr, 0});
 } // namespace
@@ -110,6 +300,7 @@ namespace pixel_terrain {
         pixel_terrain::image::options options;
 
         bool should_generate = true;
+        bool watch = false;
 
         for (;;) {
             int opt = regetopt(argc, argv, "j:c:no:F:V", long_options.data(),
@@ -137,6 +328,34 @@ namespace pixel_terrain {
                 }
                 break;
 
+            case 'k': {
+                std::string list = ::re_optarg;
+                if (list == "-") {
+                    list.assign(std::istreambuf_iterator<char>(std::cin),
+                                std::istreambuf_iterator<char>());
+                }
+                auto [chunks, ok] = image::parse_chunk_list(list);
+                if (!ok) {
+                    std::cout << "Invalid chunk list.\n";
+                    std::exit(1);
+                }
+                if (chunks.empty()) {
+                    /* Empty list would mean every updated chunk. */
+                    std::cout << "No chunk is given.\n";
+                    std::exit(0);
+                }
+                options.set_chunks(std::move(chunks));
+            } break;
+
+            case 'm': {
+                auto [bytes, ok] = image::parse_memory_size(::re_optarg);
+                if (!ok) {
+                    std::cout << "Invalid memory size.\n";
+                    std::exit(1);
+                }
+                options.set_max_memory(bytes);
+            } break;
+
             case 'n':
                 options.set_is_nether(true);
                 break;
@@ -149,6 +368,30 @@ namespace pixel_terrain {
                 options.set_outname_format(::re_optarg);
                 break;
 
+            case 'f':
+                try {
+                    options.set_prefetch_depth(std::stoi(::re_optarg));
+                } catch (std::invalid_argument const &) {
+                    std::cout << "Invalid prefetch depth.\n";
+                    std::exit(1);
+                } catch (std::out_of_range const &) {
+                    std::cout << "Prefetch depth is out of permitted range.\n";
+                    std::exit(1);
+                }
+                break;
+
+            case 'p':
+                try {
+                    options.set_priority(std::stoi(::re_optarg));
+                } catch (std::invalid_argument const &) {
+                    std::cout << "Invalid priority.\n";
+                    std::exit(1);
+                } catch (std::out_of_range const &) {
+                    std::cout << "Priority is out of permitted range.\n";
+                    std::exit(1);
+                }
+                break;
+
             case 'c':
                 options.set_cache_dir(::re_optarg);
                 break;
@@ -158,7 +401,7 @@ namespace pixel_terrain {
                 break;
 
             case 'G':
-                generate_image(::re_optarg, options);
+                add_source(::re_optarg, options);
                 should_generate = false;
                 break;
 
@@ -166,6 +409,23 @@ namespace pixel_terrain {
                 options.set_label(::re_optarg);
                 break;
 
+            case 'P':
+                logger::profile::enabled = true;
+                break;
+
+            case 'M':
+                start_metrics(::re_optarg);
+                break;
+
+            case 'W':
+#ifdef OS_LINUX
+                watch = true;
+                break;
+#else
+                std::cout << "--watch is not supported on this platform.\n";
+                std::exit(1);
+#endif
+
             case 'h':
                 print_usage();
                 std::exit(0);
@@ -182,10 +442,21 @@ namespace pixel_terrain {
             }
 
             for (int i = ::re_optind; i < argc; ++i) {
-                generate_image(argv[i], options);
+                add_source(argv[i], options);
             }
         }
 
+#ifdef OS_LINUX
+        if (watch) {
+            generate_and_watch();
+        }
+#endif
+
+        generate_all();
+        /* Wait for workers here rather than at exit, since static objects
+           they use may be destroyed before atexit handlers run. */
+        clean_up_generator();
+
         return 0;
     }
 } // namespace pixel_terrain
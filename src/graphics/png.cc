@@ -4,6 +4,7 @@
    This file make easy to handle pixel buffer and PNG file. */
 
 #include <algorithm>
+#include <array>
 #include <cerrno>
 #include <cmath>
 #include <csetjmp>
@@ -13,6 +14,9 @@
 #include <filesystem>
 #include <iostream>
 #include <stdexcept>
+#include <string>
+#include <utility>
+#include <vector>
 
 #include <png.h>
 #include <pngconf.h>
@@ -26,6 +30,7 @@ namespace pixel_terrain::graphics {
         inline constexpr std::size_t PNG_SIG_LEN = 8;
         inline constexpr int SUPPORTED_BIT_DEPTH = 8;
         inline constexpr unsigned int N_CHANNEL = 4;
+        inline constexpr std::size_t PNG_CHUNK_NAME_LEN = 4;
     } // namespace
 
     png::png(int width, int height)
@@ -56,6 +61,8 @@ namespace pixel_terrain::graphics {
         }
         ::png_init_io(png, in);
         ::png_set_sig_bytes(png, PNG_SIG_LEN);
+        ::png_set_keep_unknown_chunks(png, PNG_HANDLE_CHUNK_ALWAYS, nullptr,
+                                      0);
 
         ::png_read_info(png, png_info);
 
@@ -81,6 +88,15 @@ namespace pixel_terrain::graphics {
         }
         ::png_read_image(png, rows);
         delete[] rows;
+        ::png_read_end(png, png_info);
+
+        ::png_unknown_chunkp unknowns;
+        int n_unknowns = ::png_get_unknown_chunks(png, png_info, &unknowns);
+        for (int i = 0; i < n_unknowns; ++i) {
+            std::string name(reinterpret_cast<char const *>(unknowns[i].name));
+            private_chunks_[name].assign(unknowns[i].data,
+                                         unknowns[i].data + unknowns[i].size);
+        }
 
         this->width = static_cast<int>(width);
         this->height = static_cast<int>(height);
@@ -148,6 +164,27 @@ namespace pixel_terrain::graphics {
         data[++base_off] = 0;
     }
 
+    void png::set_private_chunk(std::string const &name,
+                                std::vector<std::uint8_t> data) {
+        if (name.size() != PNG_CHUNK_NAME_LEN) {
+            throw std::invalid_argument("invalid chunk name: " + name);
+        }
+        private_chunks_[name] = std::move(data);
+    }
+
+    auto png::get_private_chunk(std::string const &name) const
+        -> std::vector<std::uint8_t> const * {
+        auto itr = private_chunks_.find(name);
+        if (itr == private_chunks_.end()) {
+            return nullptr;
+        }
+        return &itr->second;
+    }
+
+    void png::remove_private_chunk(std::string const &name) {
+        private_chunks_.erase(name);
+    }
+
     auto png::save(std::filesystem::path const &path) -> bool {
         std::FILE *f = FOPEN(path.c_str(), "wb");
         if (f == nullptr) {
@@ -197,6 +234,26 @@ namespace pixel_terrain::graphics {
 
         delete[] rows;
 
+        std::vector<::png_unknown_chunk> unknowns;
+        for (auto &[name, chunk_data] : private_chunks_) {
+            /* set_private_chunk() checks this, but chunks read from a file
+               are kept as they are. */
+            if (name.size() != PNG_CHUNK_NAME_LEN) {
+                continue;
+            }
+            ::png_unknown_chunk chunk;
+            std::memset(&chunk, 0, sizeof(chunk));
+            std::memcpy(chunk.name, name.data(), PNG_CHUNK_NAME_LEN);
+            chunk.data = chunk_data.data();
+            chunk.size = chunk_data.size();
+            chunk.location = PNG_AFTER_IDAT;
+            unknowns.push_back(chunk);
+        }
+        if (!unknowns.empty()) {
+            ::png_set_unknown_chunks(png, info, unknowns.data(),
+                                     static_cast<int>(unknowns.size()));
+        }
+
         if (setjmp(png_jmpbuf(png))) {
             ::png_destroy_write_struct(&png, &info);
 
@@ -5,7 +5,9 @@
 
 #include <cstdint>
 #include <filesystem>
+#include <map>
 #include <string>
+#include <vector>
 
 #include <png.h>
 
@@ -17,6 +19,7 @@ namespace pixel_terrain::graphics {
         unsigned int height;
         std::filesystem::path path;
         ::png_bytep data;
+        std::map<std::string, std::vector<std::uint8_t>> private_chunks_;
 
     public:
         png(int width, int height);
@@ -30,6 +33,13 @@ namespace pixel_terrain::graphics {
                        std::uint_fast32_t color);
         auto get_pixel(int x, int y) -> std::uint_fast32_t;
         void clear(int x, int y);
+        /* Attach application data to the image as an ancillary chunk.  NAME
+           must be a valid name for private ancillary chunk, like "ptHm". */
+        void set_private_chunk(std::string const &name,
+                               std::vector<std::uint8_t> data);
+        [[nodiscard]] auto get_private_chunk(std::string const &name) const
+            -> std::vector<std::uint8_t> const *;
+        void remove_private_chunk(std::string const &name);
         auto save(std::filesystem::path const &path) -> bool;
         auto save() -> bool;
     };
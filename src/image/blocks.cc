@@ -6,6 +6,7 @@
 #include <cstdint>
 #include <cstring>
 #include <string>
+#include <string_view>
 
 #include "block/block_colors_data.hh"
 #include "image/blocks.hh"
@@ -41,7 +42,7 @@ namespace pixel_terrain::image {
 
     block_color_map colors = init_block_list();
 
-    auto is_biome_overridden(std::string const &block) -> bool {
+    auto is_biome_overridden(std::string_view block) -> bool {
         using namespace std::string_literals;
 
         /* first, check if block is water or grass_block because the most
@@ -58,7 +59,7 @@ namespace pixel_terrain::image {
         }
 
         /* next, check if block is leaf-family. */
-        if (block.find("leaves") != std::string::npos) {
+        if (block.find("leaves") != std::string_view::npos) {
             return true;
         }
 
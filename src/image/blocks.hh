@@ -11,7 +11,7 @@
 namespace pixel_terrain::image {
     extern std::unordered_map<std::string_view, std::uint32_t> colors;
 
-    auto is_biome_overridden(std::string const &block) -> bool;
+    auto is_biome_overridden(std::string_view block) -> bool;
 } // namespace pixel_terrain::image
 
 #endif
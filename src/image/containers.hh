@@ -4,15 +4,26 @@
 #define CONTAINERS_HH
 
 #include <filesystem>
+#include <mutex>
 #include <thread>
+#include <utility>
+#include <vector>
 
 #include "logger/logger.hh"
 #include "nbt/chunk.hh"
+#include "nbt/journal.hh"
 #include "nbt/region.hh"
 #include "utils/path_hack.hh"
 
 namespace pixel_terrain::image {
     class options {
+    public:
+        static constexpr unsigned int DEFAULT_PRIORITY = 1;
+        static constexpr unsigned int MAX_PRIORITY = 1000;
+        /* Prefetch depth which follows number of jobs. */
+        static constexpr int PREFETCH_AS_JOBS = -1;
+
+    private:
         std::filesystem::path out_path_;
         bool out_path_is_dir_;
         unsigned int n_jobs_;
@@ -20,6 +31,10 @@ namespace pixel_terrain::image {
         std::string label_;
         std::filesystem::path cache_dir_;
         std::string outname_format_;
+        std::size_t max_memory_;
+        unsigned int priority_;
+        int prefetch_depth_;
+        std::vector<std::pair<int, int>> chunks_;
 
     public:
         options() { clear(); }
@@ -30,6 +45,10 @@ namespace pixel_terrain::image {
             is_nether_ = false;
             cache_dir_.clear();
             outname_format_.clear();
+            max_memory_ = 0;
+            priority_ = DEFAULT_PRIORITY;
+            prefetch_depth_ = PREFETCH_AS_JOBS;
+            chunks_.clear();
         }
 
         void set_out_path(std::filesystem::path const &p) {
@@ -86,21 +105,112 @@ namespace pixel_terrain::image {
         [[nodiscard]] auto outname_format() const -> std::string const & {
             return outname_format_;
         }
+
+        /* Limit of memory used by regions generated at once, or 0 for
+           unlimited. */
+        void set_max_memory(std::size_t bytes) { max_memory_ = bytes; }
+
+        [[nodiscard]] auto max_memory() const -> std::size_t {
+            return max_memory_;
+        }
+
+        /* Share of workers given to the source relative to other sources
+           generated in the same run. */
+        void set_priority(unsigned int priority) {
+            if (priority < 1 || MAX_PRIORITY < priority) {
+                ILOG("Ignoring priority because it is out of range.\n");
+                return;
+            }
+            priority_ = priority;
+        }
+
+        [[nodiscard]] auto priority() const -> unsigned int {
+            return priority_;
+        }
+
+        /* Number of queued regions read ahead of workers, so that their
+           files are in page cache when workers reach them.  0 disables
+           prefetching.  By default it is the number of jobs. */
+        void set_prefetch_depth(int depth) {
+            if (depth < 0) {
+                ILOG("Ignoring prefetch depth because it is negative.\n");
+                return;
+            }
+            prefetch_depth_ = depth;
+        }
+
+        [[nodiscard]] auto prefetch_depth() const -> unsigned int {
+            return prefetch_depth_ == PREFETCH_AS_JOBS ? n_jobs_
+                                                       : prefetch_depth_;
+        }
+
+        /* Generate only CHUNKS, given in world chunk coordinate, whether
+           they are updated or not.  If empty, every updated chunk is
+           generated. */
+        void set_chunks(std::vector<std::pair<int, int>> chunks) {
+            chunks_ = std::move(chunks);
+        }
+
+        [[nodiscard]] auto chunks() const
+            -> std::vector<std::pair<int, int>> const & {
+            return chunks_;
+        }
     };
 
     class region_container {
-        anvil::region *region_;
+        std::filesystem::path region_file_;
+        anvil::journal *journal_ = nullptr;
+        anvil::region *region_ = nullptr;
+        std::once_flag open_flag_;
         options options_;
         std::filesystem::path out_file_;
+        /* Chunks to generate in region coordinate, or empty for updated
+           chunks. */
+        std::vector<std::pair<int, int>> chunks_;
 
     public:
+        /* Region file is opened on first get_region(), so that only regions
+           about to be generated are mapped. */
+        region_container(std::filesystem::path region_file,
+                         anvil::journal *journal, options options,
+                         std::filesystem::path out_file)
+            : region_file_(std::move(region_file)), journal_(journal),
+              options_(std::move(options)), out_file_(std::move(out_file)) {}
         region_container(anvil::region *region, options options,
                          std::filesystem::path out_file)
             : region_(region), options_(std::move(options)),
               out_file_(std::move(out_file)) {}
         ~region_container() { delete region_; }
 
-        [[nodiscard]] auto get_region() -> anvil::region * { return region_; }
+        /* Return the region, opening it if not yet, or nullptr if it can't
+           be opened.  This can be called from multiple threads. */
+        [[nodiscard]] auto get_region() -> anvil::region * {
+            std::call_once(open_flag_, [this] {
+                if (region_ != nullptr) {
+                    return;
+                }
+
+                try {
+                    if (journal_ == nullptr) {
+                        region_ = new anvil::region(region_file_);
+                    } else {
+                        region_ = new anvil::region(region_file_, journal_);
+                    }
+                } catch (std::exception const &e) {
+                    ELOG("Failed to read region: %s\n",
+                         region_file_.string().c_str());
+                    ELOG("%s\n", e.what());
+                }
+            });
+            return region_;
+        }
+
+        /* Return path of the region file, or empty path if the container
+           is made of an opened region. */
+        [[nodiscard]] auto get_region_file() const
+            -> std::filesystem::path const & {
+            return region_file_;
+        }
 
         [[nodiscard]] auto get_output_path() const
             -> std::filesystem::path const * {
@@ -110,6 +220,15 @@ namespace pixel_terrain::image {
         [[nodiscard]] auto get_options() const -> options const * {
             return &options_;
         }
+
+        void set_chunks(std::vector<std::pair<int, int>> chunks) {
+            chunks_ = std::move(chunks);
+        }
+
+        [[nodiscard]] auto get_chunks() const
+            -> std::vector<std::pair<int, int>> const & {
+            return chunks_;
+        }
     };
 } // namespace pixel_terrain::image
 
@@ -8,18 +8,22 @@
 #include <exception>
 #include <filesystem>
 #include <iterator>
+#include <map>
 #include <memory>
 #include <mutex>
 #include <queue>
 #include <string>
 #include <thread>
+#include <tuple>
 #include <utility>
 #include <vector>
 
 #include "image/image.hh"
+#include "image/scheduler.hh"
 #include "image/utils.hh"
 #include "image/worker.hh"
 #include "logger/logger.hh"
+#include "nbt/constants.hh"
 #include "nbt/region.hh"
 #include "nbt/utils.hh"
 #include "utils/path_hack.hh"
@@ -27,6 +31,11 @@
 
 namespace pixel_terrain::image {
     namespace {
+        /* Division rounding toward negative infinity. */
+        auto floor_div(int a, int b) -> int {
+            return a >= 0 ? a / b : (a + 1) / b - 1;
+        }
+
         auto make_output_name(std::filesystem::path const &input,
                               options const &options)
             -> std::pair<std::filesystem::path, bool> {
@@ -72,36 +81,74 @@ namespace pixel_terrain::image {
         }
     } // namespace
 
+    auto image_generator::get_journal(std::filesystem::path const &cache_dir)
+        -> anvil::journal * {
+        auto itr = journals_.find(cache_dir);
+        if (itr != journals_.end()) {
+            return itr->second;
+        }
+
+        auto *journal = new anvil::journal(cache_dir);
+        journals_[cache_dir] = journal;
+        return journal;
+    }
+
+    void image_generator::prefetch_next(region_container *taken) {
+        std::unique_lock<std::mutex> lock(pending_mutex_);
+
+        /* Remove TAKEN itself rather than the front; workers which took
+           earlier regions may not have got here yet.  It is near the
+           front, since the window is a few jobs per worker. */
+        auto itr = std::find(pending_.begin(), pending_.end(), taken);
+        if (itr != pending_.end()) {
+            pending_.erase(itr);
+        }
+
+        /* Regions before this one have already been prefetched when they
+           entered the window. */
+        if (0 < prefetch_depth_ && prefetch_depth_ <= pending_.size()) {
+            anvil::region *r = pending_[prefetch_depth_ - 1]->get_region();
+            if (r != nullptr) {
+                r->prefetch();
+            }
+        }
+    }
+
     void image_generator::queue(region_container *item) {
         DLOG("Queue: %s\n",
              item->get_output_path()->filename().string().c_str());
 
+        {
+            std::unique_lock<std::mutex> lock(pending_mutex_);
+            pending_.push_back(item);
+            if (pending_.size() <= prefetch_depth_) {
+                anvil::region *r = item->get_region();
+                if (r != nullptr) {
+                    r->prefetch();
+                }
+            }
+        }
+
         thread_pool_->queue_job(item);
     }
 
-    void image_generator::queue_region(std::filesystem::path const &region_file,
-                                       options const &options) {
+    auto image_generator::make_container(
+        std::filesystem::path const &region_file, options const &options)
+        -> region_container * {
         DLOG("Preparing %s for queuing...\n",
              region_file.filename().string().c_str());
 
-        if (region_file.extension().string() != ".mca") {
-            ILOG("Skipping %s because it is not a .mca file.\n",
-                 region_file.filename().string().c_str());
-            return;
-        }
+        anvil::journal *journal = nullptr;
+        if (!options.cache_dir().empty()) {
+            try {
+                journal = get_journal(options.cache_dir());
+            } catch (std::exception const &e) {
+                ELOG("Failed to open cache: %s\n",
+                     options.cache_dir().string().c_str());
+                ELOG("%s\n", e.what());
 
-        anvil::region *r;
-        try {
-            if (options.cache_dir().empty()) {
-                r = new anvil::region(region_file);
-            } else {
-                r = new anvil::region(region_file, options.cache_dir());
+                return nullptr;
             }
-        } catch (std::exception const &e) {
-            ELOG("Failed to read region: %s\n", region_file.string().c_str());
-            ELOG("%s\n", e.what());
-
-            return;
         }
 
         std::filesystem::path out_file;
@@ -121,33 +168,152 @@ namespace pixel_terrain::image {
 
         DLOG("Output filename is %s.\n", out_file.string().c_str());
 
-        queue(new region_container(r, options, out_file));
-        logger::progress_bar_increase_total(1);
+        return new region_container(region_file, journal, options, out_file);
     }
 
-    void image_generator::queue_all_in_dir(std::filesystem::path const &dir,
-                                           options const &options) {
-        if (!options.out_path_is_directory()) {
-            ILOG("Output path pointing a single file; this "
-                 "may cause unexpected result.\n");
+    void image_generator::add_source(std::filesystem::path const &src,
+                                     options const &options) {
+        if (!options.chunks().empty()) {
+            add_chunks_source(src, options);
+            return;
         }
 
-        if (!options.cache_dir().empty()) {
-            try {
-                std::filesystem::create_directories(options.cache_dir());
-            } catch (std::filesystem::filesystem_error const &e) {
-                ELOG("Cannot create cache directory for %s: %s\n",
-                     options.label().c_str(), e.what());
+        source s{{}, {}, options};
+
+        if (std::filesystem::is_directory(src)) {
+            if (!options.out_path_is_directory()) {
+                ILOG("Output path pointing a single file; this "
+                     "may cause unexpected result.\n");
+            }
+
+            for (std::filesystem::directory_entry const &path :
+                 std::filesystem::directory_iterator(src)) {
+                if (path.is_directory()) {
+                    continue;
+                }
+
+                if (path.path().extension().string() != ".mca") {
+                    ILOG("Skipping %s because it is not a .mca file.\n",
+                         path.path().filename().string().c_str());
+                    continue;
+                }
+
+                s.regions.push_back(path.path());
+            }
+        } else if (src.extension().string() != ".mca") {
+            ILOG("Skipping %s because it is not a .mca file.\n",
+                 src.filename().string().c_str());
+            return;
+        } else {
+            s.regions.push_back(src);
+        }
+
+        logger::progress_bar_increase_total(
+            static_cast<int>(s.regions.size()));
+        sources_.push_back(std::move(s));
+    }
+
+    void image_generator::add_chunks_source(std::filesystem::path const &src,
+                                            options const &options) {
+        constexpr int region_width = nbt::biomes::CHUNK_PER_REGION_WIDTH;
+
+        /* Chunks in region coordinate, grouped by region. */
+        std::map<std::pair<int, int>, std::vector<std::pair<int, int>>>
+            regions;
+        for (auto [x, z] : options.chunks()) {
+            int region_x = floor_div(x, region_width);
+            int region_z = floor_div(z, region_width);
+            regions[{region_x, region_z}].emplace_back(
+                x - region_x * region_width, z - region_z * region_width);
+        }
+
+        source s{{}, {}, options};
+        s.options.set_chunks({});
+
+        bool is_dir = std::filesystem::is_directory(src);
+        auto [src_x, src_z, src_ok] =
+            is_dir ? std::make_tuple(0, 0, false) : parse_region_file_path(src);
+        for (auto &[coord, chunks] : regions) {
+            std::filesystem::path region_file;
+            if (is_dir) {
+                region_file = src / ("r." + std::to_string(coord.first) + "." +
+                                     std::to_string(coord.second) + ".mca");
+            } else if (src_ok && src_x == coord.first &&
+                       src_z == coord.second) {
+                region_file = src;
+            } else {
+                continue;
             }
+
+            if (!std::filesystem::exists(region_file)) {
+                ILOG("Skipping %s because it does not exist.\n",
+                     region_file.string().c_str());
+                continue;
+            }
+
+            std::sort(chunks.begin(), chunks.end());
+            chunks.erase(std::unique(chunks.begin(), chunks.end()),
+                         chunks.end());
+            s.regions.push_back(region_file);
+            s.chunks.push_back(std::move(chunks));
         }
 
-        for (std::filesystem::directory_entry const &path :
-             std::filesystem::directory_iterator(dir)) {
-            if (path.is_directory()) {
+        logger::progress_bar_increase_total(
+            static_cast<int>(s.regions.size()));
+        sources_.push_back(std::move(s));
+    }
+
+    auto image_generator::queue_sources() -> std::size_t {
+        /* Queuing blocks until workers catch up, so the order of queuing
+           is the order of generation. */
+        job_scheduler scheduler;
+        for (source const &s : sources_) {
+            scheduler.add_job(s.regions.size(), s.options.priority());
+        }
+
+        std::vector<std::size_t> next(sources_.size());
+        std::size_t n_queued = 0;
+        int i;
+        while ((i = scheduler.next()) >= 0) {
+            source &s = sources_[i];
+            std::size_t j = next[i]++;
+            region_container *item = make_container(s.regions[j], s.options);
+            if (item == nullptr) {
+                logger::progress_bar_process_one();
+                ++n_failed_;
                 continue;
             }
+            if (!s.chunks.empty()) {
+                item->set_chunks(std::move(s.chunks[j]));
+            }
+
+            queue(item);
+            ++n_queued;
+        }
+
+        sources_.clear();
+        return n_queued;
+    }
+
+    void image_generator::queue_region(
+        std::filesystem::path const &region_file, options const &options) {
+        logger::progress_bar_increase_total(1);
 
-            queue_region(path.path(), options);
+        region_container *item = make_container(region_file, options);
+        if (item == nullptr) {
+            logger::progress_bar_process_one();
+            ++n_failed_;
+            return;
+        }
+
+        queue(item);
+    }
+
+    void image_generator::flush_journals() {
+        for (auto &[dir, journal] : journals_) {
+            if (!journal->flush()) {
+                ELOG("Failed to write cache to %s\n", dir.string().c_str());
+            }
         }
     }
 
@@ -157,5 +323,14 @@ namespace pixel_terrain::image {
         thread_pool_->start();
     }
 
-    void image_generator::finish() { thread_pool_->finish(); }
+    auto image_generator::wait() -> std::size_t {
+        thread_pool_->wait_idle();
+        flush_journals();
+        return n_failed_.exchange(0);
+    }
+
+    void image_generator::finish() {
+        thread_pool_->finish();
+        flush_journals();
+    }
 } // namespace pixel_terrain::image
@@ -0,0 +1,82 @@
+// SPDX-License-Identifier: MIT
+
+/* Height map serialization.
+   Serialized form is zlib-compressed array of big endian 16-bit integers. */
+
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <iterator>
+#include <memory>
+#include <system_error>
+#include <vector>
+
+#include "image/height_map.hh"
+#include "nbt/utils.hh"
+#include "utils/path_hack.hh"
+
+namespace pixel_terrain::image {
+    auto height_map::serialize() const -> std::vector<std::uint8_t> {
+        std::vector<std::uint8_t> raw(heights_.size() * sizeof(std::int16_t));
+        for (std::size_t i = 0; i < heights_.size(); ++i) {
+            std::int16_t h = nbt::utils::to_host_byte_order(heights_[i]);
+            std::memcpy(raw.data() + i * sizeof(std::int16_t), &h,
+                        sizeof(std::int16_t));
+        }
+
+        return nbt::utils::zlib_compress(raw.data(), raw.size());
+    }
+
+    auto height_map::deserialize(std::vector<std::uint8_t> const &data)
+        -> bool {
+        std::unique_ptr<std::vector<std::uint8_t>> raw(
+            nbt::utils::zlib_decompress(
+                const_cast<std::uint8_t *>(data.data()), data.size()));
+        if (raw == nullptr ||
+            raw->size() != heights_.size() * sizeof(std::int16_t)) {
+            return false;
+        }
+
+        for (std::size_t i = 0; i < heights_.size(); ++i) {
+            std::int16_t h;
+            std::memcpy(&h, raw->data() + i * sizeof(std::int16_t),
+                        sizeof(std::int16_t));
+            heights_[i] = nbt::utils::to_host_byte_order(h);
+        }
+
+        return true;
+    }
+
+    auto height_map::load(std::filesystem::path const &path) -> bool {
+        std::ifstream in(path, std::ios::binary);
+        if (!in) {
+            return false;
+        }
+
+        std::vector<std::uint8_t> data((std::istreambuf_iterator<char>(in)),
+                                       std::istreambuf_iterator<char>());
+        return deserialize(data);
+    }
+
+    auto height_map::save(std::filesystem::path const &path) const -> bool {
+        std::vector<std::uint8_t> data = serialize();
+
+        std::filesystem::path tmp_path(path);
+        tmp_path.concat(PATH_STR_LITERAL(".tmp"));
+        std::FILE *f = FOPEN(tmp_path.c_str(), "wb");
+        if (f == nullptr) {
+            return false;
+        }
+        bool ok = std::fwrite(data.data(), 1, data.size(), f) == data.size();
+        ok = std::fclose(f) == 0 && ok;
+        if (!ok) {
+            return false;
+        }
+
+        std::error_code ec;
+        std::filesystem::rename(tmp_path, path, ec);
+        return !ec;
+    }
+} // namespace pixel_terrain::image
@@ -0,0 +1,59 @@
+// SPDX-License-Identifier: MIT
+
+#ifndef HEIGHT_MAP_HH
+#define HEIGHT_MAP_HH
+
+#include <array>
+#include <cstdint>
+#include <filesystem>
+#include <limits>
+#include <vector>
+
+#include "nbt/constants.hh"
+
+namespace pixel_terrain::image {
+    /* Height of the topmost opaque block of every column in a region.
+       This is stored in the cache directory so that shading of updated
+       chunks can refer to neighbours which are not re-rendered. */
+    class height_map {
+        std::array<std::int16_t, nbt::biomes::BLOCK_PER_REGION_WIDTH *
+                                     nbt::biomes::BLOCK_PER_REGION_WIDTH>
+            heights_;
+
+    public:
+        static constexpr std::int16_t UNKNOWN =
+            std::numeric_limits<std::int16_t>::min();
+
+        /* Suffix added to name of the region file to make name of the
+           file storing its map. */
+        static constexpr char const *FILE_SUFFIX = ".heights";
+
+        height_map() { heights_.fill(UNKNOWN); }
+
+        [[nodiscard]] auto get(int x, int z) const -> std::int16_t {
+            return heights_[z * nbt::biomes::BLOCK_PER_REGION_WIDTH + x];
+        }
+
+        [[nodiscard]] auto is_known(int x, int z) const -> bool {
+            return 0 <= x && x < nbt::biomes::BLOCK_PER_REGION_WIDTH &&
+                   0 <= z && z < nbt::biomes::BLOCK_PER_REGION_WIDTH &&
+                   get(x, z) != UNKNOWN;
+        }
+
+        void set(int x, int z, std::int16_t height) {
+            heights_[z * nbt::biomes::BLOCK_PER_REGION_WIDTH + x] = height;
+        }
+
+        [[nodiscard]] auto serialize() const -> std::vector<std::uint8_t>;
+        auto deserialize(std::vector<std::uint8_t> const &data) -> bool;
+
+        /* Read the map from PATH.  Return false, leaving the map as is, if
+           it doesn't exist or is broken. */
+        auto load(std::filesystem::path const &path) -> bool;
+        /* Write the map to PATH, replacing it atomically. */
+        [[nodiscard]] auto save(std::filesystem::path const &path) const
+            -> bool;
+    };
+} // namespace pixel_terrain::image
+
+#endif
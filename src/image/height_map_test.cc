@@ -0,0 +1,68 @@
+// SPDX-License-Identifier: MIT
+
+#include <cstdint>
+#include <filesystem>
+#include <fstream>
+#include <string>
+#include <vector>
+
+#include <boost/test/tools/interface.hpp>
+#include <boost/test/unit_test.hpp>
+#include <boost/test/unit_test_suite.hpp>
+
+#include "image/height_map.hh"
+
+using namespace pixel_terrain;
+
+BOOST_AUTO_TEST_CASE(height_map_round_trip) {
+    image::height_map heights;
+    BOOST_TEST(!heights.is_known(0, 0));
+    heights.set(0, 0, 64);
+    heights.set(511, 3, -64);
+    heights.set(3, 511, 0);
+
+    image::height_map restored;
+    BOOST_TEST(restored.deserialize(heights.serialize()));
+    BOOST_TEST(restored.get(0, 0) == 64);
+    BOOST_TEST(restored.get(511, 3) == -64);
+    BOOST_TEST(restored.is_known(3, 511));
+    BOOST_TEST(!restored.is_known(1, 0));
+    BOOST_TEST(!restored.is_known(-1, 0));
+    BOOST_TEST(!restored.is_known(0, 512));
+}
+
+BOOST_AUTO_TEST_CASE(height_map_broken_data) {
+    image::height_map heights;
+    heights.set(1, 1, 10);
+
+    BOOST_TEST(!heights.deserialize({1, 2, 3}));
+    std::vector<std::uint8_t> data = heights.serialize();
+    data.pop_back();
+    BOOST_TEST(!heights.deserialize(data));
+    BOOST_TEST(heights.get(1, 1) == 10);
+}
+
+BOOST_AUTO_TEST_CASE(height_map_file) {
+    std::filesystem::path path =
+        std::filesystem::temp_directory_path() /
+        (std::string("height_map_test") + image::height_map::FILE_SUFFIX);
+
+    image::height_map heights;
+    heights.set(5, 7, 100);
+    BOOST_TEST(heights.save(path));
+
+    image::height_map restored;
+    BOOST_TEST(restored.load(path));
+    BOOST_TEST(restored.get(5, 7) == 100);
+    BOOST_TEST(!restored.is_known(7, 5));
+
+    {
+        std::ofstream out(path, std::ios::binary | std::ios::trunc);
+        out << "broken";
+    }
+    BOOST_TEST(!restored.load(path));
+    BOOST_TEST(restored.get(5, 7) == 100);
+
+    std::filesystem::remove(path);
+    BOOST_TEST(!restored.load(path));
+}
@@ -3,13 +3,22 @@
 #ifndef IMAGE_HH
 #define IMAGE_HH
 
+#include <atomic>
+#include <cstddef>
+#include <deque>
 #include <filesystem>
+#include <map>
+#include <mutex>
+#include <utility>
+#include <vector>
 
 #include "image/containers.hh"
 #include "image/worker.hh"
 #include "logger/logger.hh"
 #include "nbt/chunk.hh"
+#include "nbt/journal.hh"
 #include "nbt/region.hh"
+#include "utils/memory_budget.hh"
 #include "utils/path_hack.hh"
 #include "utils/threaded_worker.hh"
 
@@ -17,33 +26,110 @@ namespace pixel_terrain::image {
     class image_generator {
         image::worker *worker_;
         threaded_worker<region_container *> *thread_pool_;
+        memory_budget *memory_budget_;
+        std::map<std::filesystem::path, anvil::journal *> journals_;
+
+        /* Input given to add_source(), with its region files. */
+        struct source {
+            std::vector<std::filesystem::path> regions;
+            /* Chunks to generate in each of REGIONS, if chunks are
+               specified in options. */
+            std::vector<std::vector<std::pair<int, int>>> chunks;
+            image::options options;
+        };
+        std::vector<source> sources_;
+
+        /* Regions queued but not yet taken by a worker, in queued order,
+           used to prefetch regions which will be processed soon.  Each
+           worker removes the region it took, so every region here is
+           alive. */
+        std::deque<region_container *> pending_;
+        std::mutex pending_mutex_;
+        std::size_t prefetch_depth_;
+        /* Regions which failed since the last wait(). */
+        std::atomic_size_t n_failed_ = 0;
+
+        /* Jobs waiting for a worker, per worker.  Queuing more regions
+           blocks, so that regions are not opened far ahead of workers. */
+        static constexpr std::size_t QUEUE_DEPTH_PER_JOB = 2;
+
         auto fetch() -> region_container *;
+        auto get_journal(std::filesystem::path const &cache_dir)
+            -> anvil::journal *;
+        auto make_container(std::filesystem::path const &region_file,
+                            options const &options) -> region_container *;
 
         void write_range_file(int start_x, int start_z, int end_x, int end_z,
                               options const &options);
+        /* Remove TAKEN from regions waiting, and prefetch the one which
+           has just come within the prefetch depth. */
+        void prefetch_next(region_container *taken);
+        void add_chunks_source(std::filesystem::path const &src,
+                               options const &options);
+        void flush_journals();
 
     public:
-        image_generator(options const &options) {
+        /* Generate regions with N_JOBS threads, using about MAX_MEMORY
+           bytes (or unlimited if 0) at most.  The limit is approximate: it
+           is checked against an estimate of each region from its location
+           table, and files read ahead are left to the page cache.  Files of
+           PREFETCH_DEPTH regions queued next are read ahead of workers. */
+        image_generator(unsigned int n_jobs, std::size_t max_memory,
+                        std::size_t prefetch_depth)
+            : prefetch_depth_(prefetch_depth) {
             worker_ = new image::worker;
+            memory_budget_ = new memory_budget(max_memory);
             thread_pool_ = new threaded_worker<region_container *>(
-                options.n_jobs(), [this](region_container *item) {
-                    this->worker_->generate_region(item);
+                n_jobs,
+                [this](region_container *item) {
+                    {
+                        /* Reserve before prefetching, so that the read
+                           ahead window moves only as workers get memory. */
+                        memory_budget::reservation r(
+                            memory_budget_,
+                            worker::region_memory_usage(item->get_region()));
+                        this->prefetch_next(item);
+                        if (!this->worker_->generate_region(item)) {
+                            ++n_failed_;
+                        }
+                    }
                     logger::progress_bar_process_one();
                     delete item;
-                });
+                },
+                n_jobs * QUEUE_DEPTH_PER_JOB);
         }
 
         ~image_generator() {
             delete thread_pool_;
+            delete memory_budget_;
             delete worker_;
+            for (auto &[dir, journal] : journals_) {
+                delete journal;
+            }
         }
 
         void start();
+        auto queue_size() -> std::size_t { return thread_pool_->queue_size(); }
+        /* Queue ITEM.  This must be called from one thread at a time,
+           since regions are prefetched assuming workers take them in
+           queued order. */
         void queue(region_container *item);
+        /* Add SRC, a region file or a directory of region files, to be
+           generated with OPTIONS by queue_sources().  If OPTIONS specifies
+           chunks, only regions containing them are added. */
+        void add_source(std::filesystem::path const &src,
+                        options const &options);
+        /* Queue regions of all sources added so far, interleaved by their
+           priority, and return how many are queued.  This blocks until the
+           last region is queued. */
+        auto queue_sources() -> std::size_t;
+        /* Queue REGION_FILE to be generated with OPTIONS. */
         void queue_region(std::filesystem::path const &region_file,
                           options const &options);
-        void queue_all_in_dir(std::filesystem::path const &dir,
-                              options const &options);
+        /* Wait until all the queued regions are generated, and save
+           caches of them.  Return how many regions failed to be read or
+           written since the last call. */
+        auto wait() -> std::size_t;
         void finish();
     };
 } // namespace pixel_terrain::image
@@ -0,0 +1,40 @@
+// SPDX-License-Identifier: MIT
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+
+#include "image/scheduler.hh"
+
+namespace pixel_terrain::image {
+    namespace {
+        /* Stride of priority 1.  Large enough that strides of different
+           priorities stay distinct after integer division. */
+        constexpr std::uint64_t STRIDE_BASE = 1 << 20;
+    } // namespace
+
+    auto job_scheduler::add_job(std::size_t n_items, unsigned int priority)
+        -> std::size_t {
+        std::uint64_t stride = STRIDE_BASE / std::max(priority, 1U);
+        jobs_.push_back(job{n_items, stride, stride});
+        return jobs_.size() - 1;
+    }
+
+    auto job_scheduler::next() -> int {
+        int best = -1;
+        for (std::size_t i = 0; i < jobs_.size(); ++i) {
+            if (jobs_[i].remaining == 0) {
+                continue;
+            }
+            if (best < 0 || jobs_[i].pass < jobs_[best].pass) {
+                best = static_cast<int>(i);
+            }
+        }
+
+        if (best >= 0) {
+            --jobs_[best].remaining;
+            jobs_[best].pass += jobs_[best].stride;
+        }
+        return best;
+    }
+} // namespace pixel_terrain::image
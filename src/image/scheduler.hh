@@ -0,0 +1,36 @@
+// SPDX-License-Identifier: MIT
+
+#ifndef SCHEDULER_HH
+#define SCHEDULER_HH
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+namespace pixel_terrain::image {
+    /* Decides order of regions of several sources rendered in one pool.
+       Regions of the sources are interleaved in proportion to their
+       priorities (stride scheduling), so that a small source, like the
+       end, doesn't wait for the whole overworld to be queued. */
+    class job_scheduler {
+        struct job {
+            std::size_t remaining;
+            std::uint64_t stride;
+            std::uint64_t pass;
+        };
+
+        std::vector<job> jobs_;
+
+    public:
+        /* Add job of N_ITEMS items, and return its index.  PRIORITY must be
+           at least 1.  All jobs must be added before calling next(). */
+        auto add_job(std::size_t n_items, unsigned int priority)
+            -> std::size_t;
+
+        /* Take an item, and return index of the job it belongs to, or -1
+           if all items are taken. */
+        auto next() -> int;
+    };
+} // namespace pixel_terrain::image
+
+#endif
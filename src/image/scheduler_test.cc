@@ -0,0 +1,58 @@
+// SPDX-License-Identifier: MIT
+
+#include <vector>
+
+#include <boost/test/tools/interface.hpp>
+#include <boost/test/unit_test.hpp>
+#include <boost/test/unit_test_suite.hpp>
+
+#include "image/scheduler.hh"
+
+using namespace pixel_terrain;
+
+BOOST_AUTO_TEST_CASE(scheduler_takes_all_items) {
+    image::job_scheduler s;
+    s.add_job(10, 1);
+    s.add_job(3, 1);
+    s.add_job(0, 5);
+
+    std::vector<int> taken(3);
+    for (int i = 0; i < 13; ++i) {
+        int job = s.next();
+        BOOST_TEST_REQUIRE(job >= 0);
+        ++taken[job];
+    }
+    BOOST_TEST(s.next() == -1);
+    BOOST_TEST(taken[0] == 10);
+    BOOST_TEST(taken[1] == 3);
+    BOOST_TEST(taken[2] == 0);
+}
+
+BOOST_AUTO_TEST_CASE(scheduler_interleaves) {
+    image::job_scheduler s;
+    s.add_job(1000, 1);
+    s.add_job(4, 1);
+
+    /* Small job is done within first few items instead of after the
+       large one. */
+    int small = 0;
+    for (int i = 0; i < 8; ++i) {
+        if (s.next() == 1) {
+            ++small;
+        }
+    }
+    BOOST_TEST(small == 4);
+}
+
+BOOST_AUTO_TEST_CASE(scheduler_priority) {
+    image::job_scheduler s;
+    s.add_job(1000, 4);
+    s.add_job(1000, 1);
+
+    std::vector<int> taken(2);
+    for (int i = 0; i < 400; ++i) {
+        ++taken[s.next()];
+    }
+    BOOST_TEST(taken[0] == 320);
+    BOOST_TEST(taken[1] == 80);
+}
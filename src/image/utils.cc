@@ -1,7 +1,13 @@
 // SPDX-License-Identifier: MIT
 
+#include <cctype>
+#include <charconv>
+#include <cstdint>
 #include <filesystem>
+#include <string>
+#include <system_error>
 #include <tuple>
+#include <utility>
 #include <vector>
 
 #include "utils/path_hack.hh"
@@ -110,4 +116,103 @@ namespace pixel_terrain::image {
 
         return std::make_tuple(x, z, true);
     }
+
+    auto parse_memory_size(std::string const &str)
+        -> std::pair<std::size_t, bool> {
+        std::size_t value = 0;
+        std::size_t i = 0;
+        for (; i < str.size() && '0' <= str[i] && str[i] <= '9'; ++i) {
+            if (value > SIZE_MAX / 10) {
+                return std::make_pair(0, false);
+            }
+            value = value * 10 + (str[i] - '0');
+        }
+        if (i == 0) {
+            return std::make_pair(0, false);
+        }
+
+        if (i == str.size()) {
+            return std::make_pair(value, true);
+        }
+        if (i + 1 != str.size()) {
+            return std::make_pair(0, false);
+        }
+
+        int shift;
+        switch (str[i]) {
+        case 'K':
+        case 'k':
+            shift = 10;
+            break;
+
+        case 'M':
+        case 'm':
+            shift = 20;
+            break;
+
+        case 'G':
+        case 'g':
+            shift = 30;
+            break;
+
+        default:
+            return std::make_pair(0, false);
+        }
+
+        if (value > (SIZE_MAX >> shift)) {
+            return std::make_pair(0, false);
+        }
+        return std::make_pair(value << shift, true);
+    }
+
+    auto dimension_region_dir(std::filesystem::path const &world,
+                              std::string const &dimen)
+        -> std::pair<std::filesystem::path, bool> {
+        if (dimen == "overworld") {
+            return std::make_pair(world / "region", true);
+        }
+        if (dimen == "nether") {
+            return std::make_pair(world / "DIM-1" / "region", true);
+        }
+        if (dimen == "end") {
+            return std::make_pair(world / "DIM1" / "region", true);
+        }
+        return std::make_pair(std::filesystem::path(), false);
+    }
+
+    auto parse_chunk_list(std::string const &str)
+        -> std::pair<std::vector<std::pair<int, int>>, bool> {
+        std::vector<std::pair<int, int>> chunks;
+        char const *p = str.data();
+        char const *end = str.data() + str.size();
+
+        for (;;) {
+            while (p != end && std::isspace(static_cast<unsigned char>(*p))) {
+                ++p;
+            }
+            if (p == end) {
+                break;
+            }
+
+            int x;
+            int z;
+            auto [x_end, x_ec] = std::from_chars(p, end, x);
+            if (x_ec != std::errc() || x_end == end || *x_end != ',') {
+                return std::make_pair(std::vector<std::pair<int, int>>(),
+                                      false);
+            }
+            auto [z_end, z_ec] = std::from_chars(x_end + 1, end, z);
+            if (z_ec != std::errc() ||
+                (z_end != end &&
+                 !std::isspace(static_cast<unsigned char>(*z_end)))) {
+                return std::make_pair(std::vector<std::pair<int, int>>(),
+                                      false);
+            }
+
+            chunks.emplace_back(x, z);
+            p = z_end;
+        }
+
+        return std::make_pair(std::move(chunks), true);
+    }
 } // namespace pixel_terrain::image
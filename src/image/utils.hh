@@ -4,6 +4,9 @@
 #define IMAGE_UTILS_HH
 
 #include <filesystem>
+#include <string>
+#include <utility>
+#include <vector>
 
 #include "utils/path_hack.hh"
 
@@ -18,6 +21,22 @@ namespace pixel_terrain::image {
     auto parse_region_file_path(
         std::filesystem::path const &file_path) noexcept(false)
         -> std::tuple<int, int, bool>;
+
+    /* Parse size in bytes, optionally followed by K, M or G for KiB, MiB
+       or GiB. */
+    auto parse_memory_size(std::string const &str)
+        -> std::pair<std::size_t, bool>;
+
+    /* Return region directory of DIMEN, which is overworld, nether or
+       end, in WORLD directory. */
+    auto dimension_region_dir(std::filesystem::path const &world,
+                              std::string const &dimen)
+        -> std::pair<std::filesystem::path, bool>;
+
+    /* Parse list of chunk coordinates in form of X,Z, separated by white
+       spaces. */
+    auto parse_chunk_list(std::string const &str)
+        -> std::pair<std::vector<std::pair<int, int>>, bool>;
 } // namespace pixel_terrain::image
 
 #endif
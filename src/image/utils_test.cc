@@ -35,3 +35,74 @@ BOOST_AUTO_TEST_CASE(format_output_name_test) {
     BOOST_TEST(image::format_output_name("", 10, 200) == "");
     BOOST_TEST(image::format_output_name("%a", 10, 200) == "%a");
 }
+
+BOOST_AUTO_TEST_CASE(parse_memory_size_test) {
+    {
+        auto [bytes, ok] = image::parse_memory_size("1234");
+        BOOST_TEST(ok);
+        BOOST_TEST(bytes == 1234);
+    }
+
+    {
+        auto [bytes, ok] = image::parse_memory_size("4K");
+        BOOST_TEST(ok);
+        BOOST_TEST(bytes == 4096);
+    }
+
+    {
+        auto [bytes, ok] = image::parse_memory_size("512M");
+        BOOST_TEST(ok);
+        BOOST_TEST(bytes == 512UL << 20U);
+    }
+
+    {
+        auto [bytes, ok] = image::parse_memory_size("2g");
+        BOOST_TEST(ok);
+        BOOST_TEST(bytes == 2UL << 30U);
+    }
+
+    BOOST_TEST(not image::parse_memory_size("").second);
+    BOOST_TEST(not image::parse_memory_size("M").second);
+    BOOST_TEST(not image::parse_memory_size("12X").second);
+    BOOST_TEST(not image::parse_memory_size("12MB").second);
+    BOOST_TEST(not image::parse_memory_size("-1").second);
+    BOOST_TEST(
+        not image::parse_memory_size("99999999999999999999999999G").second);
+}
+
+BOOST_AUTO_TEST_CASE(parse_chunk_list_test) {
+    {
+        auto [chunks, ok] = image::parse_chunk_list(" 1,2\n-3,-40\t0,0\n");
+        BOOST_TEST(ok);
+        BOOST_TEST_REQUIRE(chunks.size() == 3);
+        BOOST_TEST(chunks[0].first == 1);
+        BOOST_TEST(chunks[0].second == 2);
+        BOOST_TEST(chunks[1].first == -3);
+        BOOST_TEST(chunks[1].second == -40);
+        BOOST_TEST(chunks[2].first == 0);
+        BOOST_TEST(chunks[2].second == 0);
+    }
+
+    {
+        auto [chunks, ok] = image::parse_chunk_list("");
+        BOOST_TEST(ok);
+        BOOST_TEST(chunks.empty());
+    }
+
+    BOOST_TEST(not image::parse_chunk_list("1").second);
+    BOOST_TEST(not image::parse_chunk_list("1,").second);
+    BOOST_TEST(not image::parse_chunk_list("1 2").second);
+    BOOST_TEST(not image::parse_chunk_list("1,2,3").second);
+    BOOST_TEST(not image::parse_chunk_list("1,2x").second);
+    BOOST_TEST(not image::parse_chunk_list("99999999999,0").second);
+}
+
+BOOST_AUTO_TEST_CASE(dimension_region_dir_test) {
+    BOOST_TEST(image::dimension_region_dir("w", "overworld").first ==
+               std::filesystem::path("w/region"));
+    BOOST_TEST(image::dimension_region_dir("w", "nether").first ==
+               std::filesystem::path("w/DIM-1/region"));
+    BOOST_TEST(image::dimension_region_dir("w", "end").first ==
+               std::filesystem::path("w/DIM1/region"));
+    BOOST_TEST(not image::dimension_region_dir("w", "DIM1").second);
+}
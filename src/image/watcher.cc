@@ -0,0 +1,155 @@
+// SPDX-License-Identifier: MIT
+
+#include <algorithm>
+#include <cerrno>
+#include <chrono>
+#include <cstdint>
+#include <cstring>
+#include <filesystem>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include <poll.h>
+#include <sys/inotify.h>
+#include <unistd.h>
+
+#include "image/watcher.hh"
+#include "logger/logger.hh"
+
+namespace pixel_terrain::image {
+    namespace {
+        /* The game keeps region files open and writes chunks in place, so
+           IN_MODIFY is needed as well as IN_CLOSE_WRITE. */
+        constexpr std::uint32_t WATCH_EVENTS =
+            IN_CLOSE_WRITE | IN_MODIFY | IN_MOVED_TO;
+
+        auto is_region_file(std::filesystem::path const &path) -> bool {
+            return path.extension() == ".mca";
+        }
+
+        /* Poll FD for TIMEOUT, or forever if it is negative.  Return false
+           on timeout. */
+        auto wait_readable(int fd, int timeout) -> bool {
+            ::pollfd pfd{fd, POLLIN, 0};
+            for (;;) {
+                int ret = ::poll(&pfd, 1, timeout);
+                if (ret >= 0) {
+                    return ret > 0;
+                }
+                if (errno != EINTR) {
+                    throw std::runtime_error(std::strerror(errno));
+                }
+            }
+        }
+    } // namespace
+
+    region_watcher::region_watcher()
+        : fd_(::inotify_init1(IN_NONBLOCK | IN_CLOEXEC)) {
+        if (fd_ < 0) {
+            throw std::runtime_error(std::strerror(errno));
+        }
+    }
+
+    region_watcher::~region_watcher() { ::close(fd_); }
+
+    void region_watcher::add_directory(std::filesystem::path const &dir) {
+        int wd = ::inotify_add_watch(fd_, dir.string().c_str(),
+                                     WATCH_EVENTS | IN_ONLYDIR);
+        if (wd < 0) {
+            throw std::runtime_error(dir.string() + ": " +
+                                     std::strerror(errno));
+        }
+        /* Same directory given twice gets the same descriptor. */
+        dirs_.emplace(wd, dir);
+    }
+
+    void region_watcher::read_events(
+        std::vector<std::filesystem::path> *changed, bool *overflowed) {
+        alignas(::inotify_event) char buf[4096];
+
+        for (;;) {
+            ssize_t len = ::read(fd_, buf, sizeof(buf));
+            if (len < 0) {
+                if (errno == EINTR) {
+                    continue;
+                }
+                if (errno == EAGAIN || errno == EWOULDBLOCK) {
+                    return;
+                }
+                throw std::runtime_error(std::strerror(errno));
+            }
+
+            for (char *p = buf; p < buf + len;) {
+                auto *ev = reinterpret_cast<::inotify_event *>(p);
+                p += sizeof(::inotify_event) + ev->len;
+
+                if ((ev->mask & IN_Q_OVERFLOW) != 0) {
+                    *overflowed = true;
+                    continue;
+                }
+                auto dir = dirs_.find(ev->wd);
+                if (dir == dirs_.end()) {
+                    continue;
+                }
+                if ((ev->mask & IN_IGNORED) != 0) {
+                    /* Directory was removed. */
+                    ILOG("No longer watching %s\n",
+                         dir->second.string().c_str());
+                    dirs_.erase(dir);
+                    continue;
+                }
+                if (ev->len == 0 || (ev->mask & IN_ISDIR) != 0) {
+                    continue;
+                }
+                std::filesystem::path file = dir->second / ev->name;
+                if (is_region_file(file)) {
+                    changed->push_back(std::move(file));
+                }
+            }
+        }
+    }
+
+    auto region_watcher::wait(std::chrono::milliseconds quiet,
+                              std::chrono::milliseconds max_delay)
+        -> std::vector<std::filesystem::path> {
+        std::vector<std::filesystem::path> changed;
+        bool overflowed = false;
+
+        while (changed.empty() && !overflowed) {
+            wait_readable(fd_, -1);
+            read_events(&changed, &overflowed);
+        }
+
+        auto deadline = std::chrono::steady_clock::now() + max_delay;
+        for (;;) {
+            auto left = std::chrono::duration_cast<std::chrono::milliseconds>(
+                deadline - std::chrono::steady_clock::now());
+            left = std::min(left, quiet);
+            if (left.count() <= 0 ||
+                !wait_readable(fd_, static_cast<int>(left.count()))) {
+                break;
+            }
+            read_events(&changed, &overflowed);
+        }
+
+        if (overflowed) {
+            ILOG("Too many changes; checking every region.\n");
+            changed.clear();
+            for (auto const &[wd, dir] : dirs_) {
+                for (std::filesystem::directory_entry const &entry :
+                     std::filesystem::directory_iterator(dir)) {
+                    if (entry.is_regular_file() &&
+                        is_region_file(entry.path())) {
+                        changed.push_back(entry.path());
+                    }
+                }
+            }
+        }
+
+        std::sort(changed.begin(), changed.end());
+        changed.erase(std::unique(changed.begin(), changed.end()),
+                      changed.end());
+        return changed;
+    }
+} // namespace pixel_terrain::image
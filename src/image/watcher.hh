@@ -0,0 +1,44 @@
+// SPDX-License-Identifier: MIT
+
+#ifndef WATCHER_HH
+#define WATCHER_HH
+
+/* Notification of region files written by the game, using inotify. */
+
+#include <chrono>
+#include <filesystem>
+#include <unordered_map>
+#include <vector>
+
+namespace pixel_terrain::image {
+    class region_watcher {
+        int fd_;
+        /* Watched directories by watch descriptor. */
+        std::unordered_map<int, std::filesystem::path> dirs_;
+
+        void read_events(std::vector<std::filesystem::path> *changed,
+                         bool *overflowed);
+
+    public:
+        region_watcher();
+        ~region_watcher();
+
+        region_watcher(region_watcher const &) = delete;
+        auto operator=(region_watcher const &) -> region_watcher & = delete;
+
+        /* Watch region files in DIR.  Changed files are reported as DIR
+           joined with their names. */
+        void add_directory(std::filesystem::path const &dir);
+
+        /* Wait until region files are written, and return them once no
+           more are written for QUIET, or MAX_DELAY passed since the first
+           one.  The game writes many regions at once on autosave, so this
+           gathers them into one batch.  If the kernel dropped events,
+           every region in watched directories is returned. */
+        auto wait(std::chrono::milliseconds quiet,
+                  std::chrono::milliseconds max_delay)
+            -> std::vector<std::filesystem::path>;
+    };
+} // namespace pixel_terrain::image
+
+#endif
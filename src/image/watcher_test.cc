@@ -0,0 +1,76 @@
+// SPDX-License-Identifier: MIT
+
+#include <chrono>
+#include <filesystem>
+#include <fstream>
+#include <string>
+#include <vector>
+
+#include <boost/test/tools/interface.hpp>
+#include <boost/test/unit_test.hpp>
+#include <boost/test/unit_test_suite.hpp>
+
+#include "image/watcher.hh"
+
+using namespace pixel_terrain;
+
+namespace {
+    class temp_dir {
+        std::filesystem::path path_;
+
+    public:
+        temp_dir(std::string const &name)
+            : path_(std::filesystem::temp_directory_path() /
+                    ("pixel_terrain_" + name)) {
+            std::filesystem::remove_all(path_);
+            std::filesystem::create_directories(path_);
+        }
+
+        ~temp_dir() { std::filesystem::remove_all(path_); }
+
+        [[nodiscard]] auto path() const -> std::filesystem::path const & {
+            return path_;
+        }
+    };
+
+    void write_file(std::filesystem::path const &path) {
+        std::ofstream out(path);
+        out << "data";
+    }
+
+    constexpr std::chrono::milliseconds QUIET(50);
+    constexpr std::chrono::milliseconds MAX_DELAY(1000);
+} // namespace
+
+BOOST_AUTO_TEST_CASE(watcher_reports_written_regions) {
+    temp_dir dir("watcher_reports_written_regions");
+    image::region_watcher watcher;
+    watcher.add_directory(dir.path());
+
+    write_file(dir.path() / "level.dat");
+    write_file(dir.path() / "r.0.0.mca");
+    write_file(dir.path() / "r.0.0.mca");
+    write_file(dir.path() / "r.-1.0.mca");
+
+    std::vector<std::filesystem::path> changed =
+        watcher.wait(QUIET, MAX_DELAY);
+    BOOST_TEST_REQUIRE(changed.size() == 2);
+    BOOST_TEST(changed[0] == dir.path() / "r.-1.0.mca");
+    BOOST_TEST(changed[1] == dir.path() / "r.0.0.mca");
+}
+
+BOOST_AUTO_TEST_CASE(watcher_reports_moved_regions) {
+    temp_dir dir("watcher_reports_moved_regions");
+    temp_dir other("watcher_reports_moved_regions_other");
+    write_file(other.path() / "r.1.2.mca");
+
+    image::region_watcher watcher;
+    watcher.add_directory(dir.path());
+    std::filesystem::rename(other.path() / "r.1.2.mca",
+                            dir.path() / "r.1.2.mca");
+
+    std::vector<std::filesystem::path> changed =
+        watcher.wait(QUIET, MAX_DELAY);
+    BOOST_TEST_REQUIRE(changed.size() == 1);
+    BOOST_TEST(changed[0] == dir.path() / "r.1.2.mca");
+}
@@ -3,10 +3,16 @@
 /* Read whole mca files, and construct intermidiate representation of those,
    then decide pixel color and generate PNG image.. */
 
+#include <algorithm>
+#include <array>
+#include <bit>
 #include <cstdint>
 #include <filesystem>
 #include <memory>
 #include <string>
+#include <string_view>
+#include <system_error>
+#include <vector>
 
 #include "graphics/color.hh"
 #include "graphics/constants.hh"
@@ -15,125 +21,293 @@
 #include "image/image.hh"
 #include "image/worker.hh"
 #include "logger/logger.hh"
+#include "logger/metrics.hh"
+#include "logger/profile.hh"
 #include "nbt/constants.hh"
+#include "nbt/unpack.hh"
 
 namespace pixel_terrain::image {
-    auto worker::scan_chunk(anvil::chunk *chunk, options const &options) const
-        -> worker::pixel_states * {
+    namespace {
+        constexpr int COLUMNS_PER_CHUNK =
+            nbt::biomes::CHUNK_WIDTH * nbt::biomes::CHUNK_WIDTH;
+        constexpr std::string_view AIR = "minecraft:air";
+
+        /* Set of columns of a chunk, 1 bit for each. */
+        class column_mask {
+            static constexpr int WORD_BITS = 64;
+
+            std::array<std::uint64_t, COLUMNS_PER_CHUNK / WORD_BITS> bits_;
+
+        public:
+            column_mask() { bits_.fill(~std::uint64_t(0)); }
+
+            void clear(int i) {
+                bits_[i / WORD_BITS] &= ~(std::uint64_t(1) << (i % WORD_BITS));
+            }
+
+            [[nodiscard]] auto empty() const -> bool {
+                return std::all_of(bits_.begin(), bits_.end(),
+                                   [](std::uint64_t w) { return w == 0; });
+            }
+
+            /* Call F with index of each column in the set, in ascending
+               order.  F may clear the column it is called with. */
+            template <typename F> void for_each(F &&f) const {
+                for (int w = 0; w < static_cast<int>(bits_.size()); ++w) {
+                    for (std::uint64_t b = bits_[w]; b != 0; b &= b - 1) {
+                        f(w * WORD_BITS + std::countr_zero(b));
+                    }
+                }
+            }
+        };
+
+        auto is_air(std::string_view name) -> bool {
+            return name == "minecraft:air" || name == "minecraft:cave_air" ||
+                   name == "minecraft:void_air";
+        }
+
+        /* Height maps used to be stored in images as this chunk.  It is
+           dropped when the image is written again. */
+        constexpr char const *OLD_HEIGHTS_CHUNK = "ptHm";
+
+        /* Return path of the file storing height map of ITEM, or empty
+           path if it isn't generated with cache. */
+        auto height_map_path(region_container const &item)
+            -> std::filesystem::path {
+            std::filesystem::path const &cache_dir =
+                item.get_options()->cache_dir();
+            if (cache_dir.empty() || item.get_region_file().empty()) {
+                return {};
+            }
+            std::filesystem::path name = item.get_region_file().filename();
+            name.concat(height_map::FILE_SUFFIX);
+            return cache_dir / name;
+        }
+
+        auto load_region_image(std::filesystem::path const &path)
+            -> graphics::png * {
+            if (std::filesystem::exists(path)) {
+                try {
+                    logger::profile::scoped_timer timer(
+                        logger::profile::stage::PNG_DECODE);
+                    timer.add_bytes(std::filesystem::file_size(path));
+                    auto *image = new graphics::png(path);
+                    image->fit(nbt::biomes::BLOCK_PER_REGION_WIDTH,
+                               nbt::biomes::BLOCK_PER_REGION_WIDTH);
+                    return image;
+                } catch (std::exception const &) {
+                }
+            }
+
+            return new graphics::png(nbt::biomes::BLOCK_PER_REGION_WIDTH,
+                                     nbt::biomes::BLOCK_PER_REGION_WIDTH);
+        }
+    } // namespace
+
+    void worker::make_palette(anvil::chunk *chunk, int section,
+                              anvil::section_summary const &summary,
+                              std::uint16_t const *blocks,
+                              std::vector<palette_entry> *palette) {
+        std::size_t n_entries = blocks == nullptr
+                                    ? summary.value + 1
+                                    : chunk->get_palette(section)->size();
+        palette->clear();
+        for (std::size_t id = 0; id < n_entries; ++id) {
+            std::string_view name =
+                chunk->get_block_name(section, static_cast<std::uint16_t>(id));
+            auto color_itr = colors.find(name);
+            palette->push_back(palette_entry{
+                name, is_air(name),
+                color_itr == end(colors) ? nullptr : &color_itr->second});
+        }
+    }
+
+    auto worker::scan_block(anvil::chunk *chunk, column_scan *column,
+                            int y, palette_entry const &block,
+                            unknown_block_map *unknown_blocks,
+                            options const &options) -> bool {
+        using namespace graphics;
+
+        if (block.is_air) {
+            column->air_found = true;
+            column->prev_block = block.name;
+            return false;
+        }
+
+        if (options.is_nether() && !column->air_found) {
+            return false;
+        }
+
+        if (block.name == column->prev_block) {
+            return false;
+        }
+
+        column->prev_block = block.name;
+
+        if (block.color == nullptr) {
+            unknown_block_stat &stat =
+                (*unknown_blocks)[std::string(block.name)];
+            ++stat.count;
+            if (std::find(column->unknowns.begin(), column->unknowns.end(),
+                          &stat) == column->unknowns.end()) {
+                column->unknowns.push_back(&stat);
+                ++stat.pixels;
+            }
+            return false;
+        }
+
+        std::uint_fast32_t color = *block.color;
+        pixel_state &pixel_state = *column->pixel;
+
+        if (pixel_state.fg_color() == 0x00000000) {
+            pixel_state.set_fg_color(color);
+            pixel_state.set_top_height(y);
+            pixel_state.set_top_biome(
+                chunk->get_biome(column->x, y, column->z));
+            if (is_biome_overridden(block.name)) {
+                pixel_state.add_flags(pixel_state::BIOME_OVERRIDDEN);
+            }
+            if (graphics::alpha(color) == color::CHAN_FULL) {
+                pixel_state.set_mid_color(color);
+                pixel_state.set_mid_height(y);
+                pixel_state.set_bg_color(color);
+                pixel_state.set_opaque_height(y);
+                return true;
+            }
+
+            pixel_state.add_flags(pixel_state::IS_TRANSPARENT);
+        } else if (pixel_state.mid_color() == color::CHAN_MIN) {
+            pixel_state.set_mid_color(color);
+            pixel_state.set_mid_height(y);
+            if ((color & color::CHAN_MASK) == color::CHAN_FULL) {
+                pixel_state.set_bg_color(color);
+                pixel_state.set_opaque_height(y);
+                return true;
+            }
+        } else {
+            pixel_state.set_bg_color(
+                blend_color(pixel_state.bg_color(), color));
+            if ((pixel_state.bg_color() & color::CHAN_MASK) ==
+                color::CHAN_FULL) {
+                pixel_state.set_opaque_height(y);
+                return true;
+            }
+        }
+
+        return false;
+    }
+
+    void worker::scan_chunk(anvil::chunk *chunk, int chunk_x, int chunk_z,
+                            pixel_states *pixel_states,
+                            unknown_block_map *unknown_blocks,
+                            options const &options) {
         using namespace graphics;
 
         int max_y = chunk->get_max_height();
+        int min_y = chunk->get_min_height();
         if (options.is_nether()) {
             if (max_y > nbt::biomes::CHUNK_MAX_Y_NETHER) {
                 max_y = nbt::biomes::CHUNK_MAX_Y_NETHER;
             }
         }
 
-        auto *states = new pixel_states;
+        std::array<column_scan, COLUMNS_PER_CHUNK> columns;
         for (int z = 0; z < nbt::biomes::CHUNK_WIDTH; ++z) {
             for (int x = 0; x < nbt::biomes::CHUNK_WIDTH; ++x) {
-                bool air_found = false;
-                std::string prev_block;
-
-                pixel_state &pixel_state = get_pixel_state(states, x, z);
-
-                for (int y = max_y; y >= 0; --y) {
-                    std::string block;
-                    try {
-                        block = chunk->get_block(x, y, z);
-                    } catch (std::exception const &e) {
-                        ELOG("Error occurred while obtaining block\n");
-                        ELOG("%s\n", e.what());
-
-                        continue;
-                    }
+                column_scan &column = columns[z * nbt::biomes::CHUNK_WIDTH + x];
+                column.pixel = &get_pixel_state(
+                    pixel_states, chunk_x * nbt::biomes::CHUNK_WIDTH + x,
+                    chunk_z * nbt::biomes::CHUNK_WIDTH + z);
+                column.x = x;
+                column.z = z;
+            }
+        }
 
-                    if (block == "minecraft:air" ||
-                        block == "minecraft:cave_air" ||
-                        block == "minecraft:void_air") {
-                        air_found = true;
-                        prev_block = block;
-                        continue;
-                    }
+        /* Sections are scanned top down, a whole layer at once, in the
+           order blocks are stored.  Columns are dropped from ACTIVE once
+           blocks below can't be seen. */
+        column_mask active;
+        std::vector<palette_entry> palette;
+        for (int section = anvil::chunk::section_of(max_y);
+             section >= anvil::chunk::section_of(min_y) && !active.empty();
+             --section) {
+            anvil::section_summary summary;
+            std::uint16_t const *blocks;
+            try {
+                summary = chunk->get_section_summary(section);
+                blocks = chunk->get_section_blocks(section);
+                if (!summary.all_air) {
+                    make_palette(chunk, section, summary, blocks, &palette);
+                }
+            } catch (std::exception const &e) {
+                ELOG("Error occurred while obtaining block\n");
+                ELOG("%s\n", e.what());
+                continue;
+            }
 
-                    if (options.is_nether() && !air_found) {
-                        continue;
-                    }
+            if (summary.all_air) {
+                active.for_each([&](int i) {
+                    columns[i].air_found = true;
+                    columns[i].prev_block = AIR;
+                });
+                continue;
+            }
 
-                    if (block == prev_block) {
-                        continue;
+            int section_bottom = section * nbt::biomes::BLOCK_PER_SECTION;
+            int top = std::min(
+                max_y, section_bottom + nbt::biomes::BLOCK_PER_SECTION - 1);
+            /* Rest of single valued section is skipped as a repetition of
+               its top. */
+            int bottom = blocks == nullptr ? top : section_bottom;
+
+            for (int y = top; y >= bottom && !active.empty(); --y) {
+                int layer = y - section_bottom;
+                /* Still in the ceiling, for columns without air. */
+                bool ceiling = options.is_nether() &&
+                               ((summary.solid_layers >> layer) & 1) != 0;
+                std::uint16_t const *ids =
+                    blocks == nullptr ? nullptr
+                                      : blocks + layer * COLUMNS_PER_CHUNK;
+
+                active.for_each([&](int i) {
+                    column_scan &column = columns[i];
+                    if (ceiling && !column.air_found) {
+                        return;
                     }
 
-                    prev_block = block;
-
-                    auto color_itr = colors.find(block);
-                    if (color_itr == end(colors)) {
-                        std::unique_lock<std::mutex> lock(
-                            unknown_blocks_mutex_);
-                        unknown_blocks_.insert(block);
-                    } else {
-                        std::uint_fast32_t color = color_itr->second;
-
-                        if (pixel_state.fg_color() == 0x00000000) {
-                            pixel_state.set_fg_color(color);
-                            pixel_state.set_top_height(y);
-                            pixel_state.set_top_biome(
-                                chunk->get_biome(x, y, z));
-                            if (is_biome_overridden(block)) {
-                                pixel_state.add_flags(
-                                    pixel_state::BIOME_OVERRIDDEN);
-                            }
-                            if (graphics::alpha(color) == color::CHAN_FULL) {
-                                pixel_state.set_mid_color(color);
-                                pixel_state.set_mid_height(y);
-                                pixel_state.set_bg_color(color);
-                                pixel_state.set_opaque_height(y);
-                                break;
-                            }
-
-                            pixel_state.add_flags(pixel_state::IS_TRANSPARENT);
-                        } else if (pixel_state.mid_color() == color::CHAN_MIN) {
-                            pixel_state.set_mid_color(color);
-                            pixel_state.set_mid_height(y);
-                            if ((color & color::CHAN_MASK) ==
-                                color::CHAN_FULL) {
-                                pixel_state.set_bg_color(color);
-                                pixel_state.set_opaque_height(y);
-                                break;
-                            }
-                        } else {
-                            pixel_state.set_bg_color(
-                                blend_color(pixel_state.bg_color(), color));
-                            if ((pixel_state.bg_color() & color::CHAN_MASK) ==
-                                color::CHAN_FULL) {
-                                pixel_state.set_opaque_height(y);
-                                break;
-                            }
-                        }
+                    std::uint16_t id = ids == nullptr ? summary.value : ids[i];
+                    if (scan_block(chunk, &column, y, palette[id],
+                                   unknown_blocks, options)) {
+                        active.clear(i);
                     }
-                }
-                pixel_state.set_bg_color(pixel_state.bg_color() |
-                                         color::CHAN_FULL);
-                if (pixel_state.top_height() == pixel_state.opaque_height()) {
-                    pixel_state.set_fg_color(color::CHAN_MIN);
-                    pixel_state.set_mid_color(color::CHAN_MIN);
-                } else if (pixel_state.mid_height() ==
-                           pixel_state.opaque_height()) {
-                    pixel_state.set_mid_color(0x00000000);
-                }
+                });
             }
         }
 
-        return states;
+        for (column_scan &column : columns) {
+            pixel_state &pixel_state = *column.pixel;
+            pixel_state.set_bg_color(pixel_state.bg_color() |
+                                     color::CHAN_FULL);
+            if (pixel_state.top_height() == pixel_state.opaque_height()) {
+                pixel_state.set_fg_color(color::CHAN_MIN);
+                pixel_state.set_mid_color(color::CHAN_MIN);
+            } else if (pixel_state.mid_height() ==
+                       pixel_state.opaque_height()) {
+                pixel_state.set_mid_color(0x00000000);
+            }
+        }
     }
 
-    void worker::handle_biomes(pixel_states *pixel_states) {
+    void worker::handle_biomes(int chunk_x, int chunk_z,
+                               pixel_states *pixel_states) {
         using namespace graphics;
 
         /* process biome color overrides */
         for (int z = 0; z < nbt::biomes::CHUNK_WIDTH; ++z) {
             for (int x = 0; x < nbt::biomes::CHUNK_WIDTH; ++x) {
-                pixel_state &pixel_state = get_pixel_state(pixel_states, x, z);
+                pixel_state &pixel_state = get_pixel_state(
+                    pixel_states, chunk_x * nbt::biomes::CHUNK_WIDTH + x,
+                    chunk_z * nbt::biomes::CHUNK_WIDTH + z);
                 if (pixel_state.get_flag(pixel_state::BIOME_OVERRIDDEN)) {
                     std::uint32_t src_color;
                     if (pixel_state.fg_color() != color::CHAN_MIN) {
@@ -170,61 +344,77 @@ namespace pixel_terrain::image {
         }
     }
 
-    void worker::handle_inclination(pixel_states *pixel_states) {
+    void worker::handle_inclination(chunk_mask const &rendered,
+                                    height_map const &heights,
+                                    pixel_states *pixel_states) {
         constexpr int x_tone_change_ratio = 30;
         constexpr int z_tone_change_ratio = 10;
 
-        for (int z = 0; z < nbt::biomes::CHUNK_WIDTH; ++z) {
-            for (int x = 1; x < nbt::biomes::CHUNK_WIDTH; ++x) {
-                pixel_state &left = get_pixel_state(pixel_states, x - 1, z);
-                pixel_state &cur = get_pixel_state(pixel_states, x, z);
-                if (left.opaque_height() < cur.opaque_height()) {
-                    cur.set_bg_color(graphics::increase_brightness(
-                        cur.bg_color(), x_tone_change_ratio));
-                    if (x == 1) {
-                        left.set_bg_color(graphics::increase_brightness(
-                            left.bg_color(), x_tone_change_ratio));
-                    }
-                } else if (cur.opaque_height() < left.opaque_height()) {
-                    cur.set_bg_color(graphics::increase_brightness(
-                        cur.bg_color(), -x_tone_change_ratio));
-                    if (x == 1) {
-                        left.set_bg_color(graphics::increase_brightness(
-                            left.bg_color(), -x_tone_change_ratio));
-                    }
-                }
+        /* Tone of the slope from BEFORE to AFTER, where BEFORE is the
+           block on the left or upper side. */
+        auto slope = [](int before, int after, int ratio) -> int {
+            if (before < after) {
+                return ratio;
             }
-        }
+            if (after < before) {
+                return -ratio;
+            }
+            return 0;
+        };
+
+        /* Shading is done over the whole region at once, so that pixels
+           on the edge of chunk can be compared with the neighbour chunk.
+           Heights of neighbours which are not rendered this time come from
+           the cached height map.  If the height is not known at all (e.g.
+           on the edge of the region), the slope toward the opposite side is
+           used instead. */
+        for (int chunk_z = 0; chunk_z < nbt::biomes::CHUNK_PER_REGION_WIDTH;
+             ++chunk_z) {
+            for (int chunk_x = 0;
+                 chunk_x < nbt::biomes::CHUNK_PER_REGION_WIDTH; ++chunk_x) {
+                if (!rendered[chunk_z * nbt::biomes::CHUNK_PER_REGION_WIDTH +
+                              chunk_x]) {
+                    continue;
+                }
 
-        for (int z = 1; z < nbt::biomes::CHUNK_WIDTH; ++z) {
-            for (int x = 0; x < nbt::biomes::CHUNK_WIDTH; ++x) {
-                pixel_state &cur = get_pixel_state(pixel_states, x, z);
-                pixel_state &upper = get_pixel_state(pixel_states, x, z - 1);
-
-                if (upper.opaque_height() < cur.opaque_height()) {
-                    cur.set_bg_color(graphics::increase_brightness(
-                        cur.bg_color(), z_tone_change_ratio));
-                    if (z == 1) {
-                        upper.set_bg_color(graphics::increase_brightness(
-                            upper.bg_color(), z_tone_change_ratio));
-                    }
-                } else if (cur.opaque_height() < upper.opaque_height()) {
-                    cur.set_bg_color(graphics::increase_brightness(
-                        cur.bg_color(), -z_tone_change_ratio));
-                    if (z == 1) {
-                        upper.set_bg_color(graphics::increase_brightness(
-                            upper.bg_color(), -z_tone_change_ratio));
+                for (int z = chunk_z * nbt::biomes::CHUNK_WIDTH;
+                     z < (chunk_z + 1) * nbt::biomes::CHUNK_WIDTH; ++z) {
+                    for (int x = chunk_x * nbt::biomes::CHUNK_WIDTH;
+                         x < (chunk_x + 1) * nbt::biomes::CHUNK_WIDTH; ++x) {
+                        pixel_state &cur = get_pixel_state(pixel_states, x, z);
+                        int height = heights.get(x, z);
+
+                        int tone = 0;
+                        if (heights.is_known(x - 1, z)) {
+                            tone = slope(heights.get(x - 1, z), height,
+                                         x_tone_change_ratio);
+                        } else if (heights.is_known(x + 1, z)) {
+                            tone = slope(height, heights.get(x + 1, z),
+                                         x_tone_change_ratio);
+                        }
+                        if (tone != 0) {
+                            cur.set_bg_color(graphics::increase_brightness(
+                                cur.bg_color(), tone));
+                        }
+
+                        tone = 0;
+                        if (heights.is_known(x, z - 1)) {
+                            tone = slope(heights.get(x, z - 1), height,
+                                         z_tone_change_ratio);
+                        } else if (heights.is_known(x, z + 1)) {
+                            tone = slope(height, heights.get(x, z + 1),
+                                         z_tone_change_ratio);
+                        }
+                        if (tone != 0) {
+                            cur.set_bg_color(graphics::increase_brightness(
+                                cur.bg_color(), tone));
+                        }
                     }
                 }
             }
         }
     }
 
-    void worker::process_pipeline(pixel_states *pixel_states) {
-        handle_biomes(pixel_states);
-        handle_inclination(pixel_states);
-    }
-
     void worker::generate_image(int chunk_x, int chunk_z,
                                 pixel_states *pixel_states,
                                 graphics::png &image) {
@@ -232,19 +422,19 @@ namespace pixel_terrain::image {
 
         for (int z = 0; z < nbt::biomes::CHUNK_WIDTH; ++z) {
             for (int x = 0; x < nbt::biomes::CHUNK_WIDTH; ++x) {
-                pixel_state &pixel_state = get_pixel_state(pixel_states, x, z);
+                pixel_state &pixel_state = get_pixel_state(
+                    pixel_states, chunk_x * nbt::biomes::CHUNK_WIDTH + x,
+                    chunk_z * nbt::biomes::CHUNK_WIDTH + z);
 
                 std::uint_fast32_t bg_color = graphics::increase_brightness(
                     pixel_state.mid_color(),
-                    static_cast<int>(pixel_state.mid_height() -
-                                     pixel_state.top_height()) *
+                    (pixel_state.mid_height() - pixel_state.top_height()) *
                         height_tone_ratio);
                 std::uint_fast32_t color =
                     graphics::blend_color(pixel_state.fg_color(), bg_color);
                 bg_color = graphics::increase_brightness(
                     pixel_state.bg_color(),
-                    static_cast<int>(pixel_state.opaque_height() -
-                                     pixel_state.top_height()) *
+                    (pixel_state.opaque_height() - pixel_state.top_height()) *
                         height_tone_ratio);
                 color = graphics::blend_color(color, bg_color);
                 image.set_pixel(chunk_x * nbt::biomes::CHUNK_WIDTH + x,
@@ -254,141 +444,288 @@ namespace pixel_terrain::image {
     }
 
     void worker::generate_chunk(anvil::chunk *chunk, int chunk_x, int chunk_z,
-                                graphics::png &image,
-                                options const &options) const {
-        pixel_states *pixel_states = scan_chunk(chunk, options);
-        process_pipeline(pixel_states);
-        generate_image(chunk_x, chunk_z, pixel_states, image);
-        delete pixel_states;
+                                pixel_states *pixel_states,
+                                height_map *heights,
+                                unknown_block_map *unknown_blocks,
+                                options const &options) {
+        {
+            logger::profile::scoped_timer timer(
+                logger::profile::stage::SCAN_CHUNK);
+            scan_chunk(chunk, chunk_x, chunk_z, pixel_states, unknown_blocks,
+                       options);
+        }
+        {
+            logger::profile::scoped_timer timer(
+                logger::profile::stage::PROCESS_PIPELINE);
+            handle_biomes(chunk_x, chunk_z, pixel_states);
+        }
+
+        for (int z = chunk_z * nbt::biomes::CHUNK_WIDTH;
+             z < (chunk_z + 1) * nbt::biomes::CHUNK_WIDTH; ++z) {
+            for (int x = chunk_x * nbt::biomes::CHUNK_WIDTH;
+                 x < (chunk_x + 1) * nbt::biomes::CHUNK_WIDTH; ++x) {
+                heights->set(x, z,
+                             static_cast<std::int16_t>(
+                                 get_pixel_state(pixel_states, x, z)
+                                     .opaque_height()));
+            }
+        }
+    }
+
+    void worker::merge_unknown_blocks(unknown_block_map const &blocks) const {
+        if (blocks.empty()) {
+            return;
+        }
+
+        std::unique_lock<std::mutex> lock(unknown_blocks_mutex_);
+        for (auto const &[name, stat] : blocks) {
+            unknown_block_stat &total = unknown_blocks_[name];
+            total.count += stat.count;
+            total.pixels += stat.pixels;
+        }
     }
 
     worker::~worker() {
         if (!unknown_blocks_.empty()) {
             ILOG("Unknown blocks:\n");
-            for (std::string const &block : unknown_blocks_) {
-                ILOG(" %s\n", block.c_str());
+            for (auto const &[name, stat] : unknown_blocks_) {
+                ILOG(" %s (found %llu times, in %llu pixels)\n", name.c_str(),
+                     static_cast<unsigned long long>(stat.count),
+                     static_cast<unsigned long long>(stat.pixels));
             }
         }
     }
 
-    void worker::generate_region(region_container *item) const {
-        anvil::region *region = item->get_region();
-        DLOG("Generating %s...\n",
-             item->get_output_path()->filename().string().c_str());
-
-        graphics::png *image = nullptr;
+    auto worker::region_memory_usage(anvil::region *region) -> std::size_t {
+        if (region == nullptr) {
+            return 0;
+        }
 
-        /* minumum range of chunk update is radius of 3, so we can capture
-           all updated chunk with step of 6. but, we set this 4 since
-           4 can divide 16, our image (chunk) width. */
-        constexpr int scan_chunk_step = 4;
-        for (int chunk_z = 0; chunk_z < nbt::biomes::CHUNK_PER_REGION_WIDTH;
-             chunk_z += scan_chunk_step) {
-            int prev_chunk_x = -1;
-            for (int chunk_x = 0; chunk_x < nbt::biomes::CHUNK_PER_REGION_WIDTH;
-                 ++chunk_x) {
-                anvil::chunk *chunk;
+        /* RGBA pixels of the image. */
+        constexpr std::size_t image_bytes =
+            static_cast<std::size_t>(nbt::biomes::BLOCK_PER_REGION_WIDTH) *
+            nbt::biomes::BLOCK_PER_REGION_WIDTH * 4;
+        /* Unpacked block states of all sections of a chunk. */
+        constexpr std::size_t sections_bytes =
+            static_cast<std::size_t>(nbt::biomes::SECTION_COUNT) *
+            anvil::BLOCK_STATES_ENTRIES * sizeof(std::uint16_t);
+        /* Typical ratio of inflated NBT to the sectors holding it. */
+        constexpr std::size_t INFLATE_RATIO = 8;
+        constexpr std::size_t HEADER_SIZE = 2 * 4096;
+
+        /* Every chunk of the file is read through the mapping, while only
+           one chunk is inflated at a time. */
+        std::size_t file_bytes = HEADER_SIZE;
+        std::size_t max_chunk_bytes = 0;
+        for (anvil::chunk_location const &loc : region->chunk_locations()) {
+            file_bytes += loc.length;
+            max_chunk_bytes = std::max(max_chunk_bytes, loc.length);
+        }
 
-                try {
-                    /* Avoid nonexisting chunk to be recorded as reused chunk.
-                     */
-                    if (region->exists_chunk_data(chunk_x, chunk_z)) {
-                        continue;
-                    }
+        /* The image is held decoded, and once more while encoding. */
+        return sizeof(pixel_states) + sizeof(height_map) + 2 * image_bytes +
+               file_bytes + max_chunk_bytes * INFLATE_RATIO + sections_bytes;
+    }
 
-                    chunk = region->get_chunk_if_dirty(chunk_x, chunk_z);
-                } catch (std::exception const &e) {
-                    DLOG("Warning: parse error in %s\n",
-                         item->get_output_path()->filename().string().c_str());
-                    DLOG("%s\n", e.what());
-                    continue;
-                }
+    void worker::render_updated_chunks(anvil::region *region,
+                                       chunk_renderer const &render,
+                                       int stat_label) {
+        /* Chunks are visited in the order they are stored in the region
+           file, so that reading cold data results in sequential reads.
 
-                if (chunk == nullptr) {
-                    logger::record_stat(false, item->get_options()->label());
-                    continue;
+           minumum range of chunk update is radius of 3, so we can capture
+           all updated chunk with step of 6. but, we set this 4 since
+           4 can divide 16, our image (chunk) width.
+           First, we visit every chunk on every 4th row.  Then, we visit the
+           neighbours of chunks which turned out to be updated. */
+        constexpr int scan_chunk_step = 4;
+        constexpr int neighbour_radius = scan_chunk_step - 1;
+        chunk_mask neighbours;
+        neighbours.fill(false);
+
+        region->for_each_chunk(
+            [&](int chunk_x, int chunk_z, anvil::chunk *chunk) {
+                if (!render(chunk_x, chunk_z, chunk)) {
+                    logger::record_stat(false, stat_label);
+                    return;
                 }
 
-                if (image == nullptr) {
-                    if (std::filesystem::exists(*item->get_output_path())) {
-                        try {
-                            image = new graphics::png(*item->get_output_path());
-                            image->fit(nbt::biomes::BLOCK_PER_REGION_WIDTH,
-                                       nbt::biomes::BLOCK_PER_REGION_WIDTH);
-
-                        } catch (std::exception const &) {
-                            image = new graphics::png(
-                                nbt::biomes::BLOCK_PER_REGION_WIDTH,
-                                nbt::biomes::BLOCK_PER_REGION_WIDTH);
-                        }
-                    } else {
-                        image = new graphics::png(
-                            nbt::biomes::BLOCK_PER_REGION_WIDTH,
-                            nbt::biomes::BLOCK_PER_REGION_WIDTH);
+                int start_x = std::max(chunk_x - neighbour_radius, 0);
+                int end_x = std::min(chunk_x + neighbour_radius + 1,
+                                     nbt::biomes::CHUNK_PER_REGION_WIDTH);
+                for (int z = chunk_z + 1; z < chunk_z + scan_chunk_step;
+                     ++z) {
+                    for (int x = start_x; x < end_x; ++x) {
+                        neighbours[z * nbt::biomes::CHUNK_PER_REGION_WIDTH +
+                                   x] = true;
                     }
                 }
+            },
+            [](int /*chunk_x*/, int chunk_z) {
+                return chunk_z % scan_chunk_step == 0;
+            });
+
+        region->for_each_chunk(render, [&](int chunk_x, int chunk_z) {
+            return neighbours[chunk_z * nbt::biomes::CHUNK_PER_REGION_WIDTH +
+                              chunk_x];
+        });
+    }
 
-                logger::record_stat(true, item->get_options()->label());
-                generate_chunk(chunk, chunk_x, chunk_z, *image,
-                               *item->get_options());
-
-                delete chunk;
-
-                int start_x = chunk_x - scan_chunk_step + 1 > prev_chunk_x
-                                  ? chunk_x - scan_chunk_step + 1
-                                  : prev_chunk_x + 1;
-                int end_x = chunk_x + scan_chunk_step >
-                                    nbt::biomes::CHUNK_PER_REGION_WIDTH
-                                ? nbt::biomes::CHUNK_PER_REGION_WIDTH
-                                : chunk_x + scan_chunk_step;
-
-                for (int t_chunk_x = start_x; t_chunk_x < end_x; ++t_chunk_x) {
-                    for (int t_chunk_z = chunk_z + 1; t_chunk_z < chunk_z + 4;
-                         ++t_chunk_z) {
-                        try {
-                            if (region->exists_chunk_data(t_chunk_x,
-                                                          t_chunk_z)) {
-                                continue;
-                            }
-
-                            chunk = region->get_chunk_if_dirty(t_chunk_x,
-                                                               t_chunk_z);
-                        } catch (std::exception const &e) {
-                            DLOG("Parse error in %s\n", item->get_output_path()
-                                                            ->filename()
-                                                            .string()
-                                                            .c_str());
-                            DLOG("%s\n", e.what());
-                            continue;
-                        }
+    auto worker::generate_region(region_container *item) const -> bool {
+        static logger::metrics::counter &regions_rendered =
+            logger::metrics::get_counter(
+                "pixel_terrain_regions_rendered_total",
+                "Regions which had any chunk updated and were rendered.");
+        static logger::metrics::counter &regions_skipped =
+            logger::metrics::get_counter(
+                "pixel_terrain_regions_skipped_total",
+                "Regions skipped since no chunk was updated.");
 
-                        if (chunk == nullptr) {
-                            continue;
-                        }
+        anvil::region *region = item->get_region();
+        if (region == nullptr) {
+            return false;
+        }
+        DLOG("Generating %s...\n",
+             item->get_output_path()->filename().string().c_str());
 
-                        logger::record_stat(true, item->get_options()->label());
-                        generate_chunk(chunk, t_chunk_x, t_chunk_z, *image,
-                                       *item->get_options());
+        int stat_label = logger::stat_label(item->get_options()->label());
+        std::filesystem::path heights_path = height_map_path(*item);
+        graphics::png *image = nullptr;
+        pixel_states *pixel_states = nullptr;
+        height_map *heights = nullptr;
+        chunk_mask rendered;
+        rendered.fill(false);
+        unknown_block_map unknown_blocks;
+        /* Only the chunks given are generated, even if not updated. */
+        bool forced = !item->get_chunks().empty();
+
+        auto render = [&](int chunk_x, int chunk_z,
+                          anvil::chunk *chunk) -> bool {
+            if (chunk == nullptr) {
+                return false;
+            }
 
-                        delete chunk;
-                    }
+            try {
+                if (forced) {
+                    region->take(chunk_x, chunk_z, chunk);
+                } else if (!region->take_if_updated(chunk_x, chunk_z,
+                                                    chunk)) {
+                    return false;
+                }
+            } catch (std::exception const &e) {
+                DLOG("Warning: parse error in %s\n",
+                     item->get_output_path()->filename().string().c_str());
+                DLOG("%s\n", e.what());
+                return false;
+            }
+
+            if (image == nullptr) {
+                image = load_region_image(*item->get_output_path());
+                image->remove_private_chunk(OLD_HEIGHTS_CHUNK);
+                pixel_states = new worker::pixel_states;
+                heights = new height_map;
+                /* Without cache every chunk is rendered, unless chunks
+                   are given, whose edges then shade as region edges. */
+                if (!heights_path.empty()) {
+                    heights->load(heights_path);
                 }
-                prev_chunk_x = chunk_x + 3;
             }
+
+            logger::record_stat(true, stat_label);
+            generate_chunk(chunk, chunk_x, chunk_z, pixel_states, heights,
+                           &unknown_blocks, *item->get_options());
+            rendered[chunk_z * nbt::biomes::CHUNK_PER_REGION_WIDTH + chunk_x] =
+                true;
+
+            return true;
+        };
+
+        if (forced) {
+            chunk_mask targets;
+            targets.fill(false);
+            for (auto [chunk_x, chunk_z] : item->get_chunks()) {
+                targets[chunk_z * nbt::biomes::CHUNK_PER_REGION_WIDTH +
+                        chunk_x] = true;
+            }
+            region->for_each_chunk(
+                [&](int chunk_x, int chunk_z, anvil::chunk *chunk) {
+                    if (!render(chunk_x, chunk_z, chunk)) {
+                        logger::record_stat(false, stat_label);
+                    }
+                },
+                [&](int chunk_x, int chunk_z) {
+                    return targets[chunk_z *
+                                       nbt::biomes::CHUNK_PER_REGION_WIDTH +
+                                   chunk_x];
+                });
+        } else {
+            render_updated_chunks(region, render, stat_label);
         }
 
         if (image == nullptr) {
             DLOG("Exiting without generating; any chunk changed in %s\n",
                  item->get_output_path()->filename().string().c_str());
+            regions_skipped.add();
 
-            return;
+            return true;
+        }
+
+        merge_unknown_blocks(unknown_blocks);
+        regions_rendered.add();
+
+        {
+            logger::profile::scoped_timer timer(
+                logger::profile::stage::INCLINATION);
+            handle_inclination(rendered, *heights, pixel_states);
         }
+        {
+            logger::profile::scoped_timer timer(
+                logger::profile::stage::GENERATE_IMAGE);
+            for (int chunk_z = 0;
+                 chunk_z < nbt::biomes::CHUNK_PER_REGION_WIDTH; ++chunk_z) {
+                for (int chunk_x = 0;
+                     chunk_x < nbt::biomes::CHUNK_PER_REGION_WIDTH;
+                     ++chunk_x) {
+                    if (rendered[chunk_z *
+                                     nbt::biomes::CHUNK_PER_REGION_WIDTH +
+                                 chunk_x]) {
+                        generate_image(chunk_x, chunk_z, pixel_states, *image);
+                        timer.add_bytes(nbt::biomes::CHUNK_WIDTH *
+                                        nbt::biomes::CHUNK_WIDTH *
+                                        sizeof(std::uint32_t));
+                    }
+                }
+            }
+        }
+        delete pixel_states;
 
-        image->save(*item->get_output_path());
+        bool saved;
+        {
+            logger::profile::scoped_timer timer(
+                logger::profile::stage::PNG_ENCODE);
+            saved = image->save(*item->get_output_path());
+            if (saved) {
+                std::error_code ec;
+                std::uintmax_t size =
+                    std::filesystem::file_size(*item->get_output_path(), ec);
+                timer.add_bytes(ec ? 0 : size);
+            }
+        }
+        if (saved) {
+            if (!heights_path.empty() && !heights->save(heights_path)) {
+                ELOG("Failed to save %s\n", heights_path.string().c_str());
+            }
+            region->commit_last_update();
+        } else {
+            ELOG("Failed to save %s\n",
+                 item->get_output_path()->string().c_str());
+        }
+        delete heights;
         delete image;
 
         DLOG("Generated %s\n",
              item->get_output_path()->filename().string().c_str());
+        return saved;
     }
 
 } // namespace pixel_terrain::image
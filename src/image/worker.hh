@@ -6,23 +6,34 @@
 #include <array>
 #include <cstdint>
 #include <filesystem>
+#include <functional>
+#include <map>
 #include <memory>
 #include <mutex>
-#include <set>
 #include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
 
 #include "graphics/png.hh"
 #include "image/containers.hh"
+#include "image/height_map.hh"
 #include "nbt/chunk.hh"
 #include "nbt/constants.hh"
 
+namespace pixel_terrain::bench {
+    class worker_bench;
+}
+
 namespace pixel_terrain::image {
     class worker {
+        friend class bench::worker_bench;
+
         class pixel_state {
             std::uint32_t flags_ = 0;
-            unsigned int top_height_ = 0;
-            unsigned int mid_height_ = 0;
-            unsigned int opaque_height_ = 0;
+            int top_height_ = 0;
+            int mid_height_ = 0;
+            int opaque_height_ = 0;
             std::uint32_t fg_color_ = 0;
             std::uint32_t mid_color_ = 0;
             std::uint32_t bg_color_ = 0;
@@ -38,27 +49,19 @@ namespace pixel_terrain::image {
                 return static_cast<bool>(this->flags_ & field);
             }
 
-            void set_top_height(std::uint8_t top_height) {
-                top_height_ = top_height;
-            }
+            void set_top_height(int top_height) { top_height_ = top_height; }
 
-            [[nodiscard]] auto top_height() const -> std::uint8_t {
-                return top_height_;
-            }
+            [[nodiscard]] auto top_height() const -> int { return top_height_; }
 
-            void set_mid_height(unsigned int mid_height) {
-                mid_height_ = mid_height;
-            }
+            void set_mid_height(int mid_height) { mid_height_ = mid_height; }
 
-            [[nodiscard]] auto mid_height() const -> unsigned int {
-                return mid_height_;
-            }
+            [[nodiscard]] auto mid_height() const -> int { return mid_height_; }
 
-            void set_opaque_height(unsigned int opaque_height) {
+            void set_opaque_height(int opaque_height) {
                 opaque_height_ = opaque_height;
             };
 
-            [[nodiscard]] auto opaque_height() const -> unsigned int {
+            [[nodiscard]] auto opaque_height() const -> int {
                 return opaque_height_;
             }
 
@@ -93,8 +96,23 @@ namespace pixel_terrain::image {
                                         nbt::biomes::CHUNK_WIDTH *
                                         nbt::biomes::CHUNK_PER_REGION_WIDTH>;
 
+        struct unknown_block_stat {
+            /* Number of times the block was looked up. */
+            std::uint64_t count = 0;
+            /* Number of columns the block was found in. */
+            std::uint64_t pixels = 0;
+        };
+
+        /* Unknown blocks found while generating a region.  These are
+           collected without locking, and merged into unknown_blocks_ once
+           per region. */
+        using unknown_block_map =
+            std::unordered_map<std::string, unknown_block_stat>;
+
         mutable std::mutex unknown_blocks_mutex_;
-        mutable std::set<std::string> unknown_blocks_;
+        mutable std::map<std::string, unknown_block_stat> unknown_blocks_;
+
+        void merge_unknown_blocks(unknown_block_map const &blocks) const;
 
         static inline auto get_pixel_state(pixel_states *states, int x, int y)
             -> pixel_state & {
@@ -103,25 +121,84 @@ namespace pixel_terrain::image {
                              x];
         }
 
-        auto scan_chunk(anvil::chunk *chunk, options const &options) const
-            -> pixel_states *;
+        using chunk_mask =
+            std::array<bool, nbt::biomes::CHUNK_PER_REGION_WIDTH *
+                                 nbt::biomes::CHUNK_PER_REGION_WIDTH>;
+
+        /* Block of a section palette, looked up once per section. */
+        struct palette_entry {
+            std::string_view name;
+            bool is_air;
+            /* Colour of the block, or nullptr if it is unknown. */
+            std::uint32_t const *color;
+        };
+
+        /* State of a column while it is scanned downward. */
+        struct column_scan {
+            pixel_state *pixel;
+            int x;
+            int z;
+            bool air_found = false;
+            std::string_view prev_block;
+            /* Unknown blocks found in the column, to count pixels. */
+            std::vector<unknown_block_stat *> unknowns;
+        };
+
+        /* Look up blocks of palette of SECTION in PALETTE. */
+        static void make_palette(anvil::chunk *chunk, int section,
+                                 anvil::section_summary const &summary,
+                                 std::uint16_t const *blocks,
+                                 std::vector<palette_entry> *palette);
+
+        /* Add BLOCK at Y to COLUMN.  Return true if blocks below it can't
+           be seen. */
+        static auto scan_block(anvil::chunk *chunk, column_scan *column,
+                               int y, palette_entry const &block,
+                               unknown_block_map *unknown_blocks,
+                               options const &options) -> bool;
 
-        static void handle_biomes(pixel_states *pixel_states);
+        static void scan_chunk(anvil::chunk *chunk, int chunk_x, int chunk_z,
+                               pixel_states *pixel_states,
+                               unknown_block_map *unknown_blocks,
+                               options const &options);
 
-        static void handle_inclination(pixel_states *pixel_states);
+        static void handle_biomes(int chunk_x, int chunk_z,
+                                  pixel_states *pixel_states);
 
-        static void process_pipeline(pixel_states *pixel_states);
+        static void handle_inclination(chunk_mask const &rendered,
+                                       height_map const &heights,
+                                       pixel_states *pixel_states);
 
         static void generate_image(int chunk_x, int chunk_z,
                                    pixel_states *pixel_states,
                                    graphics::png &image);
 
-        void generate_chunk(anvil::chunk *chunk, int chunk_x, int chunk_z,
-                            graphics::png &image, options const &options) const;
+        static void generate_chunk(anvil::chunk *chunk, int chunk_x,
+                                   int chunk_z, pixel_states *pixel_states,
+                                   height_map *heights,
+                                   unknown_block_map *unknown_blocks,
+                                   options const &options);
+
+        /* Renders a chunk, and returns false if it is skipped. */
+        using chunk_renderer = std::function<bool(
+            int chunk_x, int chunk_z, anvil::chunk *chunk)>;
+        /* Render chunks updated since the last generation, reading as
+           few chunks as possible. */
+        static void render_updated_chunks(anvil::region *region,
+                                          chunk_renderer const &render,
+                                          int stat_label);
 
     public:
         ~worker();
-        void generate_region(region_container *item) const;
+        /* Render chunks of ITEM into its image.  Return false if the
+           region can't be read or the image can't be saved; a region with
+           no chunk updated is not a failure. */
+        auto generate_region(region_container *item) const -> bool;
+
+        /* Rough estimate of memory used while generating REGION, from the
+           sizes of its chunks in the location table.  This is used to limit
+           regions generated at once, and is 0 if REGION is nullptr. */
+        static auto region_memory_usage(anvil::region *region) -> std::size_t;
     };
 } // namespace pixel_terrain::image
 
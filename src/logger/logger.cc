@@ -1,15 +1,35 @@
 // SPDX-License-Identifier: MIT
 
-/* Logger, that can be used from different thread safely. */
+/* Logger, that can be used from different thread safely.
 
+   While asynchronous output is enabled, messages are formatted on the
+   calling thread and queued to a ring buffer of that thread, and a
+   dedicated thread drains the rings and writes them out.  Logging doesn't
+   lock nor wait for output; when the ring is full, errors are written
+   synchronously and other messages are dropped and counted.  The same
+   thread redraws the progress bar periodically.  When it is disabled
+   (before start or after stop), output is written synchronously. */
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
 #include <cstdarg>
 #include <cstdio>
+#include <deque>
 #include <iostream>
 #include <mutex>
 #include <string>
+#include <thread>
 #include <unordered_map>
+#include <utility>
+#include <vector>
 
 #ifdef OS_LINUX
+#include <csignal>
+
+#include <pthread.h>
 #include <unistd.h>
 #endif
 
@@ -17,14 +37,8 @@
 
 namespace pixel_terrain::logger {
     namespace {
-        std::mutex m;
-
-        struct statistics {
-            std::size_t generated;
-            std::size_t reused;
-        };
-
-        std::unordered_map<std::string, statistics> stats;
+        /* Serializes writes to stderr. */
+        std::mutex output_mutex;
 
 #ifdef OS_LINUX
         bool line_written = false;
@@ -39,105 +53,78 @@ namespace pixel_terrain::logger {
             }
         }
 #endif
-    } // namespace
-
-    unsigned int log_level;
-
-    void print_log(unsigned int log_level, char const *fmt, ...) {
-        if (logger::log_level < log_level) {
-            return;
-        }
-
-        std::va_list ap;
-        va_start(ap, fmt);
 
-        std::unique_lock<std::mutex> lock(m);
+        void write_log(unsigned int log_level, std::string const &message) {
+            std::unique_lock<std::mutex> lock(output_mutex);
 
 #ifdef OS_LINUX
-        check_tty();
-        line_written = true;
+            check_tty();
+            line_written = true;
 
-        switch (log_level) {
-        case logger::INFO:
-            if (is_tty) {
-                std::fputs("\e[1mPixelTerrain-\e[1;32mINFO\e[0m: ", stderr);
-            } else {
-                std::fputs("PixelTerrain-INFO: ", stderr);
+            switch (log_level) {
+            case logger::INFO:
+                if (is_tty) {
+                    std::fputs("\e[1mPixelTerrain-\e[1;32mINFO\e[0m: ",
+                               stderr);
+                } else {
+                    std::fputs("PixelTerrain-INFO: ", stderr);
+                }
+                break;
+            case logger::DEBUG:
+                if (is_tty) {
+                    std::fputs("\e[1mPixelTerrain-\e[1;33mDEBUG\e[0m: ",
+                               stderr);
+                } else {
+                    std::fputs("PixelTerrain-DEBUG: ", stderr);
+                }
+                break;
+            case logger::ERROR:
+                if (is_tty) {
+                    std::fputs("\e[1mPixelTerrain-\e[1;31mERROR\e[0m: ",
+                               stderr);
+                } else {
+                    std::fputs("PixelTerrain-ERROR: ", stderr);
+                }
+                break;
             }
-            break;
-        case logger::DEBUG:
-            if (is_tty) {
-                std::fputs("\e[1mPixelTerrain-\e[1;33mDEBUG\e[0m: ", stderr);
-            } else {
+#else /* not OS_LINUX */
+            switch (log_level) {
+            case logger::INFO:
+                std::fputs("PixelTerrain-INFO: ", stderr);
+                break;
+            case logger::DEBUG:
                 std::fputs("PixelTerrain-DEBUG: ", stderr);
-            }
-            break;
-        case logger::ERROR:
-            if (is_tty) {
-                std::fputs("\e[1mPixelTerrain-\e[1;31mERROR\e[0m: ", stderr);
-            } else {
+                break;
+            case logger::ERROR:
                 std::fputs("PixelTerrain-ERROR: ", stderr);
+                break;
             }
-            break;
-        }
-#else /* not OS_LINUX */
-        switch (log_level) {
-        case logger::INFO:
-            std::fputs("PixelTerrain-INFO: ", stderr);
-            break;
-        case logger::DEBUG:
-            std::fputs("PixelTerrain-DEBUG: ", stderr);
-            break;
-        case logger::ERROR:
-            std::fputs("PixelTerrain-ERROR: ", stderr);
-            break;
-        }
 #endif
 
-        std::vfprintf(stderr, fmt, ap);
-
-        va_end(ap);
-    }
-
-    void record_stat(bool regenerated, std::string const &label) {
-        std::unique_lock<std::mutex> lock(m);
-
-        if (regenerated) {
-            ++stats[label].generated;
-        } else {
-            ++stats[label].reused;
+            std::fputs(message.c_str(), stderr);
         }
-    }
-
-    void show_stat() {
-        print_log(INFO, "STATISTICS\n");
-        for (auto itr = stats.begin(), E = stats.end(); itr != E; ++itr) {
-            statistics s = itr->second;
-            ILOG("  %s\n",
-                 itr->first.empty() ? "<no label>" : itr->first.c_str());
-            ILOG("   |- Chunks generated: %zu\n", s.generated);
-            ILOG("   |- Chunks reused:    %zu\n", s.reused);
-            ILOG("   |- %% reused:         %zu\n",
-                 (s.reused * 100) / (s.generated + s.reused));
-        }
-    }
+    } // namespace
 
     namespace {
         inline constexpr unsigned int COMPLETE_PROGRESS = 100;
 
-        std::size_t progress_max;
-        std::size_t progress_current;
+        std::atomic<std::size_t> progress_max;
+        std::atomic<std::size_t> progress_current;
         unsigned int old_progress = COMPLETE_PROGRESS + 1;
 
         void progress_print() {
+            std::unique_lock<std::mutex> lock(output_mutex);
+
+            std::size_t max = progress_max.load(std::memory_order_relaxed);
+            std::size_t current =
+                progress_current.load(std::memory_order_relaxed);
             unsigned int progress;
-            if (progress_max == 0) {
+            if (max == 0) {
                 progress = 0;
-            } else if (progress_max <= progress_current) {
+            } else if (max <= current) {
                 progress = COMPLETE_PROGRESS;
             } else {
-                progress =
-                    (progress_current * COMPLETE_PROGRESS) / progress_max;
+                progress = (current * COMPLETE_PROGRESS) / max;
             }
             if (old_progress != progress) {
 #ifdef OS_LINUX
@@ -161,14 +148,413 @@ namespace pixel_terrain::logger {
         }
     } // namespace
 
+    namespace {
+        inline constexpr std::size_t RING_CAPACITY = 256;
+        inline constexpr std::chrono::milliseconds PROGRESS_INTERVAL(100);
+
+        struct log_entry {
+            std::chrono::steady_clock::time_point time;
+            unsigned int log_level;
+            std::string message;
+        };
+
+        /* Messages logged by a thread.  Only the owner thread pushes and
+           only the sink thread pops, so neither of them locks. */
+        struct log_ring {
+            std::array<log_entry, RING_CAPACITY> entries;
+            /* Counted up forever, and taken modulo RING_CAPACITY. */
+            std::atomic<std::size_t> head = 0;
+            std::atomic<std::size_t> tail = 0;
+            /* Set while the owner may push after seeing the sink running,
+               so that stop_async_output() can wait for it. */
+            std::atomic<bool> pushing = false;
+            /* Set when the owner thread exits.  The sink frees the ring
+               after draining it. */
+            std::atomic<bool> orphaned = false;
+        };
+
+        struct ring_owner {
+            log_ring *ring = nullptr;
+
+            ~ring_owner() {
+                if (ring != nullptr) {
+                    ring->orphaned.store(true, std::memory_order_release);
+                }
+            }
+        };
+
+        /* Guards the list of rings, which is changed only when a thread
+           logs for the first time and when the sink frees rings. */
+        std::mutex rings_mutex;
+        std::vector<log_ring *> rings;
+        thread_local ring_owner local_ring;
+        /* Messages dropped since the ring of their thread was full. */
+        std::atomic<std::size_t> n_dropped;
+
+        std::mutex sink_mutex;
+        std::condition_variable sink_wakeup;
+        std::atomic<bool> sink_running = false;
+        bool sink_stopping = false;
+        std::thread *sink_thread;
+
+        auto get_local_ring() -> log_ring * {
+            if (local_ring.ring == nullptr) {
+                local_ring.ring = new log_ring;
+                std::unique_lock<std::mutex> lock(rings_mutex);
+                rings.push_back(local_ring.ring);
+            }
+            return local_ring.ring;
+        }
+
+        /* Move messages in all rings to BATCH in the order they were
+           logged, and free rings of exited threads. */
+        void drain_rings(std::vector<log_entry> *batch) {
+            std::unique_lock<std::mutex> lock(rings_mutex);
+            std::erase_if(rings, [batch](log_ring *ring) {
+                /* Read before draining, so that nothing is pushed after. */
+                bool orphaned = ring->orphaned.load(std::memory_order_acquire);
+                std::size_t head = ring->head.load(std::memory_order_relaxed);
+                std::size_t tail = ring->tail.load(std::memory_order_acquire);
+                for (; head != tail; ++head) {
+                    batch->push_back(
+                        std::move(ring->entries[head % RING_CAPACITY]));
+                }
+                ring->head.store(head, std::memory_order_release);
+
+                if (orphaned) {
+                    delete ring;
+                }
+                return orphaned;
+            });
+            lock.unlock();
+
+            std::stable_sort(batch->begin(), batch->end(),
+                             [](log_entry const &a, log_entry const &b) {
+                                 return a.time < b.time;
+                             });
+        }
+
+        void sink_main() {
+#ifdef OS_LINUX
+            /* Leave signals to threads which expect them. */
+            ::sigset_t sigs;
+            ::sigfillset(&sigs);
+            ::pthread_sigmask(SIG_BLOCK, &sigs, nullptr);
+#endif
+
+            std::vector<log_entry> batch;
+            for (;;) {
+                bool stopping;
+                {
+                    /* Producers notify without the lock, so a wakeup may
+                       be missed; the message then waits for the next
+                       tick. */
+                    std::unique_lock<std::mutex> lock(sink_mutex);
+                    if (!sink_stopping) {
+                        sink_wakeup.wait_for(lock, PROGRESS_INTERVAL);
+                    }
+                    stopping = sink_stopping;
+                }
+
+                drain_rings(&batch);
+                for (log_entry &entry : batch) {
+                    write_log(entry.log_level, entry.message);
+                }
+                batch.clear();
+
+                std::size_t dropped = n_dropped.exchange(0);
+                if (dropped != 0) {
+                    write_log(ERROR, std::to_string(dropped) +
+                                         " log messages were dropped.\n");
+                }
+
+                if (progress_max.load(std::memory_order_relaxed) != 0) {
+                    progress_print();
+                }
+
+                if (stopping) {
+                    break;
+                }
+            }
+        }
+
+        /* Queue MESSAGE to the ring of this thread.  Return false if it
+           must be written synchronously instead. */
+        auto push_log(unsigned int log_level, std::string *message) -> bool {
+            if (!sink_running.load(std::memory_order_relaxed)) {
+                return false;
+            }
+
+            log_ring *ring = get_local_ring();
+            ring->pushing.store(true);
+            /* Pairs with stop_async_output(), which clears sink_running
+               and then waits for PUSHING to be cleared. */
+            if (!sink_running.load()) {
+                ring->pushing.store(false, std::memory_order_release);
+                return false;
+            }
+
+            std::size_t tail = ring->tail.load(std::memory_order_relaxed);
+            std::size_t head = ring->head.load(std::memory_order_acquire);
+            if (tail - head == RING_CAPACITY) {
+                ring->pushing.store(false, std::memory_order_release);
+                /* Errors are never lost; others are dropped rather than
+                   slowing the caller down. */
+                if (log_level == ERROR) {
+                    return false;
+                }
+                n_dropped.fetch_add(1, std::memory_order_relaxed);
+                return true;
+            }
+
+            log_entry &entry = ring->entries[tail % RING_CAPACITY];
+            entry.time = std::chrono::steady_clock::now();
+            entry.log_level = log_level;
+            entry.message = std::move(*message);
+            ring->tail.store(tail + 1, std::memory_order_release);
+            ring->pushing.store(false, std::memory_order_release);
+
+            /* The sink drains every tick anyway; wake it up only for the
+               first message since it last drained. */
+            if (tail == head) {
+                sink_wakeup.notify_one();
+            }
+            return true;
+        }
+
+        auto format(char const *fmt, std::va_list ap) -> std::string {
+            std::va_list ap2;
+            va_copy(ap2, ap);
+            int len = std::vsnprintf(nullptr, 0, fmt, ap2);
+            va_end(ap2);
+            if (len < 0) {
+                return {};
+            }
+
+            std::string result(len + 1, '\0');
+            std::vsnprintf(result.data(), result.size(), fmt, ap);
+            result.pop_back();
+            return result;
+        }
+    } // namespace
+
+    unsigned int log_level;
+
+    void start_async_output() {
+        std::unique_lock<std::mutex> lock(sink_mutex);
+        if (sink_running) {
+            return;
+        }
+        sink_stopping = false;
+        sink_thread = new std::thread(&sink_main);
+        sink_running = true;
+    }
+
+    void stop_async_output() {
+        std::thread *thread;
+        {
+            std::unique_lock<std::mutex> lock(sink_mutex);
+            if (!sink_running) {
+                return;
+            }
+            /* Messages logged from now on are written synchronously. */
+            sink_running = false;
+        }
+
+        /* Wait for threads which saw the sink running to finish pushing,
+           so that the last drain gets their messages. */
+        {
+            std::unique_lock<std::mutex> lock(rings_mutex);
+            for (log_ring *ring : rings) {
+                while (ring->pushing.load()) {
+                    std::this_thread::yield();
+                }
+            }
+        }
+
+        {
+            std::unique_lock<std::mutex> lock(sink_mutex);
+            sink_stopping = true;
+            thread = sink_thread;
+            sink_thread = nullptr;
+        }
+        sink_wakeup.notify_all();
+        thread->join();
+        delete thread;
+    }
+
+    void print_log(unsigned int log_level, char const *fmt, ...) {
+        if (logger::log_level < log_level) {
+            return;
+        }
+
+        std::va_list ap;
+        va_start(ap, fmt);
+        std::string message = format(fmt, ap);
+        va_end(ap);
+
+        if (!push_log(log_level, &message)) {
+            write_log(log_level, message);
+        }
+    }
+
+    namespace {
+        struct statistics {
+            std::atomic<std::size_t> generated;
+            std::atomic<std::size_t> reused;
+        };
+
+        /* Counters owned by a thread, indexed by label id.  Only the owner
+           thread increments them, and the mutex is needed only when the
+           table grows or is read by other threads. */
+        struct thread_statistics {
+            std::mutex mutex;
+            std::deque<statistics> stats;
+        };
+
+        std::mutex labels_mutex;
+        std::vector<std::string> labels;
+        std::unordered_map<std::string, int> label_ids;
+        std::vector<thread_statistics *> thread_tables;
+        /* Generated and reused counts of threads which have exited, by
+           label id. */
+        std::vector<std::pair<std::size_t, std::size_t>> retired_stats;
+
+        /* Fold the table of exiting thread into retired_stats, so that
+           tables don't pile up as threads come and go. */
+        void retire_table(thread_statistics *table) {
+            std::unique_lock<std::mutex> lock(labels_mutex);
+            std::erase(thread_tables, table);
+            if (retired_stats.size() < table->stats.size()) {
+                retired_stats.resize(table->stats.size());
+            }
+            for (std::size_t i = 0; i < table->stats.size(); ++i) {
+                retired_stats[i].first += table->stats[i].generated.load(
+                    std::memory_order_relaxed);
+                retired_stats[i].second +=
+                    table->stats[i].reused.load(std::memory_order_relaxed);
+            }
+            delete table;
+        }
+
+        struct table_owner {
+            thread_statistics *table = nullptr;
+
+            ~table_owner() {
+                if (table != nullptr) {
+                    retire_table(table);
+                }
+            }
+        };
+
+        thread_local table_owner local_table;
+
+        auto get_local_table() -> thread_statistics * {
+            if (local_table.table == nullptr) {
+                local_table.table = new thread_statistics;
+                std::unique_lock<std::mutex> lock(labels_mutex);
+                thread_tables.push_back(local_table.table);
+            }
+            return local_table.table;
+        }
+    } // namespace
+
+    auto stat_label(std::string const &label) -> int {
+        std::unique_lock<std::mutex> lock(labels_mutex);
+
+        auto [itr, inserted] = label_ids.try_emplace(label, labels.size());
+        if (inserted) {
+            labels.push_back(label);
+        }
+        return itr->second;
+    }
+
+    void record_stat(bool regenerated, int label) {
+        thread_statistics *table = get_local_table();
+        if (table->stats.size() <= static_cast<std::size_t>(label)) {
+            std::unique_lock<std::mutex> lock(table->mutex);
+            table->stats.resize(label + 1);
+        }
+
+        statistics &s = table->stats[label];
+        if (regenerated) {
+            s.generated.fetch_add(1, std::memory_order_relaxed);
+        } else {
+            s.reused.fetch_add(1, std::memory_order_relaxed);
+        }
+    }
+
+    auto get_stat(int label) -> std::pair<std::size_t, std::size_t> {
+        std::unique_lock<std::mutex> lock(labels_mutex);
+
+        std::size_t generated = 0;
+        std::size_t reused = 0;
+        if (static_cast<std::size_t>(label) < retired_stats.size()) {
+            generated = retired_stats[label].first;
+            reused = retired_stats[label].second;
+        }
+        for (thread_statistics *table : thread_tables) {
+            std::unique_lock<std::mutex> table_lock(table->mutex);
+            if (static_cast<std::size_t>(label) < table->stats.size()) {
+                statistics const &s = table->stats[label];
+                generated += s.generated.load(std::memory_order_relaxed);
+                reused += s.reused.load(std::memory_order_relaxed);
+            }
+        }
+        return {generated, reused};
+    }
+
+    auto get_total_stat() -> std::pair<std::size_t, std::size_t> {
+        std::unique_lock<std::mutex> lock(labels_mutex);
+
+        std::size_t generated = 0;
+        std::size_t reused = 0;
+        for (auto [g, r] : retired_stats) {
+            generated += g;
+            reused += r;
+        }
+        for (thread_statistics *table : thread_tables) {
+            std::unique_lock<std::mutex> table_lock(table->mutex);
+            for (statistics const &s : table->stats) {
+                generated += s.generated.load(std::memory_order_relaxed);
+                reused += s.reused.load(std::memory_order_relaxed);
+            }
+        }
+        return {generated, reused};
+    }
+
+    void show_stat() {
+        std::vector<std::string> names;
+        {
+            std::unique_lock<std::mutex> lock(labels_mutex);
+            names = labels;
+        }
+
+        print_log(INFO, "STATISTICS\n");
+        for (std::size_t i = 0; i < names.size(); ++i) {
+            auto [generated, reused] = get_stat(static_cast<int>(i));
+            if (generated + reused == 0) {
+                continue;
+            }
+            ILOG("  %s\n", names[i].empty() ? "<no label>" : names[i].c_str());
+            ILOG("   |- Chunks generated: %zu\n", generated);
+            ILOG("   |- Chunks reused:    %zu\n", reused);
+            ILOG("   |- %% reused:         %zu\n",
+                 (reused * 100) / (generated + reused));
+        }
+    }
+
     void progress_bar_increase_total(int n) {
-        std::unique_lock<std::mutex> lock(m);
-        progress_max += n;
-        progress_print();
+        progress_max.fetch_add(n, std::memory_order_relaxed);
+        if (!sink_running) {
+            progress_print();
+        }
     }
+
     void progress_bar_process_one() {
-        std::unique_lock<std::mutex> lock(m);
-        ++progress_current;
-        progress_print();
+        progress_current.fetch_add(1, std::memory_order_relaxed);
+        if (!sink_running) {
+            progress_print();
+        }
     }
 } // namespace pixel_terrain::logger
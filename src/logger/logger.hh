@@ -3,7 +3,9 @@
 #ifndef LOGGER_HH
 #define LOGGER_HH
 
+#include <cstddef>
 #include <string>
+#include <utility>
 
 namespace pixel_terrain::logger {
     extern unsigned int log_level;
@@ -15,7 +17,21 @@ namespace pixel_terrain::logger {
     __attribute__((format(printf, 2, 3))) void print_log(unsigned int log_level,
                                                          char const *fmt, ...);
 
-    void record_stat(bool regenerated, std::string const &label);
+    /* Start writing log from a dedicated thread.  Call stop_async_output()
+       before exit to flush pending messages; messages logged after that are
+       written synchronously. */
+    void start_async_output();
+    void stop_async_output();
+
+    /* Return id of LABEL to be passed to record_stat().  Ids are valid
+       until the process exits. */
+    auto stat_label(std::string const &label) -> int;
+    /* Count a chunk.  This doesn't lock in most cases. */
+    void record_stat(bool regenerated, int label);
+    /* Return number of generated and reused chunks for LABEL. */
+    auto get_stat(int label) -> std::pair<std::size_t, std::size_t>;
+    /* Return sum of get_stat() of all labels. */
+    auto get_total_stat() -> std::pair<std::size_t, std::size_t>;
     void show_stat();
 
     void progress_bar_increase_total(int n);
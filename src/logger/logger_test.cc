@@ -0,0 +1,149 @@
+// SPDX-License-Identifier: MIT
+
+#include <cstddef>
+#include <cstdio>
+#include <fstream>
+#include <string>
+#include <thread>
+#include <vector>
+
+#ifdef OS_LINUX
+#include <unistd.h>
+#endif
+
+#include <boost/test/tools/interface.hpp>
+#include <boost/test/unit_test.hpp>
+#include <boost/test/unit_test_suite.hpp>
+
+#include "logger/logger.hh"
+
+using namespace pixel_terrain;
+
+BOOST_AUTO_TEST_CASE(stat_from_threads) {
+    int foo = logger::stat_label("foo");
+    int bar = logger::stat_label("bar");
+    BOOST_TEST(foo != bar);
+    BOOST_TEST(logger::stat_label("foo") == foo);
+
+    std::vector<std::thread> threads;
+    for (int i = 0; i < 4; ++i) {
+        threads.emplace_back([foo, bar, i] {
+            for (int j = 0; j < 1000; ++j) {
+                logger::record_stat(true, foo);
+            }
+            logger::record_stat(false, i % 2 == 0 ? foo : bar);
+        });
+    }
+    for (std::thread &t : threads) {
+        t.join();
+    }
+
+    auto [foo_generated, foo_reused] = logger::get_stat(foo);
+    BOOST_TEST(foo_generated == 4000);
+    BOOST_TEST(foo_reused == 2);
+    auto [bar_generated, bar_reused] = logger::get_stat(bar);
+    BOOST_TEST(bar_generated == 0);
+    BOOST_TEST(bar_reused == 2);
+}
+
+#ifdef OS_LINUX
+namespace {
+    /* Redirect stderr to a temporary file while alive. */
+    class stderr_capture {
+        std::string path_;
+        int saved_fd_;
+
+    public:
+        stderr_capture()
+            : path_("/tmp/logger_test." + std::to_string(::getpid())),
+              saved_fd_(::dup(STDERR_FILENO)) {
+            std::fflush(stderr);
+            BOOST_REQUIRE(std::freopen(path_.c_str(), "w", stderr) !=
+                          nullptr);
+        }
+
+        stderr_capture(stderr_capture const &) = delete;
+        auto operator=(stderr_capture const &) -> stderr_capture & = delete;
+
+        ~stderr_capture() {
+            std::fflush(stderr);
+            ::dup2(saved_fd_, STDERR_FILENO);
+            ::close(saved_fd_);
+            std::remove(path_.c_str());
+        }
+
+        [[nodiscard]] auto lines() const -> std::vector<std::string> {
+            std::fflush(stderr);
+            std::ifstream in(path_);
+            std::vector<std::string> result;
+            for (std::string line; std::getline(in, line);) {
+                result.push_back(line);
+            }
+            return result;
+        }
+    };
+
+    /* Count messages written and reported as dropped in LINES. */
+    auto count_messages(std::vector<std::string> const &lines)
+        -> std::size_t {
+        std::size_t n = 0;
+        for (std::string const &line : lines) {
+            std::size_t dropped = line.find(" log messages were dropped.");
+            if (dropped == std::string::npos) {
+                ++n;
+                continue;
+            }
+            std::size_t start = line.rfind(' ', dropped - 1) + 1;
+            n += std::stoul(line.substr(start, dropped - start));
+        }
+        return n;
+    }
+} // namespace
+
+BOOST_AUTO_TEST_CASE(async_log_from_threads) {
+    logger::log_level = logger::INFO;
+    stderr_capture capture;
+
+    logger::start_async_output();
+    std::vector<std::thread> threads;
+    for (int i = 0; i < 4; ++i) {
+        threads.emplace_back([i] {
+            for (int j = 0; j < 100; ++j) {
+                ILOG("thread %d message %d\n", i, j);
+            }
+        });
+    }
+    for (std::thread &t : threads) {
+        t.join();
+    }
+    /* Rings of exited threads are drained before they are freed. */
+    logger::stop_async_output();
+
+    std::vector<std::string> lines = capture.lines();
+    BOOST_TEST(lines.size() == 400);
+    BOOST_TEST(count_messages(lines) == 400);
+}
+
+BOOST_AUTO_TEST_CASE(async_log_overflow) {
+    logger::log_level = logger::INFO;
+    stderr_capture capture;
+
+    constexpr int N_MESSAGES = 20000;
+    logger::start_async_output();
+    for (int i = 0; i < N_MESSAGES; ++i) {
+        ILOG("message %d\n", i);
+    }
+    ELOG("last\n");
+    logger::stop_async_output();
+
+    std::vector<std::string> lines = capture.lines();
+    BOOST_TEST(count_messages(lines) == N_MESSAGES + 1);
+    /* Errors are never dropped. */
+    BOOST_TEST(!lines.empty());
+    bool has_last = false;
+    for (std::string const &line : lines) {
+        has_last = has_last || line.ends_with("last");
+    }
+    BOOST_TEST(has_last);
+}
+#endif
@@ -0,0 +1,302 @@
+// SPDX-License-Identifier: MIT
+
+/* Metrics registry and its exporter. */
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <charconv>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <cstdio>
+#include <filesystem>
+#include <functional>
+#include <map>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <system_error>
+#include <thread>
+#include <vector>
+
+#ifdef OS_LINUX
+#include <csignal>
+
+#include <pthread.h>
+#endif
+
+#include "logger/logger.hh"
+#include "logger/metrics.hh"
+#include "utils/path_hack.hh"
+
+namespace pixel_terrain::logger::metrics {
+    histogram::histogram(std::vector<double> bounds)
+        : bounds_(std::move(bounds)),
+          buckets_(new std::atomic<std::uint64_t>[bounds_.size() + 1]) {
+        for (std::size_t i = 0; i <= bounds_.size(); ++i) {
+            buckets_[i] = 0;
+        }
+    }
+
+    histogram::~histogram() { delete[] buckets_; }
+
+    void histogram::observe(std::chrono::nanoseconds duration) {
+        constexpr double nanos_per_sec = 1e9;
+
+        double seconds = duration.count() / nanos_per_sec;
+        std::size_t i =
+            std::lower_bound(bounds_.begin(), bounds_.end(), seconds) -
+            bounds_.begin();
+        buckets_[i].fetch_add(1, std::memory_order_relaxed);
+        count_.fetch_add(1, std::memory_order_relaxed);
+        sum_nanos_.fetch_add(duration.count(), std::memory_order_relaxed);
+    }
+
+    auto histogram::sum() const -> double {
+        constexpr double nanos_per_sec = 1e9;
+
+        return sum_nanos_.load(std::memory_order_relaxed) / nanos_per_sec;
+    }
+
+    namespace {
+        enum class metric_type { COUNTER, GAUGE, HISTOGRAM };
+
+        struct metric {
+            metric_type type;
+            std::string help;
+            counter *counter_value = nullptr;
+            histogram *histogram_value = nullptr;
+            std::function<double()> func;
+        };
+
+        /* Metrics are kept sorted by name so that output is stable. */
+        std::mutex registry_mutex;
+        std::map<std::string, metric> registry;
+
+        auto type_name(metric_type type) -> char const * {
+            switch (type) {
+            case metric_type::COUNTER:
+                return "counter";
+            case metric_type::GAUGE:
+                return "gauge";
+            case metric_type::HISTOGRAM:
+                return "histogram";
+            }
+            return "untyped";
+        }
+
+        auto format_number(double value) -> std::string {
+            /* Shortest representation that round-trips. */
+            std::array<char, 32> buf;
+            auto [end, ec] =
+                std::to_chars(buf.data(), buf.data() + buf.size(), value);
+            return std::string(buf.data(), end);
+        }
+
+        auto value_of(metric const &m) -> double {
+            if (m.counter_value != nullptr) {
+                return static_cast<double>(m.counter_value->get());
+            }
+            return m.func();
+        }
+
+        /* Append "KEY": VALUE and SEP to OUT.  Pieces are appended one by
+           one, since "literal" + temporary string is built with insert(),
+           which GCC warns about with -Wrestrict. */
+        void append_json_field(std::string *out, std::string_view key,
+                               std::string const &value,
+                               std::string_view sep) {
+            out->push_back('"');
+            out->append(key);
+            out->append("\": ");
+            out->append(value);
+            out->append(sep);
+        }
+    } // namespace
+
+    auto get_counter(std::string const &name, std::string const &help)
+        -> counter & {
+        std::unique_lock<std::mutex> lock(registry_mutex);
+
+        metric &m = registry[name];
+        if (m.counter_value == nullptr) {
+            m.type = metric_type::COUNTER;
+            m.help = help;
+            m.counter_value = new counter;
+        }
+        return *m.counter_value;
+    }
+
+    auto get_histogram(std::string const &name, std::string const &help,
+                       std::vector<double> const &bounds) -> histogram & {
+        std::unique_lock<std::mutex> lock(registry_mutex);
+
+        metric &m = registry[name];
+        if (m.histogram_value == nullptr) {
+            m.type = metric_type::HISTOGRAM;
+            m.help = help;
+            m.histogram_value = new histogram(bounds);
+        }
+        return *m.histogram_value;
+    }
+
+    void add_counter_func(std::string const &name, std::string const &help,
+                          std::function<double()> func) {
+        std::unique_lock<std::mutex> lock(registry_mutex);
+
+        registry[name] = metric{metric_type::COUNTER, help, nullptr, nullptr,
+                                std::move(func)};
+    }
+
+    void add_gauge_func(std::string const &name, std::string const &help,
+                        std::function<double()> func) {
+        std::unique_lock<std::mutex> lock(registry_mutex);
+
+        registry[name] = metric{metric_type::GAUGE, help, nullptr, nullptr,
+                                std::move(func)};
+    }
+
+    auto to_prometheus() -> std::string {
+        std::unique_lock<std::mutex> lock(registry_mutex);
+
+        std::string result;
+        for (auto const &[name, m] : registry) {
+            result += "# HELP " + name + " " + m.help + "\n";
+            result += "# TYPE " + name + " " + type_name(m.type) + "\n";
+            if (m.histogram_value == nullptr) {
+                result += name + " " + format_number(value_of(m)) + "\n";
+                continue;
+            }
+
+            histogram const &h = *m.histogram_value;
+            std::uint64_t cumulative = 0;
+            for (std::size_t i = 0; i < h.bounds().size(); ++i) {
+                cumulative += h.bucket(i);
+                result += name + "_bucket{le=\"" +
+                          format_number(h.bounds()[i]) + "\"} " +
+                          std::to_string(cumulative) + "\n";
+            }
+            cumulative += h.bucket(h.bounds().size());
+            result += name + "_bucket{le=\"+Inf\"} " +
+                      std::to_string(cumulative) + "\n";
+            result += name + "_sum " + format_number(h.sum()) + "\n";
+            result += name + "_count " + std::to_string(cumulative) + "\n";
+        }
+        return result;
+    }
+
+    auto to_json() -> std::string {
+        std::unique_lock<std::mutex> lock(registry_mutex);
+
+        std::string result = "{";
+        bool first = true;
+        for (auto const &[name, m] : registry) {
+            result += first ? "\n" : ",\n";
+            first = false;
+            result += "  \"" + name + "\": ";
+            if (m.histogram_value == nullptr) {
+                result += format_number(value_of(m));
+                continue;
+            }
+
+            histogram const &h = *m.histogram_value;
+            std::uint64_t cumulative = 0;
+            result += "{\"buckets\": {";
+            for (std::size_t i = 0; i < h.bounds().size(); ++i) {
+                cumulative += h.bucket(i);
+                append_json_field(&result, format_number(h.bounds()[i]),
+                                  std::to_string(cumulative), ", ");
+            }
+            cumulative += h.bucket(h.bounds().size());
+            append_json_field(&result, "+Inf", std::to_string(cumulative),
+                              "}, ");
+            append_json_field(&result, "sum", format_number(h.sum()), ", ");
+            append_json_field(&result, "count", std::to_string(cumulative),
+                              "}");
+        }
+        result += "\n}\n";
+        return result;
+    }
+
+    namespace {
+        std::mutex export_mutex;
+        std::condition_variable export_cond;
+        std::filesystem::path export_path;
+        std::chrono::seconds export_interval;
+        bool export_stopping;
+        std::thread *export_thread;
+
+        void write_metrics() {
+            std::string content = export_path.extension() == ".json"
+                                      ? to_json()
+                                      : to_prometheus();
+
+            std::filesystem::path tmp_path(export_path);
+            tmp_path.concat(PATH_STR_LITERAL(".tmp"));
+            std::FILE *f = FOPEN(tmp_path.c_str(), "wb");
+            if (f == nullptr) {
+                ELOG("Failed to open %s\n", tmp_path.string().c_str());
+                return;
+            }
+            bool ok = std::fwrite(content.data(), 1, content.size(), f) ==
+                      content.size();
+            ok = std::fclose(f) == 0 && ok;
+            if (!ok) {
+                ELOG("Failed to write %s\n", tmp_path.string().c_str());
+                return;
+            }
+
+            std::error_code ec;
+            std::filesystem::rename(tmp_path, export_path, ec);
+            if (ec) {
+                ELOG("Failed to write %s: %s\n", export_path.string().c_str(),
+                     ec.message().c_str());
+            }
+        }
+
+        void export_main() {
+#ifdef OS_LINUX
+            ::sigset_t sigs;
+            ::sigfillset(&sigs);
+            ::pthread_sigmask(SIG_BLOCK, &sigs, nullptr);
+#endif
+
+            std::unique_lock<std::mutex> lock(export_mutex);
+            while (!export_stopping) {
+                export_cond.wait_for(lock, export_interval,
+                                     [] { return export_stopping; });
+                write_metrics();
+            }
+        }
+    } // namespace
+
+    void start_export(std::filesystem::path const &path,
+                      std::chrono::seconds interval) {
+        std::unique_lock<std::mutex> lock(export_mutex);
+        if (export_thread != nullptr) {
+            return;
+        }
+
+        export_path = path;
+        export_interval = interval;
+        export_stopping = false;
+        export_thread = new std::thread(&export_main);
+    }
+
+    void stop_export() {
+        std::thread *thread;
+        {
+            std::unique_lock<std::mutex> lock(export_mutex);
+            if (export_thread == nullptr) {
+                return;
+            }
+            export_stopping = true;
+            thread = export_thread;
+            export_thread = nullptr;
+        }
+        export_cond.notify_all();
+        thread->join();
+        delete thread;
+    }
+} // namespace pixel_terrain::logger::metrics
@@ -0,0 +1,90 @@
+// SPDX-License-Identifier: MIT
+
+#ifndef METRICS_HH
+#define METRICS_HH
+
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <filesystem>
+#include <functional>
+#include <string>
+#include <vector>
+
+namespace pixel_terrain::logger::metrics {
+    /* Monotonically increasing value. */
+    class counter {
+        std::atomic<std::uint64_t> value_ = 0;
+
+    public:
+        void add(std::uint64_t n = 1) {
+            value_.fetch_add(n, std::memory_order_relaxed);
+        }
+
+        [[nodiscard]] auto get() const -> std::uint64_t {
+            return value_.load(std::memory_order_relaxed);
+        }
+    };
+
+    /* Distribution of durations, in seconds. */
+    class histogram {
+        std::vector<double> bounds_;
+        std::atomic<std::uint64_t> *buckets_;
+        std::atomic<std::uint64_t> count_ = 0;
+        std::atomic<std::uint64_t> sum_nanos_ = 0;
+
+    public:
+        /* BOUNDS are upper bounds of buckets in ascending order. */
+        histogram(std::vector<double> bounds);
+        ~histogram();
+
+        histogram(histogram const &) = delete;
+        auto operator=(histogram const &) -> histogram & = delete;
+
+        void observe(std::chrono::nanoseconds duration);
+
+        [[nodiscard]] auto bounds() const -> std::vector<double> const & {
+            return bounds_;
+        }
+        /* Return number of observations less than or equal to I-th bound,
+           not including smaller buckets. */
+        [[nodiscard]] auto bucket(std::size_t i) const -> std::uint64_t {
+            return buckets_[i].load(std::memory_order_relaxed);
+        }
+        [[nodiscard]] auto count() const -> std::uint64_t {
+            return count_.load(std::memory_order_relaxed);
+        }
+        [[nodiscard]] auto sum() const -> double;
+    };
+
+    /* Return metric registered with NAME, creating one if it doesn't exist.
+       Returned reference is valid until the process exits. */
+    auto get_counter(std::string const &name, std::string const &help)
+        -> counter &;
+    auto get_histogram(std::string const &name, std::string const &help,
+                       std::vector<double> const &bounds) -> histogram &;
+
+    /* Register a value which is computed when metrics are written. */
+    void add_counter_func(std::string const &name, std::string const &help,
+                          std::function<double()> func);
+    void add_gauge_func(std::string const &name, std::string const &help,
+                        std::function<double()> func);
+
+    /* Return all metrics in Prometheus text exposition format. */
+    auto to_prometheus() -> std::string;
+    /* Return all metrics as a JSON object. */
+    auto to_json() -> std::string;
+
+    /* Write metrics to PATH every INTERVAL and when stop_export() is called.
+       Metrics are written in JSON if extension of PATH is ".json", and in
+       Prometheus text format otherwise.  File is replaced atomically so
+       that readers never see partially written file. */
+    void start_export(std::filesystem::path const &path,
+                      std::chrono::seconds interval);
+    /* Write metrics for the last time and stop exporting.  This can be
+       called even if exporting is not started. */
+    void stop_export();
+} // namespace pixel_terrain::logger::metrics
+
+#endif
@@ -0,0 +1,64 @@
+// SPDX-License-Identifier: MIT
+
+#include <chrono>
+#include <string>
+
+#include <boost/test/tools/interface.hpp>
+#include <boost/test/unit_test.hpp>
+#include <boost/test/unit_test_suite.hpp>
+
+#include "logger/metrics.hh"
+
+using namespace pixel_terrain;
+
+namespace {
+    auto contains(std::string const &haystack, std::string const &needle)
+        -> bool {
+        return haystack.find(needle) != std::string::npos;
+    }
+} // namespace
+
+BOOST_AUTO_TEST_CASE(counter_is_shared_by_name) {
+    logger::metrics::counter &a =
+        logger::metrics::get_counter("test_shared_total", "Test.");
+    logger::metrics::counter &b =
+        logger::metrics::get_counter("test_shared_total", "Test.");
+    BOOST_TEST(&a == &b);
+
+    a.add();
+    b.add(2);
+    BOOST_TEST(a.get() == 3);
+    BOOST_TEST(contains(logger::metrics::to_prometheus(),
+                        "# TYPE test_shared_total counter\n"
+                        "test_shared_total 3\n"));
+}
+
+BOOST_AUTO_TEST_CASE(histogram_buckets_are_cumulative) {
+    using std::chrono::milliseconds;
+
+    logger::metrics::histogram &h = logger::metrics::get_histogram(
+        "test_duration_seconds", "Test.", {0.001, 0.1});
+    h.observe(milliseconds(0));
+    h.observe(milliseconds(50));
+    h.observe(milliseconds(500));
+    BOOST_TEST(h.count() == 3);
+
+    std::string text = logger::metrics::to_prometheus();
+    BOOST_TEST(contains(text, "test_duration_seconds_bucket{le=\"0.001\"} 1\n"
+                              "test_duration_seconds_bucket{le=\"0.1\"} 2\n"
+                              "test_duration_seconds_bucket{le=\"+Inf\"} 3\n"
+                              "test_duration_seconds_sum 0.55\n"
+                              "test_duration_seconds_count 3\n"));
+    BOOST_TEST(contains(logger::metrics::to_json(),
+                        "\"test_duration_seconds\": {\"buckets\": "
+                        "{\"0.001\": 1, \"0.1\": 2, \"+Inf\": 3}, "
+                        "\"sum\": 0.55, \"count\": 3}"));
+}
+
+BOOST_AUTO_TEST_CASE(gauge_func_is_evaluated_on_export) {
+    int value = 1;
+    logger::metrics::add_gauge_func("test_gauge", "Test.",
+                                    [&value] { return value; });
+    value = 42;
+    BOOST_TEST(contains(logger::metrics::to_prometheus(), "test_gauge 42\n"));
+}
@@ -0,0 +1,173 @@
+// SPDX-License-Identifier: MIT
+
+/* Per-stage timers.
+   Each thread has its own table of log-scaled histograms, which are merged
+   only when the report is printed. */
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <mutex>
+#include <vector>
+
+#include "logger/profile.hh"
+
+namespace pixel_terrain::logger::profile {
+    namespace {
+        constexpr int N_STAGES = static_cast<int>(stage::N_STAGES);
+
+        constexpr std::array<char const *, N_STAGES> STAGE_NAMES = {
+            "region mmap",    "chunk inflate",    "NBT parse",
+            "scan_chunk",     "process_pipeline", "inclination",
+            "generate_image", "PNG decode",       "PNG encode",
+        };
+
+        struct stage_stats {
+            std::uint64_t total_nanos = 0;
+            std::uint64_t bytes = 0;
+            histogram nanos;
+
+            void merge(stage_stats const &other) {
+                total_nanos += other.total_nanos;
+                bytes += other.bytes;
+                nanos.merge(other.nanos);
+            }
+        };
+
+        using thread_stats = std::array<stage_stats, N_STAGES>;
+
+        /* Owns table of every thread, so that samples survive after worker
+           threads exit. */
+        class registry {
+            std::mutex mutex_;
+            std::vector<thread_stats *> tables_;
+
+        public:
+            ~registry() {
+                for (thread_stats *t : tables_) {
+                    delete t;
+                }
+            }
+
+            auto new_table() -> thread_stats * {
+                auto *table = new thread_stats;
+                std::unique_lock<std::mutex> lock(mutex_);
+                tables_.push_back(table);
+                return table;
+            }
+
+            auto merged() -> thread_stats {
+                thread_stats result;
+                std::unique_lock<std::mutex> lock(mutex_);
+                for (thread_stats *t : tables_) {
+                    for (int i = 0; i < N_STAGES; ++i) {
+                        result[i].merge((*t)[i]);
+                    }
+                }
+                return result;
+            }
+        };
+
+        registry tables;
+        thread_local thread_stats *local_table = nullptr;
+    } // namespace
+
+    auto histogram::bucket_of(std::uint64_t nanos) -> int {
+        if (nanos < (1U << SUB_BUCKET_BITS)) {
+            return static_cast<int>(nanos);
+        }
+        int msb = 63 - __builtin_clzll(nanos);
+        int sub = static_cast<int>(nanos >> (msb - SUB_BUCKET_BITS)) &
+                  ((1 << SUB_BUCKET_BITS) - 1);
+        return ((msb - SUB_BUCKET_BITS + 1) << SUB_BUCKET_BITS) + sub;
+    }
+
+    auto histogram::bucket_limit(int bucket) -> std::uint64_t {
+        if (bucket < (1 << SUB_BUCKET_BITS)) {
+            return bucket;
+        }
+        int msb = (bucket >> SUB_BUCKET_BITS) + SUB_BUCKET_BITS - 1;
+        std::uint64_t sub = bucket & ((1 << SUB_BUCKET_BITS) - 1);
+        return (((1ULL << SUB_BUCKET_BITS) | sub) << (msb - SUB_BUCKET_BITS)) +
+               ((1ULL << (msb - SUB_BUCKET_BITS)) - 1);
+    }
+
+    void histogram::add(std::uint64_t nanos) {
+        ++count_;
+        if (max_ < nanos) {
+            max_ = nanos;
+        }
+        ++buckets_[bucket_of(nanos)];
+    }
+
+    void histogram::merge(histogram const &other) {
+        count_ += other.count_;
+        if (max_ < other.max_) {
+            max_ = other.max_;
+        }
+        for (int i = 0; i < N_BUCKETS; ++i) {
+            buckets_[i] += other.buckets_[i];
+        }
+    }
+
+    auto histogram::percentile(double p) const -> std::uint64_t {
+        auto rank = static_cast<std::uint64_t>(count_ * p);
+        std::uint64_t seen = 0;
+        for (int i = 0; i < N_BUCKETS; ++i) {
+            seen += buckets_[i];
+            if (rank < seen) {
+                std::uint64_t limit = bucket_limit(i);
+                return limit < max_ ? limit : max_;
+            }
+        }
+        return max_;
+    }
+
+    bool enabled = false;
+
+    void record(stage stage, std::uint64_t nanos, std::size_t bytes) {
+        if (local_table == nullptr) {
+            local_table = tables.new_table();
+        }
+
+        stage_stats &s = (*local_table)[static_cast<int>(stage)];
+        s.total_nanos += nanos;
+        s.bytes += bytes;
+        s.nanos.add(nanos);
+    }
+
+    void show_profile() {
+        constexpr double nanos_per_milli = 1e6;
+        constexpr double nanos_per_micro = 1e3;
+        constexpr double bytes_per_mib = 1024.0 * 1024.0;
+        constexpr double p50 = 0.5;
+        constexpr double p90 = 0.9;
+        constexpr double p99 = 0.99;
+
+        thread_stats merged = tables.merged();
+
+        /* This is printed regardless of log level since it is explicitly
+           requested. */
+        std::fputs("PROFILE (time is sum over all threads)\n", stderr);
+        std::fprintf(stderr, "  %-16s %9s %11s %9s %9s %9s %9s %10s\n",
+                     "stage", "count", "total(ms)", "p50(us)", "p90(us)",
+                     "p99(us)", "max(us)", "MiB");
+        for (int i = 0; i < N_STAGES; ++i) {
+            stage_stats const &s = merged[i];
+            if (s.nanos.count() == 0) {
+                continue;
+            }
+            std::fprintf(
+                stderr,
+                "  %-16s %9llu %11.1f %9.1f %9.1f %9.1f %9.1f %10.1f\n",
+                STAGE_NAMES[i],
+                static_cast<unsigned long long>(s.nanos.count()),
+                s.total_nanos / nanos_per_milli,
+                s.nanos.percentile(p50) / nanos_per_micro,
+                s.nanos.percentile(p90) / nanos_per_micro,
+                s.nanos.percentile(p99) / nanos_per_micro,
+                s.nanos.max() / nanos_per_micro, s.bytes / bytes_per_mib);
+        }
+    }
+} // namespace pixel_terrain::logger::profile
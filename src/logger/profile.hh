@@ -0,0 +1,103 @@
+// SPDX-License-Identifier: MIT
+
+#ifndef PROFILE_HH
+#define PROFILE_HH
+
+#include <array>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+
+namespace pixel_terrain::logger::profile {
+    /* Bytes recorded for each stage are the size of its input, e.g.
+       compressed size for CHUNK_INFLATE and file size for PNG_DECODE.
+       Stages are timed per chunk, except for INCLINATION and the stages
+       after it, which are timed per region. */
+    enum class stage {
+        REGION_MMAP,
+        CHUNK_INFLATE,
+        NBT_PARSE,
+        SCAN_CHUNK,
+        PROCESS_PIPELINE,
+        INCLINATION,
+        GENERATE_IMAGE,
+        PNG_DECODE,
+        PNG_ENCODE,
+        N_STAGES,
+    };
+
+    /* Log-scaled histogram of durations in nanoseconds.  Each power of 2
+       is split into 2^SUB_BUCKET_BITS buckets, so percentiles are accurate
+       within about 19%. */
+    class histogram {
+    public:
+        static constexpr int SUB_BUCKET_BITS = 2;
+        static constexpr int N_BUCKETS = 64 << SUB_BUCKET_BITS;
+
+    private:
+        std::uint64_t count_ = 0;
+        std::uint64_t max_ = 0;
+        std::array<std::uint64_t, N_BUCKETS> buckets_{};
+
+    public:
+        /* Return bucket which NANOS falls into. */
+        static auto bucket_of(std::uint64_t nanos) -> int;
+        /* Return the largest value which falls into BUCKET. */
+        static auto bucket_limit(int bucket) -> std::uint64_t;
+
+        void add(std::uint64_t nanos);
+        void merge(histogram const &other);
+
+        /* Return upper bound of bucket of P-quantile (0 <= P < 1) of
+           samples, but not more than the largest sample. */
+        [[nodiscard]] auto percentile(double p) const -> std::uint64_t;
+
+        [[nodiscard]] auto count() const -> std::uint64_t { return count_; }
+        [[nodiscard]] auto max() const -> std::uint64_t { return max_; }
+    };
+
+    /* Timers do nothing unless this is set.  Set this before starting any
+       worker thread. */
+    extern bool enabled;
+
+    /* Record one sample of STAGE, which took NANOS nanoseconds to process
+       BYTES bytes.  Samples are kept per thread, so this doesn't lock
+       except for the first call on each thread. */
+    void record(stage stage, std::uint64_t nanos, std::size_t bytes);
+
+    /* Print totals and percentiles of each stage.  All threads which
+       recorded samples must have been finished. */
+    void show_profile();
+
+    /* Measure time from construction to destruction. */
+    class scoped_timer {
+        stage stage_;
+        std::size_t bytes_ = 0;
+        std::chrono::steady_clock::time_point start_;
+
+    public:
+        scoped_timer(stage stage) : stage_(stage) {
+            if (enabled) {
+                start_ = std::chrono::steady_clock::now();
+            }
+        }
+
+        ~scoped_timer() {
+            if (enabled) {
+                auto elapsed = std::chrono::steady_clock::now() - start_;
+                record(stage_,
+                       std::chrono::duration_cast<std::chrono::nanoseconds>(
+                           elapsed)
+                           .count(),
+                       bytes_);
+            }
+        }
+
+        scoped_timer(scoped_timer const &) = delete;
+        auto operator=(scoped_timer const &) -> scoped_timer & = delete;
+
+        void add_bytes(std::size_t bytes) { bytes_ += bytes; }
+    };
+} // namespace pixel_terrain::logger::profile
+
+#endif
@@ -0,0 +1,73 @@
+// SPDX-License-Identifier: MIT
+
+#include <cstdint>
+#include <limits>
+
+#include <boost/test/tools/interface.hpp>
+#include <boost/test/unit_test.hpp>
+#include <boost/test/unit_test_suite.hpp>
+
+#include "logger/profile.hh"
+
+using pixel_terrain::logger::profile::histogram;
+
+BOOST_AUTO_TEST_CASE(histogram_bucket_of) {
+    BOOST_TEST(histogram::bucket_of(0) == 0);
+    BOOST_TEST(histogram::bucket_of(3) == 3);
+    BOOST_TEST(histogram::bucket_of(4) == 4);
+    BOOST_TEST(histogram::bucket_of(7) == 7);
+    BOOST_TEST(histogram::bucket_of(8) == 8);
+    BOOST_TEST(histogram::bucket_of(9) == 8);
+    BOOST_TEST(histogram::bucket_of(10) == 9);
+    /* The most significant bit is bit 63. */
+    BOOST_TEST(histogram::bucket_of(~std::uint64_t(0)) ==
+               (62 << histogram::SUB_BUCKET_BITS) + 3);
+}
+
+BOOST_AUTO_TEST_CASE(histogram_bucket_limit) {
+    /* Every value falls into the bucket whose range contains it, and the
+       range is within 25% of its lower end. */
+    std::uint64_t lower = 0;
+    for (int b = 0; b <= histogram::bucket_of(1U << 20U); ++b) {
+        std::uint64_t limit = histogram::bucket_limit(b);
+        BOOST_TEST_REQUIRE(histogram::bucket_of(lower) == b);
+        BOOST_TEST_REQUIRE(histogram::bucket_of(limit) == b);
+        BOOST_TEST_REQUIRE(histogram::bucket_of(limit + 1) == b + 1);
+        BOOST_TEST_REQUIRE(limit - lower <= lower / 4);
+        lower = limit + 1;
+    }
+    BOOST_TEST(histogram::bucket_limit(histogram::bucket_of(
+                   std::numeric_limits<std::uint64_t>::max())) ==
+               std::numeric_limits<std::uint64_t>::max());
+}
+
+BOOST_AUTO_TEST_CASE(histogram_percentile) {
+    histogram h;
+    BOOST_TEST(h.percentile(0.5) == 0U);
+
+    for (std::uint64_t i = 1; i <= 100; ++i) {
+        h.add(i);
+    }
+    BOOST_TEST(h.count() == 100U);
+    BOOST_TEST(h.max() == 100U);
+    /* 51 is in bucket [48, 55]. */
+    BOOST_TEST(h.percentile(0.5) == 55U);
+    /* 91 is in bucket [80, 95]. */
+    BOOST_TEST(h.percentile(0.9) == 95U);
+    /* 100 is in bucket [96, 111], but no sample is larger than 100. */
+    BOOST_TEST(h.percentile(0.99) == 100U);
+}
+
+BOOST_AUTO_TEST_CASE(histogram_merge) {
+    histogram a;
+    histogram b;
+    a.add(10);
+    b.add(1000);
+    b.add(1000);
+    a.merge(b);
+    BOOST_TEST(a.count() == 3U);
+    BOOST_TEST(a.max() == 1000U);
+    BOOST_TEST(a.percentile(0.0) == histogram::bucket_limit(
+                                        histogram::bucket_of(10)));
+    BOOST_TEST(a.percentile(0.5) == 1000U);
+}
@@ -0,0 +1,298 @@
+// SPDX-License-Identifier: MIT
+
+#include <algorithm>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <exception>
+#include <filesystem>
+#include <iostream>
+#include <mutex>
+#include <stdexcept>
+#include <string>
+#include <system_error>
+#include <thread>
+#include <utility>
+#include <vector>
+
+#include <regetopt.h>
+
+#include "config.h"
+#include "nbt/constants.hh"
+#include "nbt/file.hh"
+#include "nbt/pull_parser/nbt_pull_parser.hh"
+#include "nbt/pull_parser/nbt_query.hh"
+#include "nbt/region.hh"
+#include "nbt/utils.hh"
+#include "pixel-terrain.hh"
+#include "utils/array.hh"
+#include "utils/output_buffer.hh"
+#include "utils/path_hack.hh"
+#include "utils/threaded_worker.hh"
+
+namespace {
+    using pixel_terrain::nbt::nbt_query;
+
+    bool list_only = false;
+
+    /* Matches found in a file, to be printed in order of files. */
+    struct file_result {
+        std::string text;
+        bool has_match = false;
+        bool ok = true;
+        bool done = false;
+    };
+
+    void print_usage() {
+        std::cout << &R"(
+Usage: pixel-terrain nbt-query [OPTION]... [--] QUERY FILE...
+Print tags matching QUERY in NBT files, which may be gzip-compressed, or in
+chunks of region files (*.mca).  Directories are searched recursively for
+*.dat, *.nbt and *.mca files.
+
+  -j N, --jobs=N            Search N files in parallel.
+  -l, --files-with-matches  Only print files and chunks which have match.
+      --help                Print this usage and exit.
+
+QUERY is a path to tags, separated by ".", optionally followed by a
+condition.  "[]" after a list selects all its elements.  For example:
+
+  Level.InhabitedTime > 72000
+  Inventory[].id == minecraft:diamond
+  Level.TileEntities[].id
+
+Exit status is 0 if any tag matches, 1 if none, and 2 if there is an error.
+)"[1];
+    }
+
+    auto long_options = pixel_terrain::make_array<::re_option>(
+        ::re_option{"jobs", re_required_argument, nullptr, 'j'},
+        ::re_option{"files-with-matches", re_no_argument, nullptr, 'l'},
+        ::re_option{"help", re_no_argument, nullptr, 'h'},
+        ::re_option{nullptr, 0, nullptr, 0});
+
+    /* Run QUERY on NBT data, and append matches to RESULT, prefixed with
+       LABEL. */
+    void query_data(nbt_query const &query, unsigned char *data,
+                    std::size_t size, std::string const &label,
+                    file_result *result) {
+        pixel_terrain::nbt::nbt_pull_parser p(data, size);
+        try {
+            std::size_t n_matches =
+                query.run(&p, [&](nbt_query::match const &m) {
+                    result->text.append(label);
+                    if (list_only) {
+                        result->text.push_back('\n');
+                        return false;
+                    }
+                    result->text.append(": ");
+                    result->text.append(m.path);
+                    result->text.append(" = ");
+                    result->text.append(m.value);
+                    result->text.push_back('\n');
+                    return true;
+                });
+            if (n_matches != 0) {
+                result->has_match = true;
+            }
+        } catch (std::exception const &e) {
+            std::cerr << label + ": Broken NBT data: " + e.what() + '\n';
+            result->ok = false;
+        }
+    }
+
+    void query_region(nbt_query const &query,
+                      std::filesystem::path const &file,
+                      file_result *result) {
+        constexpr int width =
+            pixel_terrain::nbt::biomes::CHUNK_PER_REGION_WIDTH;
+
+        pixel_terrain::anvil::region r(file);
+        /* Chunks are read in storage order; sort them by coordinate. */
+        std::vector<std::pair<int, file_result>> chunks;
+        std::string name = file.string();
+        r.for_each_chunk_data(
+            [&](int x, int z, std::vector<std::uint8_t> *data) {
+                std::string label = name + ":(" + std::to_string(x) + "," +
+                                    std::to_string(z) + ")";
+                if (data == nullptr) {
+                    std::cerr << label + ": Unable to read chunk.\n";
+                    result->ok = false;
+                    return;
+                }
+                file_result chunk;
+                query_data(query, data->data(), data->size(), label,
+                           &chunk);
+                delete data;
+                if (!chunk.ok) {
+                    result->ok = false;
+                }
+                if (chunk.has_match) {
+                    chunks.emplace_back(z * width + x, std::move(chunk));
+                }
+            },
+            nullptr, 1);
+
+        std::sort(chunks.begin(), chunks.end(),
+                  [](auto const &a, auto const &b) {
+                      return a.first < b.first;
+                  });
+        for (auto &[index, chunk] : chunks) {
+            result->text.append(chunk.text);
+            result->has_match = true;
+        }
+    }
+
+    void query_file(nbt_query const &query, std::filesystem::path const &file,
+                    file_result *result) {
+        try {
+            if (file.extension() == PATH_STR_LITERAL(".mca")) {
+                query_region(query, file, result);
+                return;
+            }
+
+            pixel_terrain::file<unsigned char> f(file);
+            unsigned char *data = f.get_raw_data();
+            /* Files such as level.dat and player data are gzip-compressed. */
+            if (f.size() >= 2 && data[0] == 0x1f && data[1] == 0x8b) {
+                std::vector<std::uint8_t> *inflated =
+                    pixel_terrain::nbt::utils::gzip_file_decompress(file);
+                if (inflated == nullptr) {
+                    throw std::runtime_error("Unable to decompress");
+                }
+                query_data(query, inflated->data(), inflated->size(),
+                           file.string(), result);
+                delete inflated;
+            } else {
+                query_data(query, data, f.size(), file.string(), result);
+            }
+        } catch (std::exception const &e) {
+            std::cerr << file.string() + ": " + e.what() + '\n';
+            result->ok = false;
+        }
+    }
+
+    /* Expand directories in ARGS into NBT files in them. */
+    auto collect_files(std::vector<std::filesystem::path> const &args)
+        -> std::vector<std::filesystem::path> {
+        std::vector<std::filesystem::path> files;
+        for (std::filesystem::path const &arg : args) {
+            std::error_code ec;
+            if (!std::filesystem::is_directory(arg, ec)) {
+                files.push_back(arg);
+                continue;
+            }
+
+            std::vector<std::filesystem::path> found;
+            for (auto const &entry :
+                 std::filesystem::recursive_directory_iterator(arg, ec)) {
+                std::filesystem::path ext = entry.path().extension();
+                if (entry.is_regular_file(ec) &&
+                    (ext == PATH_STR_LITERAL(".dat") ||
+                     ext == PATH_STR_LITERAL(".nbt") ||
+                     ext == PATH_STR_LITERAL(".mca"))) {
+                    found.push_back(entry.path());
+                }
+            }
+            std::sort(found.begin(), found.end());
+            files.insert(files.end(), found.begin(), found.end());
+        }
+        return files;
+    }
+} // namespace
+
+namespace pixel_terrain {
+    auto nbt_query_main(int argc, char **argv) -> int {
+        unsigned int n_jobs = std::thread::hardware_concurrency();
+
+        for (;;) {
+            int opt = regetopt(argc, argv, "j:l", long_options.data(), nullptr);
+            if (opt < 0) {
+                break;
+            }
+            switch (opt) {
+            case 'j': {
+                int n = 0;
+                try {
+                    n = std::stoi(re_optarg);
+                } catch (std::exception const &) {
+                }
+                if (n <= 0) {
+                    std::cout << "Invalid concurrency.\n";
+                    return 2;
+                }
+                n_jobs = n;
+            } break;
+
+            case 'l':
+                list_only = true;
+                break;
+
+            case 'h':
+                print_usage();
+                return 0;
+
+            default:
+                return 2;
+            }
+        }
+
+        if (argc - re_optind < 2) {
+            print_usage();
+            return 2;
+        }
+
+        nbt_query *query;
+        try {
+            query = new nbt_query(argv[re_optind]);
+        } catch (std::invalid_argument const &e) {
+            std::cerr << "Malformed query: " << e.what() << '\n';
+            return 2;
+        }
+        std::vector<std::filesystem::path> files = collect_files(
+            std::vector<std::filesystem::path>(argv + re_optind + 1,
+                                               argv + argc));
+
+        std::vector<file_result> results(files.size());
+        std::mutex mutex;
+        std::condition_variable cond;
+        threaded_worker<std::size_t> pool(
+            std::max(n_jobs, 1U), [&](std::size_t i) {
+                file_result result;
+                query_file(*query, files[i], &result);
+                {
+                    std::unique_lock<std::mutex> lock(mutex);
+                    results[i] = std::move(result);
+                    results[i].done = true;
+                }
+                cond.notify_all();
+            });
+        pool.start();
+        for (std::size_t i = 0; i < files.size(); ++i) {
+            pool.queue_job(i);
+        }
+
+        output_buffer out(stdout);
+        bool has_match = false;
+        bool ok = true;
+        for (file_result &result : results) {
+            {
+                std::unique_lock<std::mutex> lock(mutex);
+                cond.wait(lock, [&result] { return result.done; });
+            }
+            out.write(result.text);
+            has_match = has_match || result.has_match;
+            ok = ok && result.ok;
+            result.text = std::string();
+        }
+        out.flush();
+        pool.finish();
+        delete query;
+
+        if (!ok) {
+            return 2;
+        }
+        return has_match ? 0 : 1;
+    }
+} // namespace pixel_terrain
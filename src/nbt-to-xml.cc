@@ -1,213 +1,668 @@
 // SPDX-License-Identifier: MIT
 
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <condition_variable>
+#include <cstdint>
+#include <cstdio>
 #include <cstring>
 #include <exception>
 #include <iostream>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <utility>
+#include <vector>
 
 #include <regetopt.h>
 
 #include "config.h"
 
+#include "nbt/constants.hh"
 #include "nbt/file.hh"
 #include "nbt/pull_parser/nbt_pull_parser.hh"
+#include "nbt/region.hh"
+#include "nbt/utils.hh"
 #include "pixel-terrain.hh"
 #include "utils/array.hh"
+#include "utils/output_buffer.hh"
 #include "utils/path_hack.hh"
 
 namespace {
     void print_usage() {
         std::cout << &R"(
 Usage: pixel-terrain nbt-to-xml [OPTION]... [--] FILE
+Convert NBT data in FILE, or chunks in FILE if it is a region (*.mca).
 
   -s STR, --indent STR  Use STR to indent. (default: "  ")
   -u, --no-prettify     Don't emit indent and new line.
+  -J, --json            Write JSON instead of XML. Compounds are written as
+                        objects, and lists and arrays as arrays.
+  -w (X,Z), --where=(X,Z)
+                        Select chunk of region. If not specified, convert
+                        all chunks.  Chunks are written in the order they
+                        are stored in the region file.
+  -j N, --jobs=N        Convert N chunks in parallel.
       --help            Print this usage and exit.
 )"[1];
     }
 
     std::string indent_str = "  ";
     bool pretty_print = true;
+    bool json_output = false;
 
-    auto get_tag_name(unsigned char tag_type) -> std::string {
-        using namespace pixel_terrain;
-        using namespace std::string_literals;
+    /* Floating point numbers in XML are written with default precision of
+       std::ostream, which was used to write them. */
+    constexpr int XML_FLOAT_PRECISION = 6;
 
+    using namespace pixel_terrain;
+
+    auto get_tag_name(unsigned char tag_type) -> std::string_view {
         switch (tag_type) {
         case nbt::TAG_END:
             /* should NOT occur. */
-            return "End"s;
+            return "End";
 
         case nbt::TAG_BYTE:
-            return "Byte"s;
+            return "Byte";
 
         case nbt::TAG_SHORT:
-            return "Short"s;
+            return "Short";
 
         case nbt::TAG_INT:
-            return "Int"s;
+            return "Int";
 
         case nbt::TAG_LONG:
-            return "Long"s;
+            return "Long";
 
         case nbt::TAG_FLOAT:
-            return "Float"s;
+            return "Float";
 
         case nbt::TAG_DOUBLE:
-            return "Double"s;
+            return "Double";
 
         case nbt::TAG_BYTE_ARRAY:
-            return "ByteArray"s;
+            return "ByteArray";
 
         case nbt::TAG_STRING:
-            return "String"s;
+            return "String";
 
         case nbt::TAG_LIST:
-            return "List"s;
+            return "List";
 
         case nbt::TAG_COMPOUND:
-            return "Compound"s;
+            return "Compound";
 
         case nbt::TAG_INT_ARRAY:
-            return "IntArray"s;
+            return "IntArray";
 
         case nbt::TAG_LONG_ARRAY:
-            return "LongArray"s;
+            return "LongArray";
 
         default:
-            return "unknown"s;
+            return "unknown";
         }
     }
 
-    auto handle_file(const std::filesystem::path &file) -> bool {
-        using namespace pixel_terrain;
+    auto is_array_type(unsigned char tag_type) -> bool {
+        return tag_type == nbt::TAG_BYTE_ARRAY ||
+               tag_type == nbt::TAG_INT_ARRAY ||
+               tag_type == nbt::TAG_LONG_ARRAY;
+    }
 
-        pixel_terrain::file<unsigned char> *f;
-        try {
-            f = new pixel_terrain::file<unsigned char>(file);
-        } catch (const std::exception &) {
-            std::cerr << "Fatal: Unable to open input file.\n";
-            return false;
+    template <typename T> auto load_element(unsigned char const *p) -> T {
+        T value;
+        std::memcpy(&value, p, sizeof(T));
+        return nbt::utils::to_host_byte_order(value);
+    }
+
+    /* Call WRITE with each of N_ELEMS elements of array of TAG_TYPE at
+       ELEMS, which is returned by nbt_pull_parser::read_array(). */
+    template <typename Write>
+    void for_each_element(unsigned char tag_type, unsigned char const *elems,
+                          std::size_t n_elems, Write const &write) {
+        switch (tag_type) {
+        case nbt::TAG_BYTE_ARRAY:
+            for (std::size_t i = 0; i < n_elems; ++i) {
+                write(elems[i]);
+            }
+            break;
+
+        case nbt::TAG_INT_ARRAY:
+            for (std::size_t i = 0; i < n_elems; ++i) {
+                write(load_element<std::int32_t>(elems +
+                                                 i * sizeof(std::int32_t)));
+            }
+            break;
+
+        case nbt::TAG_LONG_ARRAY:
+            for (std::size_t i = 0; i < n_elems; ++i) {
+                write(load_element<std::uint64_t>(elems +
+                                                  i * sizeof(std::uint64_t)));
+            }
+            break;
         }
-        unsigned char *data = f->get_raw_data();
-        size_t size = f->size();
+    }
 
-        nbt::nbt_pull_parser p(data, size);
-        nbt::parser_event ev = p.get_event_type();
-        int indent = 0;
+    void write_indent(output_buffer *out, int indent) {
+        if (pretty_print) {
+            for (int i = 0; i < indent; ++i) {
+                out->write(indent_str);
+            }
+        }
+    }
+
+    void write_newline(output_buffer *out) {
+        if (pretty_print) {
+            out->put('\n');
+        }
+    }
+
+    void write_xml_end_tag(nbt::nbt_pull_parser *p, output_buffer *out,
+                           int *indent) {
+        --*indent;
+        write_indent(out, *indent);
+        out->write("</");
+        out->write(get_tag_name(p->get_tag_type()));
+        out->put('>');
+        write_newline(out);
+    }
+
+    void write_xml_declaration(output_buffer *out) {
+        out->write(R"(<?xml version="1.0" encoding="utf-8"?>)");
+        write_newline(out);
+    }
 
-        while (ev != nbt::parser_event::DOCUMENT_END) {
+    /* Write tags read by P as XML elements indented by INDENT levels. */
+    void write_xml(nbt::nbt_pull_parser *p, output_buffer *out, int indent) {
+        for (nbt::parser_event ev = p->get_event_type();
+             ev != nbt::parser_event::DOCUMENT_END; ev = p->next()) {
             switch (ev) {
-            case nbt::parser_event::DOCUMENT_START:
-                std::cout << R"(<?xml version="1.0" encoding="utf-8"?>)";
-                if (pretty_print) {
-                    std::cout << '\n';
+            case nbt::parser_event::TAG_START: {
+                unsigned char tag_type = p->get_tag_type();
+                write_indent(out, indent);
+                out->put('<');
+                out->write(get_tag_name(tag_type));
+                if (!p->get_tag_name().empty()) {
+                    out->write(" name=\"");
+                    out->write(p->get_tag_name());
+                    out->put('"');
                 }
-                break;
+                out->put('>');
+                write_newline(out);
+                ++indent;
 
-            case nbt::parser_event::TAG_START:
-                if (pretty_print) {
-                    for (int i = 0; i < indent; ++i) {
-                        std::cout << indent_str;
-                    }
-                }
-                std::cout << '<' << get_tag_name(p.get_tag_type());
-                if (!p.get_tag_name().empty()) {
-                    std::cout << " name=\"" << p.get_tag_name() << "\"";
-                }
-                std::cout << '>';
-                if (pretty_print) {
-                    std::cout << '\n';
+                if (is_array_type(tag_type)) {
+                    auto [elems, n_elems] = p->read_array();
+                    for_each_element(tag_type, elems, n_elems, [&](auto v) {
+                        write_indent(out, indent);
+                        out->write("<item>");
+                        out->write_number(+v);
+                        out->write("</item>");
+                        write_newline(out);
+                    });
+                    write_xml_end_tag(p, out, &indent);
                 }
-
-                ++indent;
-                break;
+            } break;
 
             case nbt::parser_event::DATA:
-                if (pretty_print) {
-                    for (int i = 0; i < indent; ++i) {
-                        std::cout << indent_str;
-                    }
-                }
+                write_indent(out, indent);
 
-                switch (p.get_tag_type()) {
+                switch (p->get_tag_type()) {
                 case nbt::TAG_BYTE:
-                    std::cout << +p.get_byte();
+                    out->write_number(+p->get_byte());
                     break;
 
                 case nbt::TAG_SHORT:
-                    std::cout << p.get_short();
+                    out->write_number(p->get_short());
                     break;
 
                 case nbt::TAG_INT:
-                    std::cout << p.get_int();
+                    out->write_number(p->get_int());
                     break;
 
                 case nbt::TAG_LONG:
-                    std::cout << p.get_long();
+                    out->write_number(p->get_long());
                     break;
 
                 case nbt::TAG_FLOAT:
-                    std::cout << p.get_float();
+                    out->write_number(p->get_float(), XML_FLOAT_PRECISION);
                     break;
 
                 case nbt::TAG_DOUBLE:
-                    std::cout << p.get_double();
-                    break;
-
-                case nbt::TAG_BYTE_ARRAY:
-                    std::cout << "<item>" << +p.get_byte() << "</item>";
+                    out->write_number(p->get_double(), XML_FLOAT_PRECISION);
                     break;
 
                 case nbt::TAG_STRING:
-                    std::cout << p.get_string();
-                    break;
-
-                case nbt::TAG_INT_ARRAY:
-                    std::cout << "<item>" << p.get_int() << "</item>";
+                    out->write(p->get_string());
                     break;
-
-                case nbt::TAG_LONG_ARRAY:
-                    std::cout << "<item>" << p.get_long() << "</item>";
                 }
 
-                if (pretty_print) {
-                    std::cout << '\n';
-                }
+                write_newline(out);
                 break;
 
             case nbt::parser_event::TAG_END:
-                --indent;
-                if (pretty_print) {
-                    for (int i = 0; i < indent; ++i) {
-                        std::cout << indent_str;
+                write_xml_end_tag(p, out, &indent);
+                break;
+
+            default:
+                break;
+            }
+        }
+    }
+
+    /* NBT numbers are signed, though the parser returns bytes and longs
+       as unsigned. */
+    auto to_signed(unsigned char v) -> int {
+        return static_cast<std::int8_t>(v);
+    }
+
+    auto to_signed(std::uint64_t v) -> std::int64_t {
+        return static_cast<std::int64_t>(v);
+    }
+
+    template <typename T> auto to_signed(T v) -> T { return v; }
+
+    template <typename T> void write_json_float(output_buffer *out, T v) {
+        if (std::isfinite(v)) {
+            out->write_number(v);
+        } else {
+            /* JSON has no representation of them. */
+            out->write("null");
+        }
+    }
+
+    void write_json_string(output_buffer *out, std::string_view str) {
+        static constexpr std::array<char, 16> hex_digits = {
+            '0', '1', '2', '3', '4', '5', '6', '7',
+            '8', '9', 'a', 'b', 'c', 'd', 'e', 'f'};
+
+        out->put('"');
+        std::size_t start = 0;
+        for (std::size_t i = 0; i < str.size(); ++i) {
+            auto c = static_cast<unsigned char>(str[i]);
+            if (c != '"' && c != '\\' && c >= 0x20) {
+                continue;
+            }
+
+            out->write(str.substr(start, i - start));
+            start = i + 1;
+            out->put('\\');
+            switch (c) {
+            case '"':
+            case '\\':
+                out->put(static_cast<char>(c));
+                break;
+
+            case '\n':
+                out->put('n');
+                break;
+
+            case '\r':
+                out->put('r');
+                break;
+
+            case '\t':
+                out->put('t');
+                break;
+
+            default:
+                out->write("u00");
+                out->put(hex_digits[c >> 4]);
+                out->put(hex_digits[c & 0xf]);
+                break;
+            }
+        }
+        out->write(str.substr(start));
+        out->put('"');
+    }
+
+    /* Write values of tags read by P as JSON.  Nested values are indented
+       by INDENT levels more than usual.  If INDENT is 0, each root tag is
+       a JSON text on its own line; otherwise there should be only one. */
+    void write_json(nbt::nbt_pull_parser *p, output_buffer *out, int indent) {
+        /* Number of values written so far in each of open compounds and
+           lists. */
+        std::vector<int> n_written;
+        /* Whether each of open containers is a compound. */
+        std::vector<bool> is_compound;
+
+        auto depth = [&] {
+            return indent + static_cast<int>(n_written.size());
+        };
+        auto close_container = [&](char close) {
+            int n = n_written.back();
+            n_written.pop_back();
+            is_compound.pop_back();
+            if (n != 0) {
+                write_newline(out);
+                write_indent(out, depth());
+            }
+            out->put(close);
+        };
+        auto end_value = [&] {
+            if (n_written.empty() && indent == 0) {
+                out->put('\n');
+            }
+        };
+
+        for (nbt::parser_event ev = p->get_event_type();
+             ev != nbt::parser_event::DOCUMENT_END; ev = p->next()) {
+            switch (ev) {
+            case nbt::parser_event::TAG_START: {
+                if (!n_written.empty()) {
+                    if (n_written.back()++ != 0) {
+                        out->put(',');
                     }
+                    write_newline(out);
+                    write_indent(out, depth());
+                    if (is_compound.back()) {
+                        write_json_string(out, p->get_tag_name());
+                        out->write(pretty_print ? ": " : ":");
+                    }
+                }
+
+                unsigned char tag_type = p->get_tag_type();
+                if (tag_type == nbt::TAG_COMPOUND ||
+                    tag_type == nbt::TAG_LIST) {
+                    out->put(tag_type == nbt::TAG_COMPOUND ? '{' : '[');
+                    n_written.push_back(0);
+                    is_compound.push_back(tag_type == nbt::TAG_COMPOUND);
+                } else if (is_array_type(tag_type)) {
+                    auto [elems, n_elems] = p->read_array();
+                    bool first = true;
+                    out->put('[');
+                    for_each_element(tag_type, elems, n_elems, [&](auto v) {
+                        if (!first) {
+                            out->write(pretty_print ? ", " : ",");
+                        }
+                        first = false;
+                        out->write_number(to_signed(v));
+                    });
+                    out->put(']');
+                    end_value();
                 }
-                std::cout << "</" << get_tag_name(p.get_tag_type()) << '>';
-                if (pretty_print) {
-                    std::cout << '\n';
+            } break;
+
+            case nbt::parser_event::DATA:
+                switch (p->get_tag_type()) {
+                case nbt::TAG_BYTE:
+                    out->write_number(to_signed(p->get_byte()));
+                    break;
+
+                case nbt::TAG_SHORT:
+                    out->write_number(p->get_short());
+                    break;
+
+                case nbt::TAG_INT:
+                    out->write_number(p->get_int());
+                    break;
+
+                case nbt::TAG_LONG:
+                    out->write_number(to_signed(p->get_long()));
+                    break;
+
+                case nbt::TAG_FLOAT:
+                    write_json_float(out, p->get_float());
+                    break;
+
+                case nbt::TAG_DOUBLE:
+                    write_json_float(out, p->get_double());
+                    break;
+
+                case nbt::TAG_STRING:
+                    write_json_string(out, p->get_string());
+                    break;
                 }
+                end_value();
                 break;
 
+            case nbt::parser_event::TAG_END: {
+                unsigned char tag_type = p->get_tag_type();
+                if (tag_type == nbt::TAG_COMPOUND) {
+                    close_container('}');
+                    end_value();
+                } else if (tag_type == nbt::TAG_LIST) {
+                    close_container(']');
+                    end_value();
+                }
+            } break;
+
             default:
                 break;
             }
+        }
+    }
 
-            try {
-                ev = p.next();
-            } catch (const std::exception &e) {
-                std::cerr << "Fatal: Broken NBT data: " << e.what() << '\n';
-                delete f;
+    auto handle_file(const std::filesystem::path &file) -> bool {
+        pixel_terrain::file<unsigned char> *f;
+        try {
+            f = new pixel_terrain::file<unsigned char>(file);
+        } catch (const std::exception &) {
+            std::cerr << "Fatal: Unable to open input file.\n";
+            return false;
+        }
+        unsigned char *data = f->get_raw_data();
+        size_t size = f->size();
 
-                return false;
+        nbt::nbt_pull_parser p(data, size);
+        output_buffer out(stdout);
+        try {
+            if (json_output) {
+                write_json(&p, &out, 0);
+            } else {
+                write_xml_declaration(&out);
+                write_xml(&p, &out, 0);
             }
+        } catch (const std::exception &e) {
+            out.flush();
+            std::fflush(stdout);
+            std::cerr << "Fatal: Broken NBT data: " << e.what() << '\n';
+            delete f;
+
+            return false;
         }
         delete f;
         return true;
     }
 
+    void write_json_key(output_buffer *out, std::string_view key) {
+        write_newline(out);
+        write_indent(out, 1);
+        write_json_string(out, key);
+        out->write(pretty_print ? ": " : ":");
+    }
+
+    /* Convert chunk at (X, Z) stored as DATA into OUT.  Return false if it
+       is broken. */
+    auto convert_chunk(int x, int z, std::vector<std::uint8_t> *data,
+                       output_buffer *out) -> bool {
+        nbt::nbt_pull_parser p(data->data(), data->size());
+        try {
+            if (json_output) {
+                out->put('{');
+                write_json_key(out, "x");
+                out->write_number(x);
+                out->put(',');
+                write_json_key(out, "z");
+                out->write_number(z);
+                out->put(',');
+                write_json_key(out, "data");
+                write_json(&p, out, 1);
+                write_newline(out);
+                out->write("}\n");
+            } else {
+                write_indent(out, 1);
+                out->write("<Chunk x=\"");
+                out->write_number(x);
+                out->write("\" z=\"");
+                out->write_number(z);
+                out->write("\">");
+                write_newline(out);
+                write_xml(&p, out, 2);
+                write_indent(out, 1);
+                out->write("</Chunk>");
+                write_newline(out);
+            }
+        } catch (const std::exception &e) {
+            std::cerr << "Fatal: Broken NBT data in chunk (" +
+                             std::to_string(x) + "," + std::to_string(z) +
+                             "): " + e.what() + '\n';
+            return false;
+        }
+        return true;
+    }
+
+    /* Convert chunks at COORDS (or all chunks if empty) of region FILE with
+       N_JOBS threads, and write them in the order they are stored. */
+    auto handle_region(const std::filesystem::path &file,
+                       std::vector<std::pair<int, int>> const &coords,
+                       unsigned int n_jobs) -> bool {
+        constexpr int width = nbt::biomes::CHUNK_PER_REGION_WIDTH;
+        /* Chunks converted but not written yet are at most this many per
+           job, so that memory doesn't grow with the size of region when
+           converting is faster than writing. */
+        constexpr int WINDOW_PER_JOB = 4;
+
+        anvil::region *r;
+        try {
+            r = new anvil::region(file);
+        } catch (const std::exception &) {
+            std::cerr << "Fatal: Unable to open input file.\n";
+            return false;
+        }
+
+        std::vector<anvil::chunk_location> locations = r->chunk_locations();
+        std::array<bool, width * width> exists{};
+        for (anvil::chunk_location const &loc : locations) {
+            exists[loc.chunk_z * width + loc.chunk_x] = true;
+        }
+
+        bool ok = true;
+        std::array<bool, width * width> selected{};
+        if (coords.empty()) {
+            selected = exists;
+        } else {
+            for (auto [x, z] : coords) {
+                int i = z * width + x;
+                if (!exists[i]) {
+                    std::cerr << "Chunk (" << x << "," << z
+                              << ") not exists.\n";
+                    ok = false;
+                } else {
+                    selected[i] = true;
+                }
+            }
+        }
+
+        /* Position in output of each chunk, or -1 if not selected.  This is
+           the order for_each_chunk_data() takes chunks in, so the chunk to
+           be written next is always taken before the ones after it, and
+           waiting for the window never blocks it. */
+        std::array<int, width * width> slot_of;
+        slot_of.fill(-1);
+        int n_slots = 0;
+        for (anvil::chunk_location const &loc : locations) {
+            int i = loc.chunk_z * width + loc.chunk_x;
+            if (selected[i]) {
+                slot_of[i] = n_slots++;
+            }
+        }
+        int const window = static_cast<int>(n_jobs) * WINDOW_PER_JOB;
+
+        /* Converted chunks, which are nullptr until done or if broken. */
+        std::vector<output_buffer *> converted(n_slots);
+        std::vector<bool> done(n_slots);
+        /* Slots before this are written. */
+        int n_written = 0;
+        bool finished = false;
+        std::mutex mutex;
+        std::condition_variable cond;
+
+        std::thread converter([&] {
+            try {
+                r->for_each_chunk_data(
+                    [&](int x, int z, std::vector<std::uint8_t> *data) {
+                        int slot = slot_of[z * width + x];
+                        {
+                            std::unique_lock<std::mutex> lock(mutex);
+                            cond.wait(lock, [&] {
+                                return slot < n_written + window;
+                            });
+                        }
+
+                        auto *out = new output_buffer;
+                        if (data == nullptr) {
+                            std::cerr << "Fatal: Unable to read chunk (" +
+                                             std::to_string(x) + "," +
+                                             std::to_string(z) + ")\n";
+                        }
+                        if (data == nullptr ||
+                            !convert_chunk(x, z, data, out)) {
+                            delete out;
+                            out = nullptr;
+                        }
+                        delete data;
+
+                        {
+                            std::unique_lock<std::mutex> lock(mutex);
+                            converted[slot] = out;
+                            done[slot] = true;
+                        }
+                        cond.notify_all();
+                    },
+                    [&](int x, int z) { return slot_of[z * width + x] >= 0; },
+                    n_jobs);
+            } catch (const std::exception &e) {
+                std::cerr << std::string("Fatal: ") + e.what() + '\n';
+            }
+            {
+                std::unique_lock<std::mutex> lock(mutex);
+                finished = true;
+            }
+            cond.notify_all();
+        });
+
+        output_buffer out(stdout);
+        if (!json_output) {
+            write_xml_declaration(&out);
+            out.write("<Region>");
+            write_newline(&out);
+        }
+        for (int slot = 0; slot < n_slots; ++slot) {
+            output_buffer *chunk_out;
+            {
+                std::unique_lock<std::mutex> lock(mutex);
+                cond.wait(lock, [&] { return done[slot] || finished; });
+                chunk_out = converted[slot];
+                n_written = slot + 1;
+            }
+            cond.notify_all();
+            if (chunk_out == nullptr) {
+                ok = false;
+                continue;
+            }
+            out.write(chunk_out->text());
+            delete chunk_out;
+        }
+        converter.join();
+        if (!json_output) {
+            out.write("</Region>");
+            write_newline(&out);
+        }
+
+        delete r;
+        return ok;
+    }
+
     auto long_options = pixel_terrain::make_array<::re_option>(
         ::re_option{"indent", re_required_argument, nullptr, 's'},
         ::re_option{"no-prettify", re_no_argument, nullptr, 'u'},
+        ::re_option{"json", re_no_argument, nullptr, 'J'},
+        ::re_option{"where", re_required_argument, nullptr, 'w'},
+        ::re_option{"jobs", re_required_argument, nullptr, 'j'},
         ::re_option{"help", re_no_argument, nullptr, 'h'},
         ::re_option{"version", re_no_argument, nullptr, 'v'},
         ::re_option{nullptr, 0, nullptr, 0});
@@ -215,8 +670,12 @@ Usage: pixel-terrain nbt-to-xml [OPTION]... [--] FILE
 
 namespace pixel_terrain {
     auto nbt_to_xml_main(int argc, char **argv) -> int {
+        std::vector<std::pair<int, int>> coords;
+        unsigned int n_jobs = std::thread::hardware_concurrency();
+
         for (;;) {
-            int opt = regetopt(argc, argv, "s:u", long_options.data(), nullptr);
+            int opt = regetopt(argc, argv, "s:uJw:j:", long_options.data(),
+                               nullptr);
             if (opt < 0) {
                 break;
             }
@@ -230,6 +689,36 @@ namespace pixel_terrain {
                 pretty_print = false;
                 break;
 
+            case 'J':
+                json_output = true;
+                break;
+
+            case 'w': {
+                int x;
+                int z;
+                if (std::sscanf(re_optarg, "( %d , %d )", &x, &z) != 2 ||
+                    x < 0 || nbt::biomes::CHUNK_PER_REGION_WIDTH <= x ||
+                    z < 0 || nbt::biomes::CHUNK_PER_REGION_WIDTH <= z) {
+                    std::cout << "Malformed coordinate. (example: "
+                                 "\"(1,2)\")\n";
+                    return 1;
+                }
+                coords.emplace_back(x, z);
+            } break;
+
+            case 'j': {
+                int n = 0;
+                try {
+                    n = std::stoi(re_optarg);
+                } catch (std::exception const &) {
+                }
+                if (n <= 0) {
+                    std::cout << "Invalid concurrency.\n";
+                    return 1;
+                }
+                n_jobs = n;
+            } break;
+
             case 'h':
                 print_usage();
                 return 0;
@@ -243,6 +732,15 @@ namespace pixel_terrain {
             return 1;
         }
 
-        return static_cast<int>(!handle_file(argv[re_optind]));
+        std::filesystem::path file(argv[re_optind]);
+        if (file.extension() == PATH_STR_LITERAL(".mca")) {
+            return static_cast<int>(
+                !handle_region(file, coords, std::max(n_jobs, 1U)));
+        }
+        if (!coords.empty()) {
+            std::cout << "--where is only for region files.\n";
+            return 1;
+        }
+        return static_cast<int>(!handle_file(file));
     }
 } // namespace pixel_terrain
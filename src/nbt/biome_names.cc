@@ -0,0 +1,83 @@
+// SPDX-License-Identifier: MIT
+
+#include <cstdint>
+#include <string>
+#include <unordered_map>
+
+#include "nbt/biome_names.hh"
+#include "nbt/constants.hh"
+
+namespace pixel_terrain::nbt::biomes {
+    namespace {
+        std::unordered_map<std::string, std::int32_t> const biome_ids = {
+            {"minecraft:ocean", OCEAN},
+            {"minecraft:deep_ocean", DEEP_OCEAN},
+            {"minecraft:frozen_ocean", FROZEN_OCEAN},
+            {"minecraft:deep_frozen_ocean", DEEP_FROZEN_OCEAN},
+            {"minecraft:cold_ocean", COLD_OCEAN},
+            {"minecraft:deep_cold_ocean", DEEP_COLD_OCEAN},
+            {"minecraft:lukewarm_ocean", LUKEWARM_OCEAN},
+            {"minecraft:deep_lukewarm_ocean", DEEP_LUKEWARM_OCEAN},
+            {"minecraft:warm_ocean", WARM_OCEAN},
+            {"minecraft:river", RIVER},
+            {"minecraft:frozen_river", FROZEN_RIVER},
+            {"minecraft:beach", BEACH},
+            {"minecraft:stony_shore", STONE_SHORE},
+            {"minecraft:snowy_beach", SNOWY_BEACH},
+            {"minecraft:forest", FOREST},
+            {"minecraft:flower_forest", FLOWER_FOREST},
+            {"minecraft:birch_forest", BIRCH_FOREST},
+            {"minecraft:old_growth_birch_forest", TALL_BIRCH_FOREST},
+            {"minecraft:dark_forest", DARK_FOREST},
+            {"minecraft:jungle", JUNGLE},
+            {"minecraft:sparse_jungle", JUNGLE_EDGE},
+            {"minecraft:bamboo_jungle", BAMBOO_JUNGLE},
+            {"minecraft:taiga", TAIGA},
+            {"minecraft:snowy_taiga", SNOWY_TAIGA},
+            {"minecraft:old_growth_pine_taiga", GIANT_TREE_TAIGA},
+            {"minecraft:old_growth_spruce_taiga", GIANT_SPRUCE_TAIGA},
+            {"minecraft:grove", SNOWY_TAIGA},
+            {"minecraft:mushroom_fields", MUSHROOM_FIELDS},
+            {"minecraft:swamp", SWAMP},
+            {"minecraft:mangrove_swamp", SWAMP},
+            {"minecraft:savanna", SAVANNA},
+            {"minecraft:savanna_plateau", SAVANNA_PLATEAU},
+            {"minecraft:windswept_savanna", SHATTERED_SAVANNA},
+            {"minecraft:plains", PLAINS},
+            {"minecraft:sunflower_plains", SUNFLOWER_PLAINS},
+            {"minecraft:meadow", PLAINS},
+            {"minecraft:desert", DESERT},
+            {"minecraft:snowy_plains", SNOWY_TUNDRA},
+            {"minecraft:ice_spikes", ICE_SPIKES},
+            {"minecraft:snowy_slopes", SNOWY_MOUNTAINS},
+            {"minecraft:frozen_peaks", SNOWY_MOUNTAINS},
+            {"minecraft:jagged_peaks", SNOWY_MOUNTAINS},
+            {"minecraft:stony_peaks", MOUNTAINS},
+            {"minecraft:windswept_hills", MOUNTAINS},
+            {"minecraft:windswept_forest", WOODED_MOUNTAINS},
+            {"minecraft:windswept_gravelly_hills", GRAVELLY_MOUNTAINS},
+            {"minecraft:badlands", BADLANDS},
+            {"minecraft:wooded_badlands", WOODED_BADLANDS_PLATEAU},
+            {"minecraft:eroded_badlands", ERODED_BADLANDS},
+            {"minecraft:nether_wastes", NETHER_WASTES},
+            {"minecraft:crimson_forest", CRIMSON_FOREST},
+            {"minecraft:warped_forest", WARPED_FOREST},
+            {"minecraft:soul_sand_valley", SOUL_SAND_VALLEY},
+            {"minecraft:basalt_deltas", NETHER_WASTES},
+            {"minecraft:the_end", THE_END},
+            {"minecraft:small_end_islands", SMALL_END_ISLANDS},
+            {"minecraft:end_midlands", END_MIDLANDS},
+            {"minecraft:end_highlands", END_HIGHLANDS},
+            {"minecraft:end_barrens", END_BARRENS},
+            {"minecraft:the_void", THE_VOID},
+        };
+    } // namespace
+
+    auto from_name(std::string const &name) -> std::int32_t {
+        auto itr = biome_ids.find(name);
+        if (itr == biome_ids.end()) {
+            return PLAINS;
+        }
+        return itr->second;
+    }
+} // namespace pixel_terrain::nbt::biomes
@@ -0,0 +1,16 @@
+// SPDX-License-Identifier: MIT
+
+#ifndef BIOME_NAMES_HH
+#define BIOME_NAMES_HH
+
+#include <cstdint>
+#include <string>
+
+namespace pixel_terrain::nbt::biomes {
+    /* Convert biome name used since 1.18 to numeric ID used before.
+       Biomes introduced later are mapped to the closest old biome, and
+       unknown ones to PLAINS. */
+    [[nodiscard]] auto from_name(std::string const &name) -> std::int32_t;
+} // namespace pixel_terrain::nbt::biomes
+
+#endif
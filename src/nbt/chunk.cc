@@ -4,36 +4,122 @@
    This implementation based on matcool/anvil-parser with
    performance tuning and biome support. */
 
-#include <cmath>
+#include <algorithm>
+#include <bit>
+#include <cstddef>
 #include <cstdint>
-#include <memory>
+#include <memory_resource>
 #include <stdexcept>
 #include <string>
+#include <string_view>
+#include <utility>
 #include <vector>
 
 #include "logger/logger.hh"
+#include "logger/profile.hh"
+#include "nbt/biome_names.hh"
 #include "nbt/chunk.hh"
 #include "nbt/constants.hh"
 #include "nbt/pull_parser/nbt_pull_parser.hh"
+#include "nbt/pull_parser/path_matcher.hh"
+#include "nbt/unpack.hh"
 
 namespace pixel_terrain::anvil {
-    chunk::chunk(std::vector<std::uint8_t> *data)
-        : parser(nbt::nbt_pull_parser(data->data(), data->size())),
-          chunk_data_(data) {
-        palettes.fill(nullptr);
-        block_states.fill(nullptr);
-    }
+    namespace {
+        constexpr int BLOCKS_PER_LAYER = 16 * 16;
+        constexpr int BLOCKS_PER_SECTION = BLOCK_STATES_ENTRIES;
+        constexpr std::uint16_t ALL_LAYERS = 0xffff;
+
+        auto is_air(std::string_view block) -> bool {
+            return block == "minecraft:air" || block == "minecraft:cave_air" ||
+                   block == "minecraft:void_air";
+        }
 
-    chunk::~chunk() {
-        delete chunk_data_;
-        for (std::vector<std::string> *e : palettes) {
-            delete e;
+        /* Check if every entry in STATES has the same value, without
+           unpacking each of them.  Only handles layouts in which all the
+           words have the same bit pattern. */
+        auto find_uniform_value(std::pmr::vector<std::uint64_t> const &states,
+                                unsigned int bits, bool stretches,
+                                std::uint64_t *value) -> bool {
+            if (stretches && 64 % bits != 0) { // NOLINT
+                return false;
+            }
+
+            unsigned int per_word = 64 / bits; // NOLINT
+            std::size_t n_words =
+                (BLOCKS_PER_SECTION + per_word - 1) / per_word;
+            if (states.empty() || states.size() < n_words) {
+                return false;
+            }
+
+            std::uint64_t v = states[0] & ((1ULL << bits) - 1);
+            std::uint64_t pattern = 0;
+            for (unsigned int i = 0; i < per_word; ++i) {
+                pattern |= v << (i * bits);
+            }
+            for (std::size_t i = 0; i < n_words - 1; ++i) {
+                if (states[i] != pattern) {
+                    return false;
+                }
+            }
+
+            unsigned int rest_bits =
+                (BLOCKS_PER_SECTION - (n_words - 1) * per_word) * bits;
+            std::uint64_t rest_mask =
+                rest_bits >= 64 ? ~0ULL : (1ULL << rest_bits) - 1; // NOLINT
+            if ((states[n_words - 1] & rest_mask) != (pattern & rest_mask)) {
+                return false;
+            }
+
+            *value = v;
+            return true;
+        }
+
+        template <typename T, std::size_t... I>
+        auto make_array(std::pmr::memory_resource *resource,
+                        std::index_sequence<I...> /*unused*/)
+            -> std::array<T, sizeof...(I)> {
+            return {{((void)I, T(resource))...}};
         }
-        for (std::vector<std::uint64_t> *e : block_states) {
-            delete e;
+
+        /* Array of containers for each section, allocating from
+           RESOURCE. */
+        template <typename T>
+        auto per_section(std::pmr::memory_resource *resource)
+            -> std::array<T, nbt::biomes::SECTION_COUNT> {
+            return make_array<T>(
+                resource,
+                std::make_index_sequence<nbt::biomes::SECTION_COUNT>());
         }
+    } // namespace
+
+    auto chunk::field_paths() -> nbt::path_matcher const & {
+        static nbt::path_matcher const matcher = [] {
+            nbt::path_matcher m;
+            m.add({"", "DataVersion"}, FIELD_DATA_VERSION);
+            m.add({"", "sections"}, FIELD_SECTIONS);
+            m.add({"", "LastUpdate"}, FIELD_LAST_UPDATE);
+            m.add({"", "Level", "Sections"}, FIELD_SECTIONS);
+            m.add({"", "Level", "LastUpdate"}, FIELD_LAST_UPDATE);
+            m.add({"", "Level", "Biomes"}, FIELD_BIOMES);
+            return m;
+        }();
+        return matcher;
     }
 
+    chunk::chunk(std::pmr::vector<std::uint8_t> data)
+        : resource_(data.get_allocator().resource()), data_(std::move(data)),
+          parser(data_.data(), data_.size(), resource_),
+          palettes(per_section<std::pmr::vector<std::string_view>>(resource_)),
+          block_states(per_section<std::pmr::vector<std::uint64_t>>(resource_)),
+          section_indices(
+              per_section<std::pmr::vector<std::uint16_t>>(resource_)),
+          biomes(resource_),
+          biome_palettes(
+              per_section<std::pmr::vector<std::int32_t>>(resource_)),
+          biome_states(per_section<std::pmr::vector<std::uint64_t>>(resource_)),
+          field_states(resource_) {}
+
     auto chunk::get_last_update() noexcept(false) -> std::uint64_t {
         make_sure_field_parsed(FIELD_LAST_UPDATE);
 
@@ -81,8 +167,8 @@ namespace pixel_terrain::anvil {
                 }
                 ev = parser.next();
             }
-            auto *palette = new std::vector<std::string>;
-            auto *block_state = new std::vector<std::uint64_t>;
+            std::pmr::vector<std::string_view> palette(resource_);
+            std::pmr::vector<std::uint64_t> block_state(resource_);
             for (;;) {
                 if (parser.get_tag_name() == "BlockStates") {
                     if (parser.get_tag_type() != nbt::TAG_LONG_ARRAY) {
@@ -90,7 +176,7 @@ namespace pixel_terrain::anvil {
                             "BlockStates is not TAG_Long_Array");
                     }
                     for (; parser.next() == nbt::parser_event::DATA;) {
-                        block_state->push_back(parser.get_long());
+                        block_state.push_back(parser.get_long());
                     }
                 } else if (parser.get_tag_name() == "Palette") {
                     if (parser.get_tag_type() != nbt::TAG_LIST) {
@@ -105,20 +191,11 @@ namespace pixel_terrain::anvil {
                                     parser.get_tag_name() == "Name") {
                                     /* parser_event::DATA */
                                     parser.next();
-                                    palette->push_back(parser.get_string());
+                                    palette.push_back(parser.get_string());
                                     /* parser_event::TAG_END */
                                     parser.next();
                                 } else {
-                                    for (int i = 1; i != 0;) {
-                                        ev = parser.next();
-                                        if (ev ==
-                                            nbt::parser_event::TAG_START) {
-                                            ++i;
-                                        } else if (ev ==
-                                                   nbt::parser_event::TAG_END) {
-                                            --i;
-                                        }
-                                    }
+                                    parser.skip_tag();
                                 }
                             }
                             ev = parser.next();
@@ -137,14 +214,8 @@ namespace pixel_terrain::anvil {
                     }
                 } else {
                     /* skip others because they aren't needed. */
-                    for (int i = 1; i != 0;) {
-                        ev = parser.next();
-                        if (ev == nbt::parser_event::TAG_START) {
-                            ++i;
-                        } else if (ev == nbt::parser_event::TAG_END) {
-                            --i;
-                        }
-                    }
+                    parser.skip_tag();
+                    ev = parser.get_event_type();
                 }
 
                 ev = parser.next();
@@ -158,124 +229,247 @@ namespace pixel_terrain::anvil {
                 throw std::runtime_error("Broken Sections tag");
             }
 
-            if (y >= nbt::biomes::PALETTE_Y_MAX) {
-                delete palette;
-                delete block_state;
-            } else {
-                palettes[y] = palette;
-                block_states[y] = block_state;
+            if (y < nbt::biomes::PALETTE_Y_MAX) {
+                int i = y - nbt::biomes::SECTION_Y_MIN;
+                palettes[i] = std::move(palette);
+                block_states[i] = std::move(block_state);
+                present_sections |= 1U << i;
             }
 
             ev = parser.next();
         }
     }
 
-    void chunk::parse_fields() {
-        nbt::parser_event ev = parser.get_event_type();
-        while (ev != nbt::parser_event::DOCUMENT_END) {
-            if (ev == nbt::parser_event::TAG_START) {
-                tag_structure.push_back(parser.get_tag_name());
-
-                unsigned char f = current_field();
-
-                if (f == FIELD_SECTIONS) {
-                    parse_sections();
+    void chunk::parse_paletted_container(
+        std::pmr::vector<std::string_view> *palette,
+        std::pmr::vector<std::uint64_t> *data) {
+        for (;;) {
+            nbt::parser_event ev = parser.next();
+            if (ev == nbt::parser_event::TAG_END) {
+                break;
+            }
+            if (ev != nbt::parser_event::TAG_START) {
+                throw std::runtime_error("Broken paletted container");
+            }
 
-                    return;
+            if (parser.get_tag_name() == "data" &&
+                parser.get_tag_type() == nbt::TAG_LONG_ARRAY) {
+                while (parser.next() == nbt::parser_event::DATA) {
+                    data->push_back(parser.get_long());
                 }
-                if (f == FIELD_LAST_UPDATE) {
-                    ev = parser.next();
-                    if (ev != nbt::parser_event::DATA ||
-                        parser.get_tag_type() != nbt::TAG_LONG) {
-                        throw std::runtime_error("LastUpdate is not TAG_Long");
+            } else if (parser.get_tag_name() == "palette" &&
+                       parser.get_tag_type() == nbt::TAG_LIST) {
+                /* Block palette is a list of compounds with Name and
+                   Properties, while biome palette is a list of names. */
+                while (parser.next() == nbt::parser_event::TAG_START) {
+                    if (parser.get_tag_type() == nbt::TAG_STRING) {
+                        parser.next();
+                        palette->push_back(parser.get_string());
+                        parser.next();
+                        continue;
                     }
-                    last_update = parser.get_long();
-
-                    parser.next();
-                    return;
-                }
-                if (f == FIELD_BIOMES) {
-                    if (parser.get_tag_type() != nbt::TAG_INT_ARRAY) {
-                        throw std::runtime_error("Biomes is not TAG_Int_Array");
+                    if (parser.get_tag_type() != nbt::TAG_COMPOUND) {
+                        parser.skip_tag();
+                        continue;
                     }
-                    while (parser.next() == nbt::parser_event::DATA) {
-                        biomes.push_back(parser.get_int());
+                    while (parser.next() == nbt::parser_event::TAG_START) {
+                        if (parser.get_tag_type() == nbt::TAG_STRING &&
+                            parser.get_tag_name() == "Name") {
+                            parser.next();
+                            palette->push_back(parser.get_string());
+                            parser.next();
+                        } else {
+                            parser.skip_tag();
+                        }
                     }
-
-                    return;
                 }
-                if (f == FIELD_DATA_VERSION) {
-                    ev = parser.next();
-                    if (ev != nbt::parser_event::DATA ||
-                        parser.get_tag_type() != nbt::TAG_INT) {
-                        throw std::runtime_error(
-                            "DataVersion is not TAG_Int_Array");
-                    }
-                    data_version = parser.get_int();
+            } else {
+                parser.skip_tag();
+            }
+        }
+    }
 
+    void chunk::parse_root_sections() {
+        while (parser.next() == nbt::parser_event::TAG_START) {
+            int y = nbt::biomes::SECTION_Y_MAX + 1;
+            std::pmr::vector<std::string_view> palette(resource_);
+            std::pmr::vector<std::uint64_t> block_state(resource_);
+            std::pmr::vector<std::string_view> biome_names(resource_);
+            std::pmr::vector<std::uint64_t> biome_state(resource_);
+
+            while (parser.next() == nbt::parser_event::TAG_START) {
+                if (parser.get_tag_name() == "Y" &&
+                    parser.get_tag_type() == nbt::TAG_BYTE) {
                     parser.next();
-                    return;
+                    y = static_cast<signed char>(parser.get_byte());
+                    parser.next();
+                } else if (parser.get_tag_name() == "block_states" &&
+                           parser.get_tag_type() == nbt::TAG_COMPOUND) {
+                    parse_paletted_container(&palette, &block_state);
+                } else if (parser.get_tag_name() == "biomes" &&
+                           parser.get_tag_type() == nbt::TAG_COMPOUND) {
+                    parse_paletted_container(&biome_names, &biome_state);
+                } else {
+                    parser.skip_tag();
                 }
-            } else if (ev == nbt::parser_event::TAG_END) {
-                tag_structure.pop_back();
             }
 
-            ev = parser.next();
+            if (y < nbt::biomes::SECTION_Y_MIN ||
+                nbt::biomes::SECTION_Y_MAX < y) {
+                continue;
+            }
+
+            int i = y - nbt::biomes::SECTION_Y_MIN;
+            palettes[i] = std::move(palette);
+            block_states[i] = std::move(block_state);
+            biome_palettes[i].clear();
+            for (std::string_view name : biome_names) {
+                biome_palettes[i].push_back(
+                    nbt::biomes::from_name(std::string(name)));
+            }
+            biome_states[i] = std::move(biome_state);
+            present_sections |= 1U << i;
         }
+
+        /* Biomes are in sections too. */
+        loaded_fields |= FIELD_BIOMES;
     }
 
-    void chunk::make_sure_field_parsed(unsigned char field) noexcept(false) {
-        if ((loaded_fields & field) == 0) {
-            do {
-                parse_fields();
-            } while ((loaded_fields & field) == 0 &&
-                     parser.get_event_type() !=
-                         nbt::parser_event::DOCUMENT_END);
+    void chunk::parse_fields(unsigned char fields) {
+        nbt::path_matcher const &matcher = field_paths();
 
-            if ((loaded_fields & field) == 0) {
-                throw std::runtime_error("Tag not found: " +
-                                         std::to_string(field));
+        nbt::parser_event ev = parser.get_event_type();
+        while ((loaded_fields & fields) != fields &&
+               ev != nbt::parser_event::DOCUMENT_END) {
+            if (ev == nbt::parser_event::TAG_START) {
+                int parent = field_states.empty() ? nbt::path_matcher::ROOT
+                                                  : field_states.back();
+                int state = matcher.child(parent, parser.get_tag_name());
+                if (state == nbt::path_matcher::NONE) {
+                    parser.skip_tag();
+                } else if (unsigned char f = matcher.value(state); f != 0) {
+                    /* Sections are at root since 1.18. */
+                    parse_field(f, field_states.size() == 1);
+                    loaded_fields |= f;
+                } else {
+                    field_states.push_back(state);
+                }
+            } else if (ev == nbt::parser_event::TAG_END &&
+                       !field_states.empty()) {
+                field_states.pop_back();
             }
+
+            ev = parser.next();
         }
     }
 
-    auto chunk::current_field() -> unsigned char {
-        if (tag_structure.size() < 2 || !tag_structure[0].empty()) {
-            return 0;
+    void chunk::parse_field(unsigned char field, bool at_root) {
+        if (field == FIELD_SECTIONS) {
+            sections_at_root = at_root;
+            if (sections_at_root) {
+                parse_root_sections();
+            } else {
+                parse_sections();
+            }
+        } else if (field == FIELD_LAST_UPDATE) {
+            nbt::parser_event ev = parser.next();
+            if (ev != nbt::parser_event::DATA ||
+                parser.get_tag_type() != nbt::TAG_LONG) {
+                throw std::runtime_error("LastUpdate is not TAG_Long");
+            }
+            last_update = parser.get_long();
+
+            parser.next();
+        } else if (field == FIELD_BIOMES) {
+            if (parser.get_tag_type() != nbt::TAG_INT_ARRAY) {
+                throw std::runtime_error("Biomes is not TAG_Int_Array");
+            }
+            while (parser.next() == nbt::parser_event::DATA) {
+                biomes.push_back(parser.get_int());
+            }
+        } else if (field == FIELD_DATA_VERSION) {
+            nbt::parser_event ev = parser.next();
+            if (ev != nbt::parser_event::DATA ||
+                parser.get_tag_type() != nbt::TAG_INT) {
+                throw std::runtime_error("DataVersion is not TAG_Int_Array");
+            }
+            data_version = parser.get_int();
+
+            parser.next();
         }
+    }
+
+    void chunk::make_sure_field_parsed(unsigned char field) noexcept(false) {
+        if ((loaded_fields & field) == 0) {
+            logger::profile::scoped_timer timer(
+                logger::profile::stage::NBT_PARSE);
+            if (loaded_fields == 0) {
+                timer.add_bytes(data_.size());
+            }
 
-        unsigned char result = 0;
+            parse_fields(field);
 
-        if (tag_structure[1] == "DataVersion") {
-            result = FIELD_DATA_VERSION;
-        } else if (tag_structure.size() >= 3 && tag_structure[0].empty() &&
-                   tag_structure[1] == "Level") {
-            if (tag_structure[2] == "Sections") {
-                result = FIELD_SECTIONS;
-            } else if (tag_structure[2] == "LastUpdate") {
-                result = FIELD_LAST_UPDATE;
-            } else if (tag_structure[2] == "Biomes") {
-                result = FIELD_BIOMES;
+            if ((loaded_fields & field) == 0) {
+                throw std::runtime_error("Tag not found: " +
+                                         std::to_string(field));
             }
         }
-        loaded_fields |= result;
-
-        return result;
     }
 
-    auto chunk::get_palette(unsigned char y) -> std::vector<std::string> * {
-        if (y >= nbt::biomes::PALETTE_Y_MAX) {
+    auto chunk::get_palette(int section)
+        -> std::pmr::vector<std::string_view> const * {
+        if (section < nbt::biomes::SECTION_Y_MIN ||
+            nbt::biomes::SECTION_Y_MAX < section) {
             return nullptr;
         }
 
         make_sure_field_parsed(FIELD_SECTIONS);
 
-        return palettes[y];
+        int index = section - nbt::biomes::SECTION_Y_MIN;
+        if ((present_sections & (1U << index)) == 0) {
+            return nullptr;
+        }
+        return &palettes[index];
     }
 
     auto chunk::get_biome(int32_t x, int32_t y, int32_t z) -> int32_t {
         make_sure_field_parsed(FIELD_BIOMES);
 
+        if (sections_at_root) {
+            if (y < nbt::biomes::CHUNK_MIN_Y ||
+                nbt::biomes::CHUNK_MAX_Y_1_18 < y) {
+                return 0;
+            }
+            int section = section_of(y);
+            int i = section - nbt::biomes::SECTION_Y_MIN;
+            std::pmr::vector<std::int32_t> const &palette = biome_palettes[i];
+            if (palette.empty()) {
+                return 0;
+            }
+            if (palette.size() == 1) {
+                return palette[0];
+            }
+
+            constexpr int cell = nbt::biomes::BIOME_CELL_WIDTH;
+            constexpr int cells = nbt::biomes::CHUNK_WIDTH / cell;
+            int index =
+                (((y - section * nbt::biomes::BLOCK_PER_SECTION) / cell) *
+                     cells +
+                 z / cell) *
+                    cells +
+                x / cell;
+            unsigned int bits = std::bit_width(palette.size() - 1);
+            unsigned int per_word = 64 / bits; // NOLINT
+            std::pmr::vector<std::uint64_t> const &states = biome_states[i];
+            if (index / per_word >= states.size()) {
+                return 0;
+            }
+            std::size_t id = (states[index / per_word] >>
+                              (index % per_word * bits)) &
+                             ((1ULL << bits) - 1);
+            return id < palette.size() ? palette[id] : 0;
+        }
+
         if (biomes.size() == nbt::biomes::BIOME_DATA_OLD_VERSION_SIZE) {
             return biomes[(z / 2) * 16 + (x / 2)]; // NOLINT
         }
@@ -285,91 +479,157 @@ namespace pixel_terrain::anvil {
         return 0;
     }
 
-    auto chunk::get_block(int32_t x, int32_t y, int32_t z) -> std::string {
-        if (x < 0 || 15 < x || y < 0 || 255 < y || z < 0 || 15 < z) { // NOLINT
-            return "";
-        }
-
+    void chunk::decode_section(int index) {
         make_sure_field_parsed(FIELD_DATA_VERSION);
+        make_sure_field_parsed(FIELD_SECTIONS);
 
-        unsigned char section_no = y / nbt::biomes::PALETTE_Y_MAX;
-
-        y %= nbt::biomes::PALETTE_Y_MAX;
-
-        std::vector<std::string> *palette = palettes[section_no];
-        if (palette == nullptr || palette->empty()) {
-            return "minecraft:air";
+        section_summary &summary = summaries[index];
+        std::pmr::vector<std::string_view> const &palette = palettes[index];
+        if (palette.empty()) {
+            decoded_sections |= 1U << index;
+            return;
         }
 
-        unsigned int bits = 4;
-        if (palette->size() - 1 > 15) { // NOLINT
-            bits = palette->size() - 1;
-
-            /* calculate next squared number, in squared numbers larger than
-               BITS. if BITS is already squared in this step, calculate next
-               one. */
-            bits = bits | (bits >> 1);
-            bits = bits | (bits >> 2);
-            bits = bits | (bits >> 4);
-            bits = bits | (bits >> 8);  // NOLINT
-            bits = bits | (bits >> 16); // NOLINT
-            bits += 1;
-
-            bits = static_cast<int>(log2(bits));
+        /* Before 1.18, index 0 is treated as air whatever the palette
+           says. */
+        std::pmr::vector<bool> air(palette.size(), resource_);
+        air[0] = !sections_at_root || is_air(palette[0]);
+        for (std::size_t i = 1; i < palette.size(); ++i) {
+            air[i] = is_air(palette[i]);
         }
 
-        int index = y * 16 * 16 + z * 16 + x; // NOLINT
-        make_sure_field_parsed(FIELD_SECTIONS);
-        std::vector<std::uint64_t> *states = block_states[section_no];
-        int state;
+        unsigned int bits = bits_per_entry(palette.size());
         bool stretches =
             data_version < nbt::biomes::NEED_STRETCH_DATA_VERSION_THRESHOLD;
-        if (stretches) {
-            state = index * bits / 64; // NOLINT
+        std::pmr::vector<std::uint64_t> const &states = block_states[index];
+
+        std::uint64_t uniform = 0;
+        if (palette.size() == 1 ||
+            find_uniform_value(states, bits, stretches, &uniform)) {
+            /* Common for sections of stone or deep ocean; no need to
+               unpack each block.  Since 1.18, such sections don't even
+               have data. */
+            std::uint16_t value = uniform < palette.size() ? uniform : 0;
+            summary.all_air = air[value];
+            summary.value = value;
+            summary.solid_layers = air[value] ? 0 : ALL_LAYERS;
+            decoded_sections |= 1U << index;
+            return;
+        }
+
+        std::pmr::vector<std::uint16_t> &indices = section_indices[index];
+        indices.resize(BLOCKS_PER_SECTION);
+        if (unpack_func unpack = get_unpacker(bits, stretches)) {
+            unpack(states.data(), states.size(), indices.data());
         } else {
-            state = index / (64 / bits); // NOLINT
+            unpack_generic(states.data(), states.size(), bits, stretches,
+                           indices.data());
+        }
+
+        summary.solid_layers = ALL_LAYERS;
+        for (int i = 0; i < BLOCKS_PER_SECTION; ++i) {
+            std::uint16_t id = indices[i] < palette.size() ? indices[i] : 0;
+            indices[i] = id;
+            if (air[id]) {
+                summary.solid_layers &= ~(1U << (i / BLOCKS_PER_LAYER));
+            } else {
+                summary.all_air = false;
+            }
+            if (id != indices[0]) {
+                summary.single_value = false;
+            }
+        }
+        summary.value = indices[0];
+
+        if (summary.single_value) {
+            indices.clear();
+        }
+        decoded_sections |= 1U << index;
+    }
+
+    auto chunk::get_section_summary(int section) -> section_summary const & {
+        static section_summary const empty;
+
+        if (section < nbt::biomes::SECTION_Y_MIN ||
+            nbt::biomes::SECTION_Y_MAX < section) {
+            return empty;
+        }
+
+        int index = section - nbt::biomes::SECTION_Y_MIN;
+        if ((decoded_sections & (1U << index)) == 0) {
+            decode_section(index);
         }
+        return summaries[index];
+    }
 
-        if (static_cast<std::uint64_t>(state) >= states->size()) {
-            return "minecraft:air";
+    auto chunk::get_block(int32_t x, int32_t y, int32_t z) -> std::string {
+        if (x < 0 || 15 < x || z < 0 || 15 < z || // NOLINT
+            y < nbt::biomes::CHUNK_MIN_Y || nbt::biomes::CHUNK_MAX_Y_1_18 < y) {
+            return "";
         }
 
-        std::uint64_t data = (*states)[state];
+        int section = section_of(y);
+        int index = section - nbt::biomes::SECTION_Y_MIN;
+        y -= section * nbt::biomes::BLOCK_PER_SECTION;
 
-        std::uint64_t shifted_data;
-        if (stretches) {
-            shifted_data = data >> ((bits * index) % 64); // NOLINT
+        section_summary const &summary = get_section_summary(section);
+        std::uint16_t id;
+        if (summary.single_value) {
+            id = summary.value;
         } else {
-            shifted_data = data >> (index % (64 / bits) * bits); // NOLINT
+            id = section_indices[index][y * BLOCKS_PER_LAYER + z * 16 +
+                                        x]; // NOLINT
         }
 
-        if (stretches && 64 - ((bits * index) % 64) < bits) { // NOLINT
-            data = (*states)[state + 1];
+        return std::string(get_block_name(section, id));
+    }
 
-            int leftover = (bits - ((state + 1) * 64 % bits)) % bits; // NOLINT
-            shifted_data =
-                ((data & (static_cast<std::int64_t>(pow(2, leftover)) - 1))
-                 << (bits - leftover)) |
-                shifted_data;
+    auto chunk::get_section_blocks(int section) -> std::uint16_t const * {
+        if (get_section_summary(section).single_value) {
+            return nullptr;
         }
+        return section_indices[section - nbt::biomes::SECTION_Y_MIN].data();
+    }
+
+    auto chunk::get_block_name(int section, std::uint16_t id)
+        -> std::string_view {
+        static constexpr std::string_view air = "minecraft:air";
 
-        std::int64_t palette_id =
-            shifted_data & (static_cast<std::int64_t>(pow(2, bits)) - 1);
+        if (section < nbt::biomes::SECTION_Y_MIN ||
+            nbt::biomes::SECTION_Y_MAX < section) {
+            return air;
+        }
 
-        if (palette_id <= 0 ||
-            (*palette).size() <= static_cast<std::size_t>(palette_id)) {
-            return "minecraft:air";
+        std::pmr::vector<std::string_view> const &palette =
+            palettes[section - nbt::biomes::SECTION_Y_MIN];
+        /* Missing section is air, whatever the version is. */
+        if ((id == 0 && !sections_at_root) || palette.empty()) {
+            return air;
         }
 
-        return (*palette)[palette_id];
+        return palette[id];
     }
 
     auto chunk::get_max_height() -> int {
         make_sure_field_parsed(FIELD_SECTIONS);
 
-        for (int y = nbt::biomes::SECTIONS_Y_DIV_COUNT - 1; y >= 0; --y) {
-            if (palettes[y] != nullptr) {
-                return (y + 1) * nbt::biomes::BLOCK_PER_SECTION - 1;
+        for (int i = nbt::biomes::SECTION_COUNT - 1; i >= 0; --i) {
+            if ((present_sections & (1U << i)) != 0) {
+                return (i + nbt::biomes::SECTION_Y_MIN + 1) *
+                           nbt::biomes::BLOCK_PER_SECTION -
+                       1;
+            }
+        }
+        return 0;
+    }
+
+    auto chunk::get_min_height() -> int {
+        make_sure_field_parsed(FIELD_SECTIONS);
+
+        for (int i = 0; i < nbt::biomes::SECTION_COUNT; ++i) {
+            if (!palettes[i].empty()) {
+                return std::min(0, (i + nbt::biomes::SECTION_Y_MIN) *
+                                       nbt::biomes::BLOCK_PER_SECTION);
             }
         }
         return 0;
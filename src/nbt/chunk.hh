@@ -5,50 +5,121 @@
 
 #include <array>
 #include <cstdint>
-#include <memory>
+#include <memory_resource>
+#include <string>
+#include <string_view>
 #include <vector>
 
 #include "nbt/constants.hh"
 #include "nbt/pull_parser/nbt_pull_parser.hh"
+#include "nbt/pull_parser/path_matcher.hh"
 
 namespace pixel_terrain::anvil {
+    /* Summary of a 16x16x16 section, computed when it is decoded.
+       In chunks before 1.18, index 0 always means air. */
+    struct section_summary {
+        /* Every block in the section is air. */
+        bool all_air = true;
+        /* Every block in the section is palette entry VALUE. */
+        bool single_value = true;
+        std::uint16_t value = 0;
+        /* Bit N is set if layer N contains no air at all.  Note that
+           blocks in these layers may still be transparent. */
+        std::uint16_t solid_layers = 0;
+    };
+
     class chunk {
+        std::pmr::memory_resource *resource_;
+        std::pmr::vector<std::uint8_t> data_;
         nbt::nbt_pull_parser parser;
-        std::vector<std::uint8_t> *chunk_data_;
 
-        std::array<std::vector<std::string> *, nbt::biomes::PALETTE_Y_MAX>
+        /* Sections are indexed by Y - SECTION_Y_MIN.  Palette entries
+           point into the chunk data. */
+        std::array<std::pmr::vector<std::string_view>,
+                   nbt::biomes::SECTION_COUNT>
             palettes;
-        std::array<std::vector<std::uint64_t> *,
-                   nbt::biomes::BLOCK_STATES_COUNT>
+        std::array<std::pmr::vector<std::uint64_t>, nbt::biomes::SECTION_COUNT>
             block_states;
-        std::vector<std::int32_t> biomes;
+        /* Empty unless the section is decoded and has different blocks. */
+        std::array<std::pmr::vector<std::uint16_t>, nbt::biomes::SECTION_COUNT>
+            section_indices;
+        std::array<section_summary, nbt::biomes::SECTION_COUNT> summaries;
+        /* Bit N is set if section N appears in the chunk. */
+        std::uint_fast32_t present_sections = 0;
+        std::uint_fast32_t decoded_sections = 0;
+        /* Biomes before 1.18. */
+        std::pmr::vector<std::int32_t> biomes;
+        /* Biomes since 1.18, for each section. */
+        std::array<std::pmr::vector<std::int32_t>, nbt::biomes::SECTION_COUNT>
+            biome_palettes;
+        std::array<std::pmr::vector<std::uint64_t>, nbt::biomes::SECTION_COUNT>
+            biome_states;
+        /* Sections are at root instead of in Level since 1.18. */
+        bool sections_at_root = false;
         std::uint64_t last_update;
         std::int32_t data_version;
         unsigned char loaded_fields = 0;
-        std::vector<std::string> tag_structure;
+        /* States of path matcher for compounds parse_fields() is in. */
+        std::pmr::vector<int> field_states;
 
         static inline constexpr unsigned char FIELD_SECTIONS = 1;
         static inline constexpr unsigned char FIELD_LAST_UPDATE = 1 << 1;
         static inline constexpr unsigned char FIELD_BIOMES = 1 << 2;
         static inline constexpr unsigned char FIELD_DATA_VERSION = 1 << 3;
 
-        void parse_fields();
+        static auto field_paths() -> nbt::path_matcher const &;
+
+        /* Parse until all of FIELDS are loaded or the document ends,
+           loading every field on the way. */
+        void parse_fields(unsigned char fields);
+        void parse_field(unsigned char field, bool at_root);
         void parse_sections();
-        auto current_field() -> unsigned char;
+        void parse_root_sections();
+        void parse_paletted_container(
+            std::pmr::vector<std::string_view> *palette,
+            std::pmr::vector<std::uint64_t> *data);
         void make_sure_field_parsed(unsigned char field) noexcept(false);
+        void decode_section(int section);
 
     public:
-        chunk(std::vector<std::uint8_t> *data);
-        ~chunk();
+        /* Everything the chunk allocates, including the parser, comes
+           from the resource of DATA. */
+        explicit chunk(std::pmr::vector<std::uint8_t> data);
+
+        chunk(chunk const &) = delete;
+        auto operator=(chunk const &) -> chunk & = delete;
 
         [[nodiscard]] auto get_last_update() noexcept(false) -> std::uint64_t;
-        [[nodiscard]] auto get_palette(unsigned char y)
-            -> std::vector<std::string> *;
+        /* Palette of section SECTION, or nullptr if it is missing. */
+        [[nodiscard]] auto get_palette(int section)
+            -> std::pmr::vector<std::string_view> const *;
+        /* Summary of section of Y coordinate SECTION.  Sections out of
+           range are all air. */
+        [[nodiscard]] auto get_section_summary(int section)
+            -> section_summary const &;
+        /* Palette indices of blocks of section SECTION in YZX order, or
+           nullptr if the section is single valued or all air. */
+        [[nodiscard]] auto get_section_blocks(int section)
+            -> std::uint16_t const *;
+        /* Name of block of palette index ID in section SECTION, same as
+           the one get_block() returns. */
+        [[nodiscard]] auto get_block_name(int section, std::uint16_t id)
+            -> std::string_view;
         [[nodiscard]] auto get_block(std::int32_t x, std::int32_t y,
                                      std::int32_t z) -> std::string;
         [[nodiscard]] auto get_biome(std::int32_t x, std::int32_t y,
                                      std::int32_t z) -> std::int32_t;
+        /* Top of the highest section in the chunk. */
         [[nodiscard]] auto get_max_height() -> int;
+        /* Bottom of the lowest section with blocks, or 0 if it is above. */
+        [[nodiscard]] auto get_min_height() -> int;
+
+        /* Section Y which block Y belongs to. */
+        static constexpr auto section_of(int y) -> int {
+            return (y - nbt::biomes::CHUNK_MIN_Y) /
+                       nbt::biomes::BLOCK_PER_SECTION +
+                   nbt::biomes::SECTION_Y_MIN;
+        }
     };
 } // namespace pixel_terrain::anvil
 
@@ -107,6 +107,18 @@ namespace pixel_terrain::nbt {
 
         inline constexpr int BLOCK_STATES_COUNT = 16;
 
+        /* Range of section Y, covering both worlds before 1.18 (0 to 15)
+           and 1.18 or later (-4 to 19). */
+        inline constexpr int SECTION_Y_MIN = -4;
+        inline constexpr int SECTION_Y_MAX = 19;
+        inline constexpr int SECTION_COUNT = SECTION_Y_MAX - SECTION_Y_MIN + 1;
+        inline constexpr int CHUNK_MIN_Y = SECTION_Y_MIN * BLOCK_PER_SECTION;
+        inline constexpr int CHUNK_MAX_Y_1_18 =
+            (SECTION_Y_MAX + 1) * BLOCK_PER_SECTION - 1;
+
+        /* Biomes are stored for each 4x4x4 blocks since 1.18. */
+        inline constexpr int BIOME_CELL_WIDTH = 4;
+
         inline constexpr int NEED_STRETCH_DATA_VERSION_THRESHOLD = 2529;
     } // namespace biomes
 } // namespace pixel_terrain::nbt
@@ -0,0 +1,288 @@
+// SPDX-License-Identifier: MIT
+
+/* Consolidated chunk timestamp cache.
+
+   File layout:
+     "PTCACHE" 0x01                      magic and format version
+     { u32 length, u32 crc32, payload }  repeated records
+   where payload is
+     u16 name length, name, u16 n, n * { u16 chunk index, u64 timestamp }.
+   Integers are stored in host byte order since the cache is never shared
+   between machines.  Later records override earlier ones. */
+
+#include <algorithm>
+#include <array>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <iterator>
+#include <mutex>
+#include <string>
+#include <system_error>
+#include <tuple>
+#include <vector>
+
+#ifdef OS_LINUX
+#include <unistd.h>
+#endif
+
+#include <zlib.h>
+
+#include "nbt/journal.hh"
+#include "utils/path_hack.hh"
+
+namespace pixel_terrain::anvil {
+    namespace {
+        constexpr std::array<std::uint8_t, 8> MAGIC = {'P', 'T', 'C', 'A',
+                                                       'C', 'H', 'E', 1};
+
+        /* Rewrite the whole journal once it holds this many times as many
+           records as there are live regions. */
+        constexpr std::size_t COMPACTION_RATIO = 4;
+        constexpr std::size_t COMPACTION_MIN_RECORDS = 256;
+
+        template <typename T>
+        void put(std::vector<std::uint8_t> *buf, T value) {
+            std::array<std::uint8_t, sizeof(T)> bytes;
+            std::memcpy(bytes.data(), &value, sizeof(T));
+            buf->insert(buf->end(), bytes.begin(), bytes.end());
+        }
+
+        template <typename T>
+        auto get(std::uint8_t const *data, std::size_t len, std::size_t *off,
+                 T *value) -> bool {
+            if (*off + sizeof(T) > len) {
+                return false;
+            }
+            std::memcpy(value, data + *off, sizeof(T));
+            *off += sizeof(T);
+            return true;
+        }
+
+        void encode_record(std::vector<std::uint8_t> *out,
+                           std::string const &name,
+                           std::vector<journal::update> const &updates) {
+            std::vector<std::uint8_t> payload;
+            put<std::uint16_t>(&payload, name.size());
+            payload.insert(payload.end(), name.begin(), name.end());
+            put<std::uint16_t>(&payload, updates.size());
+            for (auto const &[index, timestamp] : updates) {
+                put<std::uint16_t>(&payload, index);
+                put<std::uint64_t>(&payload, timestamp);
+            }
+
+            put<std::uint32_t>(out, payload.size());
+            put<std::uint32_t>(out, ::crc32(0, payload.data(), payload.size()));
+            out->insert(out->end(), payload.begin(), payload.end());
+        }
+
+        auto decode_record(std::uint8_t const *payload, std::size_t len,
+                           std::string *name,
+                           std::vector<journal::update> *updates) -> bool {
+            std::size_t off = 0;
+            std::uint16_t name_len;
+            if (!get(payload, len, &off, &name_len) || off + name_len > len) {
+                return false;
+            }
+            name->assign(reinterpret_cast<char const *>(payload) + off,
+                         name_len);
+            off += name_len;
+
+            std::uint16_t n;
+            if (!get(payload, len, &off, &n)) {
+                return false;
+            }
+            updates->clear();
+            for (int i = 0; i < n; ++i) {
+                std::uint16_t index;
+                std::uint64_t timestamp;
+                if (!get(payload, len, &off, &index) ||
+                    !get(payload, len, &off, &timestamp) ||
+                    index >= std::tuple_size<journal::timestamps>::value) {
+                    return false;
+                }
+                updates->emplace_back(index, timestamp);
+            }
+
+            return off == len;
+        }
+
+        auto sync_and_close(std::FILE *f) -> bool {
+            bool ok = std::fflush(f) == 0;
+#ifdef OS_LINUX
+            ok = ok && ::fsync(::fileno(f)) == 0;
+#endif
+            ok = std::fclose(f) == 0 && ok;
+            return ok;
+        }
+    } // namespace
+
+    journal::journal(std::filesystem::path const &cache_dir)
+        : path_(cache_dir / FILENAME) {
+        std::filesystem::create_directories(cache_dir);
+        load();
+    }
+
+    journal::~journal() { flush(); }
+
+    void journal::load() {
+        std::ifstream in(path_, std::ios::binary);
+        if (!in) {
+            needs_rewrite_ = true;
+            return;
+        }
+
+        std::vector<std::uint8_t> content(
+            (std::istreambuf_iterator<char>(in)),
+            std::istreambuf_iterator<char>());
+        if (content.size() < MAGIC.size() ||
+            !std::equal(MAGIC.begin(), MAGIC.end(), content.begin())) {
+            /* Unknown format; start over. */
+            needs_rewrite_ = true;
+            return;
+        }
+
+        std::string name;
+        std::vector<update> updates;
+        std::size_t off = MAGIC.size();
+        while (off < content.size()) {
+            std::uint32_t len;
+            std::uint32_t crc;
+            if (!get(content.data(), content.size(), &off, &len) ||
+                !get(content.data(), content.size(), &off, &crc) ||
+                off + len > content.size()) {
+                break;
+            }
+            std::uint8_t const *payload = content.data() + off;
+            if (::crc32(0, payload, len) != crc ||
+                !decode_record(payload, len, &name, &updates)) {
+                break;
+            }
+            off += len;
+
+            timestamps &t = committed_.try_emplace(name).first->second;
+            for (auto const &[index, timestamp] : updates) {
+                t[index] = timestamp;
+            }
+            ++n_records_;
+        }
+
+        if (off != content.size()) {
+            /* Torn write of the last run.  Appending after the garbage would
+               make new records unreachable, so rewrite on next flush. */
+            needs_rewrite_ = true;
+        }
+    }
+
+    auto journal::get_timestamps(std::string const &region_name)
+        -> timestamps {
+        std::unique_lock<std::mutex> lock(mutex_);
+
+        auto itr = committed_.find(region_name);
+        if (itr == committed_.end()) {
+            timestamps result;
+            result.fill(0);
+            return result;
+        }
+        return itr->second;
+    }
+
+    void journal::commit(std::string const &region_name,
+                         std::vector<update> const &updates) {
+        if (updates.empty()) {
+            return;
+        }
+
+        std::unique_lock<std::mutex> lock(mutex_);
+
+        timestamps &t = committed_.try_emplace(region_name).first->second;
+        for (auto const &[index, timestamp] : updates) {
+            t[index] = timestamp;
+        }
+
+        encode_record(&pending_, region_name, updates);
+        ++n_pending_records_;
+    }
+
+    auto journal::needs_compaction() const -> bool {
+        std::size_t n = n_records_ + n_pending_records_;
+        return n > COMPACTION_MIN_RECORDS &&
+               n > committed_.size() * COMPACTION_RATIO;
+    }
+
+    auto journal::rewrite() -> bool {
+        std::vector<std::uint8_t> content(MAGIC.begin(), MAGIC.end());
+        std::vector<update> updates;
+        for (auto const &[name, t] : committed_) {
+            updates.clear();
+            for (std::size_t i = 0; i < t.size(); ++i) {
+                if (t[i] != 0) {
+                    updates.emplace_back(i, t[i]);
+                }
+            }
+            encode_record(&content, name, updates);
+        }
+
+        std::filesystem::path tmp_path(path_);
+        tmp_path.concat(PATH_STR_LITERAL(".tmp"));
+        std::FILE *f = FOPEN(tmp_path.c_str(), "wb");
+        if (f == nullptr) {
+            return false;
+        }
+        bool ok = std::fwrite(content.data(), 1, content.size(), f) ==
+                  content.size();
+        if (!sync_and_close(f) || !ok) {
+            return false;
+        }
+
+        std::error_code ec;
+        std::filesystem::rename(tmp_path, path_, ec);
+        if (ec) {
+            return false;
+        }
+
+        n_records_ = committed_.size();
+        return true;
+    }
+
+    auto journal::append() -> bool {
+        std::FILE *f = FOPEN(path_.c_str(), "ab");
+        if (f == nullptr) {
+            return false;
+        }
+        bool ok = std::fwrite(pending_.data(), 1, pending_.size(), f) ==
+                  pending_.size();
+        if (!sync_and_close(f) || !ok) {
+            /* Partial record (if any) will be dropped on next load. */
+            needs_rewrite_ = true;
+            return false;
+        }
+
+        n_records_ += n_pending_records_;
+        return true;
+    }
+
+    auto journal::flush() -> bool {
+        std::unique_lock<std::mutex> lock(mutex_);
+
+        if (pending_.empty() && !needs_rewrite_) {
+            return true;
+        }
+
+        bool ok;
+        if (needs_rewrite_ || needs_compaction()) {
+            ok = rewrite();
+            needs_rewrite_ = !ok;
+        } else {
+            ok = append();
+        }
+
+        if (ok) {
+            pending_.clear();
+            n_pending_records_ = 0;
+        }
+        return ok;
+    }
+} // namespace pixel_terrain::anvil
@@ -0,0 +1,70 @@
+// SPDX-License-Identifier: MIT
+
+#ifndef JOURNAL_HH
+#define JOURNAL_HH
+
+#include <array>
+#include <cstdint>
+#include <filesystem>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+#include "nbt/constants.hh"
+
+namespace pixel_terrain::anvil {
+    /* Append-only store of chunk timestamps, shared by every region rendered
+       with the same cache directory.
+
+       Updates are kept in memory until flush() is called, and flush() writes
+       them out with a single fsync.  Each record carries its own checksum so
+       a record torn by a crash is simply dropped on the next load. */
+    class journal {
+    public:
+        using timestamps =
+            std::array<std::uint64_t, nbt::biomes::CHUNK_PER_REGION_WIDTH *
+                                          nbt::biomes::CHUNK_PER_REGION_WIDTH>;
+        using update = std::pair<int, std::uint64_t>;
+
+    private:
+        std::filesystem::path path_;
+        std::mutex mutex_;
+        std::unordered_map<std::string, timestamps> committed_;
+        std::vector<std::uint8_t> pending_;
+        std::size_t n_records_ = 0;
+        std::size_t n_pending_records_ = 0;
+        bool needs_rewrite_ = false;
+
+        void load();
+        auto needs_compaction() const -> bool;
+        auto rewrite() -> bool;
+        auto append() -> bool;
+
+    public:
+        /* Name of the journal file created in cache directory. */
+        static constexpr char const *FILENAME = "journal.ptcache";
+
+        journal(std::filesystem::path const &cache_dir);
+        ~journal();
+
+        journal(journal const &) = delete;
+        auto operator=(journal const &) -> journal & = delete;
+
+        /* Return last committed timestamps of all chunks in the region.
+           Chunks which have never been committed are 0. */
+        [[nodiscard]] auto get_timestamps(std::string const &region_name)
+            -> timestamps;
+
+        /* Record updates of the region.  Call this only after the output
+           for the region has been written successfully. */
+        void commit(std::string const &region_name,
+                    std::vector<update> const &updates);
+
+        /* Write committed-but-unwritten records to disk. */
+        auto flush() -> bool;
+    };
+} // namespace pixel_terrain::anvil
+
+#endif
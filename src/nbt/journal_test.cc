@@ -0,0 +1,131 @@
+// SPDX-License-Identifier: MIT
+
+#include <cstdint>
+#include <filesystem>
+#include <fstream>
+#include <string>
+#include <vector>
+
+#include <boost/test/tools/interface.hpp>
+#include <boost/test/unit_test.hpp>
+#include <boost/test/unit_test_suite.hpp>
+
+#include "nbt/journal.hh"
+
+using namespace pixel_terrain;
+
+namespace {
+    class temp_dir {
+        std::filesystem::path path_;
+
+    public:
+        temp_dir(std::string const &name)
+            : path_(std::filesystem::temp_directory_path() /
+                    ("pixel_terrain_" + name)) {
+            std::filesystem::remove_all(path_);
+        }
+
+        ~temp_dir() { std::filesystem::remove_all(path_); }
+
+        [[nodiscard]] auto path() const -> std::filesystem::path const & {
+            return path_;
+        }
+
+        [[nodiscard]] auto journal_path() const -> std::filesystem::path {
+            return path_ / anvil::journal::FILENAME;
+        }
+    };
+} // namespace
+
+BOOST_AUTO_TEST_CASE(journal_round_trip) {
+    temp_dir dir("journal_round_trip");
+    {
+        anvil::journal j(dir.path());
+        BOOST_TEST(j.get_timestamps("r.0.0.mca")[0] == 0);
+
+        j.commit("r.0.0.mca", {{0, 10}, {1023, 20}});
+        j.commit("r.1.0.mca", {{5, 30}});
+        j.commit("r.0.0.mca", {{0, 40}});
+        BOOST_TEST(j.get_timestamps("r.0.0.mca")[0] == 40);
+        BOOST_TEST(j.flush());
+    }
+
+    anvil::journal j(dir.path());
+    auto t = j.get_timestamps("r.0.0.mca");
+    BOOST_TEST(t[0] == 40);
+    BOOST_TEST(t[1] == 0);
+    BOOST_TEST(t[1023] == 20);
+    BOOST_TEST(j.get_timestamps("r.1.0.mca")[5] == 30);
+    BOOST_TEST(j.get_timestamps("r.2.0.mca")[5] == 0);
+}
+
+BOOST_AUTO_TEST_CASE(journal_uncommitted_is_not_written) {
+    temp_dir dir("journal_uncommitted");
+    {
+        anvil::journal j(dir.path());
+        j.commit("r.0.0.mca", {});
+        BOOST_TEST(j.flush());
+    }
+
+    anvil::journal j(dir.path());
+    BOOST_TEST(j.get_timestamps("r.0.0.mca")[0] == 0);
+}
+
+BOOST_AUTO_TEST_CASE(journal_torn_tail) {
+    temp_dir dir("journal_torn_tail");
+    {
+        anvil::journal j(dir.path());
+        j.commit("r.0.0.mca", {{0, 10}});
+        BOOST_TEST(j.flush());
+        j.commit("r.0.0.mca", {{1, 20}});
+        BOOST_TEST(j.flush());
+    }
+
+    /* Emulate a crash in the middle of the second flush. */
+    std::filesystem::resize_file(
+        dir.journal_path(), std::filesystem::file_size(dir.journal_path()) - 3);
+
+    {
+        anvil::journal j(dir.path());
+        auto t = j.get_timestamps("r.0.0.mca");
+        BOOST_TEST(t[0] == 10);
+        BOOST_TEST(t[1] == 0);
+
+        j.commit("r.0.0.mca", {{2, 30}});
+        BOOST_TEST(j.flush());
+    }
+
+    anvil::journal j(dir.path());
+    auto t = j.get_timestamps("r.0.0.mca");
+    BOOST_TEST(t[0] == 10);
+    BOOST_TEST(t[2] == 30);
+}
+
+BOOST_AUTO_TEST_CASE(journal_compaction) {
+    temp_dir dir("journal_compaction");
+    {
+        anvil::journal j(dir.path());
+        BOOST_TEST(j.flush());
+    }
+
+    std::uintmax_t prev_size = 0;
+    for (int run = 0; run < 8; ++run) {
+        anvil::journal j(dir.path());
+        for (int i = 0; i < 100; ++i) {
+            j.commit("r.0.0.mca", {{i, static_cast<std::uint64_t>(run + 1)}});
+        }
+        BOOST_TEST(j.flush());
+
+        std::uintmax_t size = std::filesystem::file_size(dir.journal_path());
+        if (size < prev_size) {
+            break;
+        }
+        prev_size = size;
+        BOOST_TEST(run < 7, "journal never compacted");
+    }
+
+    anvil::journal j(dir.path());
+    auto t = j.get_timestamps("r.0.0.mca");
+    BOOST_TEST(t[0] != 0);
+    BOOST_TEST(t[99] == t[0]);
+}
@@ -1,6 +1,10 @@
 // SPDX-License-Identifier: MIT
 
+#include <cstddef>
 #include <stdexcept>
+#include <string>
+#include <string_view>
+#include <utility>
 
 #include "nbt/pull_parser/nbt_pull_parser.hh"
 #include "nbt/utils.hh"
@@ -54,21 +58,59 @@ namespace pixel_terrain::nbt {
             return d;
         }
 
-        inline auto read_string(unsigned char *data, size_t *offset,
-                                int strlength) -> std::string {
-            std::string str(data + *offset, data + *offset + strlength);
+        inline auto read_string_view(unsigned char const *data,
+                                     size_t *offset, int strlength)
+            -> std::string_view {
+            std::string_view str(reinterpret_cast<char const *>(data + *offset),
+                                 strlength);
             *offset += strlength;
             return str;
         }
 
+        /* Size of payload of TYPE, or 0 if it is not fixed. */
+        inline auto fixed_payload_size(unsigned char tag_type) -> std::size_t {
+            switch (tag_type) {
+            case TAG_BYTE:
+                return sizeof(std::uint8_t);
+            case TAG_SHORT:
+                return sizeof(std::int16_t);
+            case TAG_INT:
+                return sizeof(std::int32_t);
+            case TAG_LONG:
+                return sizeof(std::uint64_t);
+            case TAG_FLOAT:
+                return sizeof(float);
+            case TAG_DOUBLE:
+                return sizeof(double);
+            default:
+                return 0;
+            }
+        }
+
+        inline auto array_element_size(unsigned char tag_type) -> std::size_t {
+            switch (tag_type) {
+            case TAG_INT_ARRAY:
+                return sizeof(std::int32_t);
+            case TAG_LONG_ARRAY:
+                return sizeof(std::uint64_t);
+            default:
+                return sizeof(std::uint8_t);
+            }
+        }
+
+        /* Same as the limit of Minecraft. */
+        constexpr int MAX_SKIP_DEPTH = 512;
+
         inline auto is_array_type(unsigned char tag_type) -> bool {
             return tag_type == TAG_BYTE_ARRAY || tag_type == TAG_INT_ARRAY ||
                    tag_type == TAG_LONG_ARRAY;
         }
     } // namespace
 
-    nbt_pull_parser::nbt_pull_parser(unsigned char *data, const size_t length)
-        : data(data), length(length) {}
+    nbt_pull_parser::nbt_pull_parser(unsigned char *data, const size_t length,
+                                     std::pmr::memory_resource *resource)
+        : data(data), length(length), indices(resource), lengths(resource),
+          types(resource), payload_types(resource), names(resource) {}
 
     void nbt_pull_parser::parse_array_header() {
         if (offset + sizeof(std::int32_t) > length) {
@@ -104,8 +146,7 @@ namespace pixel_terrain::nbt {
         if (offset + name_len >= length) {
             throw std::out_of_range("buffer exhausted on tag name");
         }
-        std::string name = read_string(data, &offset, name_len);
-        names.push(name);
+        names.push(read_string_view(data, &offset, name_len));
         if (is_array_type(type)) {
             parse_array_header();
         } else if (type == TAG_LIST) {
@@ -159,14 +200,141 @@ namespace pixel_terrain::nbt {
     void nbt_pull_parser::handle_tag_end() {
         last_tag_name = names.top();
         names.pop();
-        if (!types.empty() && types.top() == TAG_STRING) {
-            delete tag_data.string_data;
-        }
         last_tag_type = types.top();
         types.pop();
         end_emitted = true;
     }
 
+    void nbt_pull_parser::require(std::size_t n) const {
+        if (n > length - offset) {
+            throw std::out_of_range("buffer exhausted on skipping tag");
+        }
+    }
+
+    void nbt_pull_parser::advance(std::size_t n) {
+        require(n);
+        offset += n;
+    }
+
+    void nbt_pull_parser::skip_payload(unsigned char type, int depth) {
+        if (depth > MAX_SKIP_DEPTH) {
+            throw std::runtime_error("tags nested too deep");
+        }
+
+        if (std::size_t size = fixed_payload_size(type); size != 0) {
+            advance(size);
+            return;
+        }
+
+        switch (type) {
+        case TAG_BYTE_ARRAY:
+        case TAG_INT_ARRAY:
+        case TAG_LONG_ARRAY: {
+            require(sizeof(std::int32_t));
+            std::int32_t len = read_int(data, &offset);
+            if (len > 0) {
+                advance(len * array_element_size(type));
+            }
+            break;
+        }
+
+        case TAG_STRING: {
+            require(sizeof(std::uint16_t));
+            advance(static_cast<std::uint16_t>(read_short(data, &offset)));
+            break;
+        }
+
+        case TAG_LIST: {
+            require(1 + sizeof(std::int32_t));
+            unsigned char payload_type = read_byte(data, &offset);
+            std::int32_t len = read_int(data, &offset);
+            if (payload_type == TAG_END) {
+                break;
+            }
+            if (std::size_t size = fixed_payload_size(payload_type);
+                size != 0) {
+                if (len > 0) {
+                    advance(len * size);
+                }
+                break;
+            }
+            for (std::int32_t i = 0; i < len; ++i) {
+                skip_payload(payload_type, depth + 1);
+            }
+            break;
+        }
+
+        case TAG_COMPOUND:
+            for (;;) {
+                require(1);
+                unsigned char child_type = read_byte(data, &offset);
+                if (child_type == TAG_END) {
+                    break;
+                }
+                require(sizeof(std::uint16_t));
+                advance(static_cast<std::uint16_t>(read_short(data, &offset)));
+                skip_payload(child_type, depth + 1);
+            }
+            break;
+
+        default:
+            throw std::runtime_error("unknown tag type " +
+                                     std::to_string(type));
+        }
+    }
+
+    void nbt_pull_parser::skip_tag() noexcept(false) {
+        if (current_event != parser_event::TAG_START) {
+            throw std::logic_error("skip_tag() called out of TAG_START");
+        }
+
+        unsigned char type = types.top();
+        if (is_array_type(type)) {
+            /* Header is already read. */
+            int rest = lengths.top() - indices.top();
+            if (rest > 0) {
+                advance(rest * array_element_size(type));
+            }
+            indices.pop();
+            lengths.pop();
+        } else if (type == TAG_LIST) {
+            unsigned char payload_type = payload_types.top();
+            for (int i = indices.top();
+                 payload_type != TAG_END && i < lengths.top(); ++i) {
+                skip_payload(payload_type, 1);
+            }
+            indices.pop();
+            lengths.pop();
+            payload_types.pop();
+        } else {
+            skip_payload(type, 0);
+        }
+
+        tag_ended = true;
+        handle_tag_end();
+        current_event = parser_event::TAG_END;
+    }
+
+    auto nbt_pull_parser::read_array() noexcept(false)
+        -> std::pair<unsigned char const *, std::size_t> {
+        if (current_event != parser_event::TAG_START ||
+            !is_array_type(types.top())) {
+            throw std::logic_error("read_array() called out of array start");
+        }
+
+        int rest = lengths.top() - indices.top();
+        std::size_t n_elems = rest > 0 ? rest : 0;
+        unsigned char const *elems = data + offset;
+        advance(n_elems * array_element_size(types.top()));
+        indices.pop();
+        lengths.pop();
+
+        tag_ended = true;
+        handle_tag_end();
+        current_event = parser_event::TAG_END;
+        return std::make_pair(elems, n_elems);
+    }
+
     auto nbt_pull_parser::next() noexcept(false) -> parser_event {
         if (offset >= length) {
             if (!names.empty()) {
@@ -199,7 +367,7 @@ namespace pixel_terrain::nbt {
         case TAG_BYTE:
             if (offset + sizeof(std::uint8_t) > length) {
                 throw std::out_of_range("buffer exhausted on tag byte (name: " +
-                                        get_tag_name() + ")");
+                                        std::string(get_tag_name()) + ")");
             }
             tag_data.byte_data = read_byte(data, &offset);
             tag_ended = true;
@@ -208,8 +376,8 @@ namespace pixel_terrain::nbt {
         case TAG_SHORT:
             if (offset + sizeof(std::uint16_t) > length) {
                 throw std::out_of_range(
-                    "buffer exhausted on tag short (name: " + get_tag_name() +
-                    ")");
+                    "buffer exhausted on tag short (name: " +
+                    std::string(get_tag_name()) + ")");
             }
             tag_data.short_data = read_short(data, &offset);
             tag_ended = true;
@@ -218,7 +386,7 @@ namespace pixel_terrain::nbt {
         case TAG_INT:
             if (offset + sizeof(std::uint32_t) > length) {
                 throw std::out_of_range("buffer exhausted on tag int (name: " +
-                                        get_tag_name() + ")");
+                                        std::string(get_tag_name()) + ")");
             }
             tag_data.int_data = read_int(data, &offset);
             tag_ended = true;
@@ -227,7 +395,7 @@ namespace pixel_terrain::nbt {
         case TAG_LONG:
             if (offset + sizeof(std::uint64_t) > length) {
                 throw std::out_of_range("buffer exhausted on tag long (name: " +
-                                        get_tag_name() + ")");
+                                        std::string(get_tag_name()) + ")");
             }
             tag_data.long_data = read_long(data, &offset);
             tag_ended = true;
@@ -236,8 +404,8 @@ namespace pixel_terrain::nbt {
         case TAG_FLOAT:
             if (offset + sizeof(float) > length) {
                 throw std::out_of_range(
-                    "buffer exhausted on tag float (name: " + get_tag_name() +
-                    ")");
+                    "buffer exhausted on tag float (name: " +
+                    std::string(get_tag_name()) + ")");
             }
             tag_data.float_data = read_float(data, &offset);
             tag_ended = true;
@@ -246,8 +414,8 @@ namespace pixel_terrain::nbt {
         case TAG_DOUBLE:
             if (offset + sizeof(double) > length) {
                 throw std::out_of_range(
-                    "buffer exhausted on tag double (name: " + get_tag_name() +
-                    ")");
+                    "buffer exhausted on tag double (name: " +
+                    std::string(get_tag_name()) + ")");
             }
             tag_data.double_data = read_double(data, &offset);
             tag_ended = true;
@@ -257,7 +425,7 @@ namespace pixel_terrain::nbt {
             if (indices.empty() || lengths.empty()) {
                 throw std::runtime_error(
                     "corrupted array length on tag byte array (name: " +
-                    get_tag_name() + ")");
+                    std::string(get_tag_name()) + ")");
             }
             if (indices.top() >= lengths.top()) {
                 tag_ended = true;
@@ -270,7 +438,7 @@ namespace pixel_terrain::nbt {
             if (offset + sizeof(std::uint8_t) > length) {
                 throw std::out_of_range(
                     "buffer exhausted on tag byte array (name: " +
-                    get_tag_name() + ")");
+                    std::string(get_tag_name()) + ")");
             }
             tag_data.byte_data = read_byte(data, &offset);
             ++(indices.top());
@@ -280,16 +448,15 @@ namespace pixel_terrain::nbt {
             if (offset + sizeof(std::uint16_t) > length) {
                 throw std::out_of_range(
                     "buffer exhausted on tag string header (name: " +
-                    get_tag_name() + ")");
+                    std::string(get_tag_name()) + ")");
             }
             tmp = read_short(data, &offset);
             if (offset + tmp > length) {
                 throw std::out_of_range(
                     "buffer exhausted on tag string data (name: " +
-                    get_tag_name() + ")");
+                    std::string(get_tag_name()) + ")");
             }
-            tag_data.string_data =
-                new std::string(read_string(data, &offset, tmp));
+            string_data = read_string_view(data, &offset, tmp);
             tag_ended = true;
             break;
 
@@ -297,7 +464,7 @@ namespace pixel_terrain::nbt {
             if (indices.empty() || lengths.empty()) {
                 throw std::runtime_error(
                     "corrupted array length on tag list (name: " +
-                    get_tag_name() + ")");
+                    std::string(get_tag_name()) + ")");
             }
             if (indices.top() >= lengths.top()) {
                 tag_ended = true;
@@ -317,7 +484,7 @@ namespace pixel_terrain::nbt {
             if (indices.empty() || lengths.empty()) {
                 throw std::runtime_error(
                     "corrupted array length on tag int array (name: " +
-                    get_tag_name() + ")");
+                    std::string(get_tag_name()) + ")");
             }
             if (indices.top() >= lengths.top()) {
                 tag_ended = true;
@@ -330,7 +497,7 @@ namespace pixel_terrain::nbt {
             if (offset + sizeof(std::uint32_t) > length) {
                 throw std::out_of_range(
                     "buffer exhausted on tag int array (name: " +
-                    get_tag_name() + ")");
+                    std::string(get_tag_name()) + ")");
             }
             tag_data.int_data = read_int(data, &offset);
             ++(indices.top());
@@ -340,7 +507,7 @@ namespace pixel_terrain::nbt {
             if (indices.empty() || lengths.empty()) {
                 throw std::runtime_error(
                     "corrupted array length on tag long array (name: " +
-                    get_tag_name() + ")");
+                    std::string(get_tag_name()) + ")");
             }
             if (indices.top() >= lengths.top()) {
                 tag_ended = true;
@@ -353,7 +520,7 @@ namespace pixel_terrain::nbt {
             if (offset + sizeof(std::uint64_t) > length) {
                 throw std::out_of_range(
                     "buffer exhausted on tag long array (name: " +
-                    get_tag_name() + ")");
+                    std::string(get_tag_name()) + ")");
             }
             tag_data.long_data = read_long(data, &offset);
             ++(indices.top());
@@ -368,7 +535,7 @@ namespace pixel_terrain::nbt {
         return current_event;
     }
 
-    auto nbt_pull_parser::get_tag_name() -> std::string {
+    auto nbt_pull_parser::get_tag_name() -> std::string_view {
         if (current_event == parser_event::TAG_END) {
             return last_tag_name;
         }
@@ -461,7 +628,7 @@ namespace pixel_terrain::nbt {
         return tag_data.double_data;
     }
 
-    auto nbt_pull_parser::get_string() const -> std::string {
+    auto nbt_pull_parser::get_string() const -> std::string_view {
         if (types.empty()) {
             throw std::logic_error(
                 "You tried to get string, but parser is not in any tags");
@@ -470,6 +637,6 @@ namespace pixel_terrain::nbt {
         if (type != TAG_STRING) {
             throw std::logic_error("Tried to get string on other type of tag");
         }
-        return *tag_data.string_data;
+        return string_data;
     }
 } // namespace pixel_terrain::nbt
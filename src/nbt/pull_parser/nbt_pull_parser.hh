@@ -4,8 +4,11 @@
 #define NBT_PULL_PARSER_HH
 
 #include <cstdint>
+#include <memory_resource>
 #include <stack>
 #include <string>
+#include <string_view>
+#include <utility>
 #include <vector>
 
 namespace pixel_terrain::nbt {
@@ -39,11 +42,14 @@ namespace pixel_terrain::nbt {
         parser_event current_event = parser_event::DOCUMENT_START;
         bool tag_ended = true;
         bool end_emitted = true;
-        std::stack<int> indices;
-        std::stack<int> lengths;
-        std::stack<unsigned char> types;
-        std::stack<int> payload_types;
-        std::stack<std::string> names;
+        std::stack<int, std::pmr::vector<int>> indices;
+        std::stack<int, std::pmr::vector<int>> lengths;
+        std::stack<unsigned char, std::pmr::vector<unsigned char>> types;
+        std::stack<int, std::pmr::vector<int>> payload_types;
+        /* Names and strings point into DATA, which outlives the parser. */
+        std::stack<std::string_view, std::pmr::vector<std::string_view>>
+            names;
+        std::string_view string_data;
         union tag_data_container {
             unsigned char byte_data;
             std::int16_t short_data;
@@ -51,12 +57,11 @@ namespace pixel_terrain::nbt {
             std::uint64_t long_data;
             float float_data;
             double double_data;
-            std::string *string_data;
 
             tag_data_container() = default;
             ~tag_data_container() = default;
         };
-        std::string last_tag_name;
+        std::string_view last_tag_name;
         unsigned char last_tag_type;
 
         tag_data_container tag_data;
@@ -66,14 +71,32 @@ namespace pixel_terrain::nbt {
         void parse_list_header();
         auto parse_list_data() -> parser_event;
         void handle_tag_end();
+        void require(std::size_t n) const;
+        void advance(std::size_t n);
+        void skip_payload(unsigned char type, int depth);
 
     public:
-        nbt_pull_parser(unsigned char *data, size_t length);
+        /* Stacks of the parser are allocated from RESOURCE. */
+        nbt_pull_parser(unsigned char *data, size_t length,
+                        std::pmr::memory_resource *resource =
+                            std::pmr::get_default_resource());
 
         auto next() noexcept(false) -> parser_event;
 
+        /* Skip the rest of current tag, including its children, without
+           emitting events for them.  Must be called on TAG_START; the
+           parser is then on TAG_END of the tag. */
+        void skip_tag() noexcept(false);
+
+        /* Read all elements of current array tag at once, and return
+           pointer to them, still in big endian, and number of them.  Must
+           be called on TAG_START of an array; the parser is then on
+           TAG_END of the tag. */
+        auto read_array() noexcept(false)
+            -> std::pair<unsigned char const *, std::size_t>;
+
         [[nodiscard]] auto get_event_type() noexcept -> parser_event;
-        [[nodiscard]] auto get_tag_name() -> std::string;
+        [[nodiscard]] auto get_tag_name() -> std::string_view;
         [[nodiscard]] auto get_tag_type() -> unsigned char;
 
         [[nodiscard]] auto get_byte() const -> unsigned char;
@@ -82,7 +105,7 @@ namespace pixel_terrain::nbt {
         [[nodiscard]] auto get_long() const -> std::uint64_t;
         [[nodiscard]] auto get_float() const -> float;
         [[nodiscard]] auto get_double() const -> double;
-        [[nodiscard]] auto get_string() const -> std::string;
+        [[nodiscard]] auto get_string() const -> std::string_view;
     };
 } // namespace pixel_terrain::nbt
 
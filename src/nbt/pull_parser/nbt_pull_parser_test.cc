@@ -741,3 +741,129 @@ BOOST_AUTO_TEST_CASE(parser_complex_3) {
     ev = p.next();
     BOOST_TEST(ev == parser_event::DOCUMENT_END);
 }
+
+BOOST_AUTO_TEST_CASE(parser_skip_list) {
+    // NOLINTNEXTLINE
+    unsigned char data[] = {10, 0, 3, 'f', 'o', 'o', 9,   0, 3, 'b', 'a', 'r',
+                            3,  0, 0, 0,   2,   0,   0,   0, 1, 0,   0,   0,
+                            2,  3, 0, 3,   'b', 'a', 'z', 0, 0, 0,   3,   0};
+    nbt_pull_parser p(data, 36); // NOLINT
+
+    parser_event ev = p.next();
+    BOOST_TEST(ev == parser_event::TAG_START);
+    BOOST_TEST(p.get_tag_name() == "foo");
+
+    ev = p.next();
+    BOOST_TEST(ev == parser_event::TAG_START);
+    BOOST_TEST(p.get_tag_name() == "bar");
+
+    p.skip_tag();
+    BOOST_TEST(p.get_event_type() == parser_event::TAG_END);
+    BOOST_TEST(p.get_tag_type() == TAG_LIST);
+    BOOST_TEST(p.get_tag_name() == "bar");
+
+    ev = p.next();
+    BOOST_TEST(ev == parser_event::TAG_START);
+    BOOST_TEST(p.get_tag_type() == TAG_INT);
+    BOOST_TEST(p.get_tag_name() == "baz");
+
+    p.skip_tag();
+    BOOST_TEST(p.get_event_type() == parser_event::TAG_END);
+
+    ev = p.next();
+    BOOST_TEST(ev == parser_event::TAG_END);
+    BOOST_TEST(p.get_tag_name() == "foo");
+
+    ev = p.next();
+    BOOST_TEST(ev == parser_event::DOCUMENT_END);
+}
+
+BOOST_AUTO_TEST_CASE(parser_skip_list_element) {
+    // NOLINTNEXTLINE
+    unsigned char data[] = {
+        9,   0, 3, 'f', 'o', 'o', 10,  0,   0,   0,                  // NOLINT
+        2,   1, 0, 3,   'b', 'a', 'r', 1,   1,   0,   3,   'b', 'a', // NOLINT
+        'z', 2, 0, 1,   0,   6,   'f', 'o', 'o', 'b', 'a', 'r', 3,   // NOLINT
+        0};                                                          // NOLINT
+    nbt_pull_parser p(data, 37);                                     // NOLINT
+
+    parser_event ev = p.next();
+    BOOST_TEST(ev == parser_event::TAG_START);
+    BOOST_TEST(p.get_tag_type() == TAG_LIST);
+
+    ev = p.next();
+    BOOST_TEST(ev == parser_event::TAG_START);
+    BOOST_TEST(p.get_tag_type() == TAG_COMPOUND);
+
+    p.skip_tag();
+    BOOST_TEST(p.get_event_type() == parser_event::TAG_END);
+    BOOST_TEST(p.get_tag_type() == TAG_COMPOUND);
+
+    ev = p.next();
+    BOOST_TEST(ev == parser_event::TAG_START);
+    BOOST_TEST(p.get_tag_type() == TAG_COMPOUND);
+
+    ev = p.next();
+    BOOST_TEST(ev == parser_event::TAG_START);
+    BOOST_TEST(p.get_tag_name() == "foobar");
+
+    ev = p.next();
+    BOOST_TEST(ev == parser_event::DATA);
+    BOOST_TEST(p.get_byte() == 3);
+
+    ev = p.next();
+    BOOST_TEST(ev == parser_event::TAG_END);
+
+    ev = p.next();
+    BOOST_TEST(ev == parser_event::TAG_END);
+
+    ev = p.next();
+    BOOST_TEST(ev == parser_event::TAG_END);
+
+    ev = p.next();
+    BOOST_TEST(ev == parser_event::DOCUMENT_END);
+}
+
+BOOST_AUTO_TEST_CASE(parser_skip_truncated) {
+    // NOLINTNEXTLINE
+    unsigned char data[] = {10, 0, 3, 'f', 'o', 'o', 11, 0, 3, 'b', 'a', 'r',
+                            0,  0, 0, 4,   0,   0,   0,  1};
+    nbt_pull_parser p(data, 20); // NOLINT
+
+    p.next();
+    BOOST_CHECK_THROW(p.skip_tag(), std::out_of_range);
+}
+
+BOOST_AUTO_TEST_CASE(parser_read_array) {
+    // NOLINTNEXTLINE
+    unsigned char data[] = {10, 0, 3, 'f', 'o', 'o', 11, 0, 3, 'b', 'a', 'r',
+                            0,  0, 0, 2,   0,   0,   0,  1, 0, 0,   0,   2,
+                            1,  0, 1, 'b', 7,   0};
+    nbt_pull_parser p(data, 30); // NOLINT
+
+    p.next();
+    parser_event ev = p.next();
+    BOOST_TEST(ev == parser_event::TAG_START);
+    BOOST_TEST(p.get_tag_type() == TAG_INT_ARRAY);
+
+    auto [elems, n_elems] = p.read_array();
+    BOOST_TEST(p.get_event_type() == parser_event::TAG_END);
+    BOOST_TEST(p.get_tag_name() == "bar");
+    BOOST_TEST(n_elems == 2);
+    BOOST_TEST(elems == data + 16);
+
+    ev = p.next();
+    BOOST_TEST(ev == parser_event::TAG_START);
+    BOOST_TEST(p.get_tag_name() == "b");
+    BOOST_CHECK_THROW(p.read_array(), std::logic_error);
+}
+
+BOOST_AUTO_TEST_CASE(parser_read_array_truncated) {
+    // NOLINTNEXTLINE
+    unsigned char data[] = {12, 0, 3, 'f', 'o', 'o', 0, 0, 0, 2,
+                            0,  0, 0, 0,   0,   0,   0, 1};
+    nbt_pull_parser p(data, 18); // NOLINT
+
+    p.next();
+    BOOST_CHECK_THROW(p.read_array(), std::out_of_range);
+}
@@ -0,0 +1,320 @@
+// SPDX-License-Identifier: MIT
+
+#include <algorithm>
+#include <array>
+#include <charconv>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <system_error>
+#include <vector>
+
+#include "nbt/pull_parser/nbt_pull_parser.hh"
+#include "nbt/pull_parser/nbt_query.hh"
+
+namespace pixel_terrain::nbt {
+    namespace {
+        auto trim(std::string_view str) -> std::string_view {
+            constexpr std::string_view spaces = " \t";
+            std::size_t first = str.find_first_not_of(spaces);
+            if (first == std::string_view::npos) {
+                return {};
+            }
+            return str.substr(first,
+                              str.find_last_not_of(spaces) - first + 1);
+        }
+
+        template <typename T>
+        auto parse_number(std::string_view str, T *result) -> bool {
+            auto [end, err] =
+                std::from_chars(str.data(), str.data() + str.size(), *result);
+            return err == std::errc() && end == str.data() + str.size();
+        }
+
+        template <typename T> void append_number(std::string *out, T value) {
+            std::array<char, 32> buf;
+            char *last =
+                std::to_chars(buf.data(), buf.data() + buf.size(), value).ptr;
+            out->append(buf.data(), last);
+        }
+
+        /* Read array element of type T stored in big endian at DATA. */
+        template <typename T>
+        auto read_element(unsigned char const *data) -> std::int64_t {
+            std::uint64_t value = 0;
+            for (std::size_t i = 0; i < sizeof(T); ++i) {
+                value = (value << 8U) | data[i]; // NOLINT
+            }
+            return static_cast<T>(value);
+        }
+
+        template <typename T>
+        void append_array(std::string *out, unsigned char const *elems,
+                          std::size_t n_elems) {
+            out->push_back('[');
+            for (std::size_t i = 0; i < n_elems; ++i) {
+                if (i != 0) {
+                    out->append(", ");
+                }
+                append_number(out, read_element<T>(elems + i * sizeof(T)));
+            }
+            out->push_back(']');
+        }
+    } // namespace
+
+    nbt_query::nbt_query(std::string_view expr) {
+        std::size_t op_pos = expr.find_first_of("=!<>");
+        std::string_view path = trim(expr.substr(0, op_pos));
+
+        while (!path.empty()) {
+            if (path.substr(0, 2) == "[]") {
+                steps_.push_back(step{"", true});
+                path.remove_prefix(2);
+                continue;
+            }
+            if (!steps_.empty()) {
+                if (path[0] != '.') {
+                    throw std::invalid_argument("expected . in path");
+                }
+                path.remove_prefix(1);
+            }
+            std::string_view name = path.substr(0, path.find_first_of(".["));
+            if (name.empty()) {
+                throw std::invalid_argument("empty tag name in path");
+            }
+            steps_.push_back(step{std::string(name), false});
+            path.remove_prefix(name.size());
+        }
+        if (steps_.empty()) {
+            throw std::invalid_argument("empty path");
+        }
+
+        if (op_pos == std::string_view::npos) {
+            return;
+        }
+        std::string_view rest = expr.substr(op_pos);
+        constexpr std::array<std::pair<std::string_view, comparison>, 6>
+            operators = {{{"==", comparison::EQ},
+                          {"!=", comparison::NE},
+                          {"<=", comparison::LE},
+                          {">=", comparison::GE},
+                          {"<", comparison::LT},
+                          {">", comparison::GT}}};
+        auto op = std::find_if(
+            operators.begin(), operators.end(), [rest](auto const &o) {
+                return rest.substr(0, o.first.size()) == o.first;
+            });
+        if (op == operators.end()) {
+            throw std::invalid_argument("unknown operator");
+        }
+        op_ = op->second;
+
+        std::string_view operand = trim(rest.substr(op->first.size()));
+        if (operand.empty()) {
+            throw std::invalid_argument("value to compare is missing");
+        }
+        if (operand.size() >= 2 && operand.front() == '"' &&
+            operand.back() == '"') {
+            operand = operand.substr(1, operand.size() - 2);
+        }
+        operand_ = operand;
+        operand_is_int_ = parse_number(operand, &int_operand_);
+        operand_is_number_ = parse_number(operand, &number_operand_);
+    }
+
+    template <typename T>
+    auto nbt_query::satisfies(T value, T operand) const -> bool {
+        switch (op_) {
+        case comparison::NONE:
+            return true;
+        case comparison::EQ:
+            return value == operand;
+        case comparison::NE:
+            return value != operand;
+        case comparison::LT:
+            return value < operand;
+        case comparison::LE:
+            return value <= operand;
+        case comparison::GT:
+            return value > operand;
+        case comparison::GE:
+            return value >= operand;
+        }
+        return false;
+    }
+
+    auto nbt_query::test_number(std::int64_t value) const -> bool {
+        if (op_ == comparison::NONE) {
+            return true;
+        }
+        if (operand_is_int_) {
+            return satisfies(value, int_operand_);
+        }
+        return operand_is_number_ &&
+               satisfies(static_cast<double>(value), number_operand_);
+    }
+
+    auto nbt_query::test_number(double value) const -> bool {
+        if (op_ == comparison::NONE) {
+            return true;
+        }
+        return operand_is_number_ && satisfies(value, number_operand_);
+    }
+
+    auto nbt_query::test_string(std::string_view value) const -> bool {
+        return satisfies(value, std::string_view(operand_));
+    }
+
+    /* Write value of tag P is on to VALUE, and return whether it satisfies
+       the condition.  P must be on TAG_START, and is then on TAG_END of the
+       tag. */
+    auto nbt_query::read_value(nbt_pull_parser *p, std::string *value) const
+        -> bool {
+        unsigned char type = p->get_tag_type();
+        switch (type) {
+        case TAG_COMPOUND:
+        case TAG_LIST:
+            p->skip_tag();
+            *value = type == TAG_COMPOUND ? "{...}" : "[...]";
+            return op_ == comparison::NONE;
+
+        case TAG_BYTE_ARRAY:
+        case TAG_INT_ARRAY:
+        case TAG_LONG_ARRAY: {
+            auto [elems, n_elems] = p->read_array();
+            if (type == TAG_BYTE_ARRAY) {
+                append_array<std::int8_t>(value, elems, n_elems);
+            } else if (type == TAG_INT_ARRAY) {
+                append_array<std::int32_t>(value, elems, n_elems);
+            } else {
+                append_array<std::int64_t>(value, elems, n_elems);
+            }
+            return op_ == comparison::NONE;
+        }
+
+        default:
+            break;
+        }
+
+        p->next();
+        bool ok;
+        switch (type) {
+        case TAG_STRING:
+            *value = p->get_string();
+            ok = test_string(p->get_string());
+            break;
+
+        case TAG_FLOAT:
+            append_number(value, p->get_float());
+            ok = test_number(static_cast<double>(p->get_float()));
+            break;
+
+        case TAG_DOUBLE:
+            append_number(value, p->get_double());
+            ok = test_number(p->get_double());
+            break;
+
+        default: {
+            std::int64_t n;
+            if (type == TAG_BYTE) {
+                n = static_cast<std::int8_t>(p->get_byte());
+            } else if (type == TAG_SHORT) {
+                n = p->get_short();
+            } else if (type == TAG_INT) {
+                n = p->get_int();
+            } else {
+                n = static_cast<std::int64_t>(p->get_long());
+            }
+            append_number(value, n);
+            ok = test_number(n);
+        } break;
+        }
+        p->next();
+        return ok;
+    }
+
+    auto nbt_query::run(nbt_pull_parser *p,
+                        std::function<bool(match const &)> const &on_match)
+        const -> std::size_t {
+        /* Tag on the path the parser is in. */
+        struct frame {
+            std::size_t n_steps;
+            unsigned char type;
+            int n_children;
+            /* Length of path before name of this tag. */
+            std::size_t path_size;
+        };
+        std::vector<frame> frames;
+        std::string path;
+        std::size_t n_matches = 0;
+        /* Without [], only one tag can match. */
+        bool single = std::none_of(steps_.begin(), steps_.end(),
+                                   [](step const &s) { return s.element; });
+
+        for (parser_event ev = p->next(); ev != parser_event::DOCUMENT_END;
+             ev = p->next()) {
+            if (ev == parser_event::TAG_END && !frames.empty()) {
+                path.resize(frames.back().path_size);
+                frames.pop_back();
+                continue;
+            }
+            if (ev != parser_event::TAG_START) {
+                continue;
+            }
+
+            std::size_t path_size = path.size();
+            std::size_t n_steps = 0;
+            if (!frames.empty()) {
+                frame &parent = frames.back();
+                step const &s = steps_[parent.n_steps];
+                bool in_list = parent.type == TAG_LIST;
+                int index = parent.n_children++;
+                if (s.element != in_list ||
+                    (!in_list && p->get_tag_name() != s.name)) {
+                    p->skip_tag();
+                    continue;
+                }
+                if (in_list) {
+                    path.push_back('[');
+                    append_number(&path, index);
+                    path.push_back(']');
+                } else {
+                    if (!path.empty()) {
+                        path.push_back('.');
+                    }
+                    path.append(s.name);
+                }
+                n_steps = parent.n_steps + 1;
+            }
+
+            if (n_steps == steps_.size()) {
+                match m;
+                if (read_value(p, &m.value)) {
+                    m.path = path;
+                    ++n_matches;
+                    if (!on_match(m)) {
+                        break;
+                    }
+                }
+                if (single) {
+                    break;
+                }
+                path.resize(path_size);
+                continue;
+            }
+
+            unsigned char type = p->get_tag_type();
+            if (type != TAG_COMPOUND && type != TAG_LIST) {
+                p->skip_tag();
+                path.resize(path_size);
+                continue;
+            }
+            frames.push_back(frame{n_steps, type, 0, path_size});
+        }
+
+        return n_matches;
+    }
+} // namespace pixel_terrain::nbt
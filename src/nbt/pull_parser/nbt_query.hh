@@ -0,0 +1,67 @@
+// SPDX-License-Identifier: MIT
+
+#ifndef NBT_QUERY_HH
+#define NBT_QUERY_HH
+
+#include <cstdint>
+#include <functional>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "nbt/pull_parser/nbt_pull_parser.hh"
+
+namespace pixel_terrain::nbt {
+    /* Query compiled from expression such as "Level.InhabitedTime > 100" or
+       "Inventory[].id == minecraft:diamond".  The path is relative to the
+       root tag; NAME selects child tag of a compound, and [] selects every
+       element of a list.  Value to compare with follows one of ==, !=, <,
+       <=, > or >=, and may be quoted with "".  Numbers are compared as
+       numbers, strings as strings. */
+    class nbt_query {
+        struct step {
+            std::string name;
+            /* Selects elements of list, instead of named tag. */
+            bool element;
+        };
+
+        enum class comparison { NONE, EQ, NE, LT, LE, GT, GE };
+
+        std::vector<step> steps_;
+        comparison op_ = comparison::NONE;
+        std::string operand_;
+        bool operand_is_int_ = false;
+        std::int64_t int_operand_ = 0;
+        bool operand_is_number_ = false;
+        double number_operand_ = 0;
+
+        template <typename T> auto satisfies(T value, T operand) const -> bool;
+        auto test_number(std::int64_t value) const -> bool;
+        auto test_number(double value) const -> bool;
+        auto test_string(std::string_view value) const -> bool;
+        auto read_value(nbt_pull_parser *p, std::string *value) const
+            -> bool;
+
+    public:
+        /* Tag found by the query, and its value in text.  Compounds and
+           lists are written as {...} and [...]. */
+        struct match {
+            std::string path;
+            std::string value;
+        };
+
+        /* Compile EXPR, or throw std::invalid_argument if it is
+           malformed. */
+        explicit nbt_query(std::string_view expr);
+
+        /* Find tags matching the query from P, which must be at
+           DOCUMENT_START, and pass each of them to ON_MATCH.  Subtrees off
+           the path are skipped without being parsed.  Stops early if
+           ON_MATCH returns false.  Return number of matches. */
+        auto run(nbt_pull_parser *p,
+                 std::function<bool(match const &)> const &on_match) const
+            -> std::size_t;
+    };
+} // namespace pixel_terrain::nbt
+
+#endif
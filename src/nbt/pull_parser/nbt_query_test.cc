@@ -0,0 +1,82 @@
+// SPDX-License-Identifier: MIT
+
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include <boost/test/tools/interface.hpp>
+#include <boost/test/unit_test.hpp>
+#include <boost/test/unit_test_suite.hpp>
+
+#include "nbt/pull_parser/nbt_pull_parser.hh"
+#include "nbt/pull_parser/nbt_query.hh"
+
+using namespace pixel_terrain::nbt;
+
+namespace {
+    /* {n: 5, items: [{id: "a"}, {id: "b", c: 7}], v: [I; 1, -1]} */
+    // NOLINTNEXTLINE
+    unsigned char data[] = {
+        10,  0,   0,   3,   0,   1,   'n', 0,   0,   0,   5,   9,   0, 5,
+        'i', 't', 'e', 'm', 's', 10,  0,   0,   0,   2,   8,   0,   2, 'i',
+        'd', 0,   1,   'a', 0,   8,   0,   2,   'i', 'd', 0,   1,   'b', 3,
+        0,   1,   'c', 0,   0,   0,   7,   0,   11,  0,   1,   'v', 0, 0,
+        0,   2,   0,   0,   0,   1,   255, 255, 255, 255, 0};
+
+    /* Run query EXPR on the data, and return "PATH=VALUE" of matches. */
+    auto run_query(char const *expr) -> std::vector<std::string> {
+        nbt_pull_parser p(data, sizeof(data));
+        std::vector<std::string> result;
+        nbt_query(expr).run(&p, [&result](nbt_query::match const &m) {
+            result.push_back(m.path + "=" + m.value);
+            return true;
+        });
+        return result;
+    }
+
+    using strings = std::vector<std::string>;
+} // namespace
+
+BOOST_AUTO_TEST_CASE(nbt_query_path) {
+    BOOST_TEST(run_query("n") == strings{"n=5"});
+    BOOST_TEST(run_query("items[].id") ==
+               (strings{"items[0].id=a", "items[1].id=b"}));
+    BOOST_TEST(run_query("items[]") ==
+               (strings{"items[0]={...}", "items[1]={...}"}));
+    BOOST_TEST(run_query("items") == strings{"items=[...]"});
+    BOOST_TEST(run_query("v") == strings{"v=[1, -1]"});
+    BOOST_TEST(run_query("x").empty());
+    BOOST_TEST(run_query("n.x").empty());
+    BOOST_TEST(run_query("items.id").empty());
+}
+
+BOOST_AUTO_TEST_CASE(nbt_query_condition) {
+    BOOST_TEST(run_query("items[].id == b") == strings{"items[1].id=b"});
+    BOOST_TEST(run_query("items[].id==\"a\"") == strings{"items[0].id=a"});
+    BOOST_TEST(run_query("items[].id != a") == strings{"items[1].id=b"});
+    BOOST_TEST(run_query("items[].c >= 7") == strings{"items[1].c=7"});
+    BOOST_TEST(run_query("n > 4.5") == strings{"n=5"});
+    BOOST_TEST(run_query("n <= 5") == strings{"n=5"});
+    BOOST_TEST(run_query("n < 5").empty());
+    BOOST_TEST(run_query("n == five").empty());
+    BOOST_TEST(run_query("items == x").empty());
+}
+
+BOOST_AUTO_TEST_CASE(nbt_query_stop) {
+    nbt_pull_parser p(data, sizeof(data));
+    std::size_t n_matches = nbt_query("items[].id")
+                                .run(&p, [](nbt_query::match const &) {
+                                    return false;
+                                });
+    BOOST_TEST(n_matches == 1U);
+}
+
+BOOST_AUTO_TEST_CASE(nbt_query_malformed) {
+    for (char const *expr :
+         {"", " ", ".n", "n.", "n..x", "a[1]", "a[", "n =", "n = 3", "n !3",
+          "n == "}) {
+        BOOST_TEST_CONTEXT(expr) {
+            BOOST_CHECK_THROW(nbt_query{expr}, std::invalid_argument);
+        }
+    }
+}
@@ -0,0 +1,38 @@
+// SPDX-License-Identifier: MIT
+
+#include <stdexcept>
+#include <string_view>
+
+#include "nbt/pull_parser/path_matcher.hh"
+
+namespace pixel_terrain::nbt {
+    path_matcher::path_matcher() : nodes_(1) {}
+
+    void path_matcher::add(std::initializer_list<std::string_view> path,
+                           unsigned int value) {
+        if (value == 0) {
+            throw std::invalid_argument("value of path must not be 0");
+        }
+
+        int state = ROOT;
+        for (std::string_view name : path) {
+            int next = child(state, name);
+            if (next == NONE) {
+                next = static_cast<int>(nodes_.size());
+                nodes_[state].children.emplace_back(name, next);
+                nodes_.emplace_back();
+            }
+            state = next;
+        }
+        nodes_[state].value = value;
+    }
+
+    auto path_matcher::child(int state, std::string_view name) const -> int {
+        for (auto const &[child_name, next] : nodes_[state].children) {
+            if (child_name == name) {
+                return next;
+            }
+        }
+        return NONE;
+    }
+} // namespace pixel_terrain::nbt
@@ -0,0 +1,48 @@
+// SPDX-License-Identifier: MIT
+
+#ifndef PATH_MATCHER_HH
+#define PATH_MATCHER_HH
+
+#include <initializer_list>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+namespace pixel_terrain::nbt {
+    /* Set of tag paths compiled into a tree of tag names, so that a pull
+       parser can follow it with one lookup per tag and skip subtrees no
+       path goes through.  A path starts with the name of the root tag,
+       which is usually empty. */
+    class path_matcher {
+        struct node {
+            /* Names are not copied; they must outlive the matcher. */
+            std::vector<std::pair<std::string_view, int>> children;
+            unsigned int value = 0;
+        };
+
+        std::vector<node> nodes_;
+
+    public:
+        /* State before the root tag. */
+        static constexpr int ROOT = 0;
+        /* State of tags no path goes through. */
+        static constexpr int NONE = -1;
+
+        path_matcher();
+
+        /* Add PATH, which matches with VALUE.  VALUE must not be 0. */
+        void add(std::initializer_list<std::string_view> path,
+                 unsigned int value);
+
+        /* State of child tag NAME of tag in state STATE, or NONE. */
+        [[nodiscard]] auto child(int state, std::string_view name) const
+            -> int;
+
+        /* Value of path ending at STATE, or 0 if no path ends there. */
+        [[nodiscard]] auto value(int state) const -> unsigned int {
+            return nodes_[state].value;
+        }
+    };
+} // namespace pixel_terrain::nbt
+
+#endif
@@ -0,0 +1,33 @@
+// SPDX-License-Identifier: MIT
+
+#include <boost/test/tools/interface.hpp>
+#include <boost/test/unit_test.hpp>
+#include <boost/test/unit_test_suite.hpp>
+
+#include "nbt/pull_parser/path_matcher.hh"
+
+using namespace pixel_terrain::nbt;
+
+BOOST_AUTO_TEST_CASE(path_matcher_follow_paths) {
+    path_matcher m;
+    m.add({"", "DataVersion"}, 1);
+    m.add({"", "Level", "Sections"}, 2);
+    m.add({"", "Level", "Biomes"}, 4);
+
+    int root = m.child(path_matcher::ROOT, "");
+    BOOST_TEST_REQUIRE(root != path_matcher::NONE);
+    BOOST_TEST(m.value(root) == 0U);
+    BOOST_TEST(m.child(path_matcher::ROOT, "Level") == path_matcher::NONE);
+
+    int data_version = m.child(root, "DataVersion");
+    BOOST_TEST_REQUIRE(data_version != path_matcher::NONE);
+    BOOST_TEST(m.value(data_version) == 1U);
+
+    int level = m.child(root, "Level");
+    BOOST_TEST_REQUIRE(level != path_matcher::NONE);
+    BOOST_TEST(m.value(level) == 0U);
+    BOOST_TEST(m.value(m.child(level, "Sections")) == 2U);
+    BOOST_TEST(m.value(m.child(level, "Biomes")) == 4U);
+    BOOST_TEST(m.child(level, "Entities") == path_matcher::NONE);
+    BOOST_TEST(m.child(root, "Sections") == path_matcher::NONE);
+}
@@ -5,6 +5,7 @@
 
 #include <algorithm>
 #include <array>
+#include <atomic>
 #include <cerrno>
 #include <cstdint>
 #include <cstring>
@@ -12,41 +13,55 @@
 #include <filesystem>
 #include <fstream>
 #include <memory>
+#include <memory_resource>
+#include <mutex>
 #include <stdexcept>
+#include <thread>
 
 #include <fcntl.h>
 #include <utility>
 #include <vector>
 
+#include "logger/metrics.hh"
+#include "logger/profile.hh"
 #include "nbt/constants.hh"
 #include "nbt/file.hh"
 #include "nbt/region.hh"
 #include "nbt/utils.hh"
+#include "utils/arena.hh"
 
 namespace pixel_terrain::anvil {
+    namespace {
+        constexpr std::size_t SECTOR_SIZE = 4096;
+        /* Enough for most chunks; grows if not. */
+        constexpr std::size_t CHUNK_ARENA_SIZE = 512 * 1024;
+        /* The arena is shrunk to this after each region, so that an
+           unusually large chunk does not hold memory outside of the
+           memory budget. */
+        constexpr std::size_t CHUNK_ARENA_MAX_SIZE = 4 * CHUNK_ARENA_SIZE;
+
+        /* Arena for data of the chunk the thread is working on. */
+        auto thread_chunk_arena() -> arena & {
+            thread_local arena chunk_arena(CHUNK_ARENA_SIZE);
+            return chunk_arena;
+        }
+    } // namespace
+
     region::region(std::filesystem::path const &filename) {
+        logger::profile::scoped_timer timer(
+            logger::profile::stage::REGION_MMAP);
         data = new file<unsigned char>(filename);
         len = data->size();
+        timer.add_bytes(len);
     }
 
-    region::region(std::filesystem::path const &filename,
-                   std::filesystem::path const &journal_dir) {
+    region::region(std::filesystem::path const &filename, journal *journal)
+        : journal_(journal), name_(filename.filename().string()) {
+        logger::profile::scoped_timer timer(
+            logger::profile::stage::REGION_MMAP);
         data = new file<unsigned char>(filename);
         len = data->size();
-
-        std::filesystem::path journal_path(journal_dir);
-        journal_path /=
-            std::filesystem::path(filename).filename().concat(".ptcache");
-        try {
-            last_update =
-                new file<std::uint64_t>(journal_path,
-                                        nbt::biomes::CHUNK_PER_REGION_WIDTH *
-                                            nbt::biomes::CHUNK_PER_REGION_WIDTH,
-                                        "r+");
-        } catch (...) {
-            delete data;
-            std::rethrow_exception(std::current_exception());
-        }
+        timer.add_bytes(len);
     }
 
     region::~region() {
@@ -88,49 +103,82 @@ namespace pixel_terrain::anvil {
         return (*data)[b_off + 3];
     }
 
-    auto region::chunk_data(int chunk_x, int chunk_z)
-        -> std::vector<std::uint8_t> * {
-        std::size_t location_off = chunk_location_off(chunk_x, chunk_z);
-        std::size_t location_sec = chunk_location_sectors(chunk_x, chunk_z);
-        if (location_off == 0 && location_sec == 0) {
-            return nullptr;
-        }
-
-        location_off *= 4096; // NOLINT
-
-        if (location_off + 4 >= len) {
-            return nullptr;
+    template <typename Vector>
+    auto region::inflate_chunk(std::size_t offset,
+                               nbt::utils::zlib_inflater *inflater,
+                               Vector *out) -> bool {
+        if (offset + 4 >= len) {
+            return false;
         }
 
         std::int32_t length;
-        std::memcpy(&length, data->get_raw_data() + location_off,
+        std::memcpy(&length, data->get_raw_data() + offset,
                     sizeof(std::int32_t));
         length = nbt::utils::to_host_byte_order(length);
-        location_off += 4;
+        offset += 4;
 
-        int compression = (*data)[location_off];
+        int compression = (*data)[offset];
         if (compression == 1) {
+            return false;
+        }
+        ++offset;
+
+        if (offset + length - 1 > len) {
+            return false;
+        }
+
+        static logger::metrics::counter &inflated_bytes =
+            logger::metrics::get_counter("pixel_terrain_inflated_bytes_total",
+                                         "Bytes of chunk data inflated.");
+
+        logger::profile::scoped_timer timer(
+            logger::profile::stage::CHUNK_INFLATE);
+        timer.add_bytes(length - 1);
+        if (!inflater->inflate(data->get_raw_data() + offset, length - 1,
+                               out)) {
+            return false;
+        }
+        inflated_bytes.add(out->size());
+        return true;
+    }
+
+    auto region::inflate_chunk(std::size_t offset,
+                               nbt::utils::zlib_inflater *inflater)
+        -> std::vector<std::uint8_t> * {
+        auto *result = new std::vector<std::uint8_t>;
+        if (!inflate_chunk(offset, inflater, result)) {
+            delete result;
             return nullptr;
         }
-        ++location_off;
+        return result;
+    }
 
-        if (location_off + length - 1 > len) {
+    auto region::chunk_data(int chunk_x, int chunk_z)
+        -> std::vector<std::uint8_t> * {
+        std::size_t location_off = chunk_location_off(chunk_x, chunk_z);
+        std::size_t location_sec = chunk_location_sectors(chunk_x, chunk_z);
+        if (location_off == 0 && location_sec == 0) {
             return nullptr;
         }
 
-        return nbt::utils::zlib_decompress(data->get_raw_data() + location_off,
-                                           length - 1);
+        nbt::utils::zlib_inflater inflater;
+        return inflate_chunk(location_off * SECTOR_SIZE, &inflater);
     }
 
     auto region::get_chunk(int chunk_x, int chunk_z) -> chunk * {
-        auto data = chunk_data(chunk_x, chunk_z);
+        std::size_t location_off = chunk_location_off(chunk_x, chunk_z);
+        std::size_t location_sec = chunk_location_sectors(chunk_x, chunk_z);
+        if (location_off == 0 && location_sec == 0) {
+            return nullptr;
+        }
 
-        if (data == nullptr) {
+        nbt::utils::zlib_inflater inflater;
+        std::pmr::vector<std::uint8_t> data;
+        if (!inflate_chunk(location_off * SECTOR_SIZE, &inflater, &data)) {
             return nullptr;
         }
 
-        auto *cur_chunk = new chunk(data);
-        return cur_chunk;
+        return new chunk(std::move(data));
     }
 
     auto region::exists_chunk_data(int chunk_x, int chunk_z) -> bool {
@@ -138,24 +186,154 @@ namespace pixel_terrain::anvil {
                chunk_location_sectors(chunk_x, chunk_z) == 0;
     }
 
-    auto region::get_chunk_if_dirty(int chunk_x, int chunk_z) -> chunk * {
-        std::vector<std::uint8_t> *data = chunk_data(chunk_x, chunk_z);
-        if (data == nullptr) {
-            return nullptr;
+    auto region::chunk_locations() -> std::vector<chunk_location> {
+        std::vector<chunk_location> result;
+        for (int chunk_z = 0; chunk_z < nbt::biomes::CHUNK_PER_REGION_WIDTH;
+             ++chunk_z) {
+            for (int chunk_x = 0;
+                 chunk_x < nbt::biomes::CHUNK_PER_REGION_WIDTH; ++chunk_x) {
+                std::size_t off = chunk_location_off(chunk_x, chunk_z);
+                std::size_t sectors = chunk_location_sectors(chunk_x, chunk_z);
+                if (off == 0 && sectors == 0) {
+                    continue;
+                }
+                result.push_back(chunk_location{chunk_x, chunk_z,
+                                                off * SECTOR_SIZE,
+                                                sectors * SECTOR_SIZE});
+            }
         }
 
-        auto *cur_chunk = new chunk(data);
-        if (last_update != nullptr) {
-            if ((*last_update)[chunk_z * nbt::biomes::CHUNK_PER_REGION_WIDTH +
-                               chunk_x] >= cur_chunk->get_last_update()) {
-                delete cur_chunk;
-                return nullptr;
+        std::sort(result.begin(), result.end(),
+                  [](chunk_location const &a, chunk_location const &b) {
+                      return a.offset < b.offset;
+                  });
+        return result;
+    }
+
+    void region::prefetch() const { data->prefetch(); }
+
+    void region::for_each_location(chunk_filter const &filter,
+                                   unsigned int n_threads,
+                                   location_visitor const &visit) {
+        std::vector<chunk_location> locations = chunk_locations();
+        if (filter) {
+            std::erase_if(locations, [&](chunk_location const &loc) {
+                return !filter(loc.chunk_x, loc.chunk_z);
+            });
+        }
+
+        std::atomic_size_t next = 0;
+        std::exception_ptr error;
+        std::mutex error_mutex;
+
+        auto run = [&]() {
+            try {
+                nbt::utils::zlib_inflater inflater;
+                std::size_t i;
+                while ((i = next.fetch_add(1, std::memory_order_relaxed)) <
+                       locations.size()) {
+                    visit(locations[i], &inflater);
+                }
+            } catch (...) {
+                std::unique_lock<std::mutex> lock(error_mutex);
+                if (!error) {
+                    error = std::current_exception();
+                }
+                /* Let other threads stop early. */
+                next = locations.size();
             }
+        };
+
+        n_threads = std::min<std::size_t>(n_threads, locations.size());
+        std::vector<std::thread> threads;
+        for (unsigned int i = 1; i < n_threads; ++i) {
+            threads.emplace_back(run);
+        }
+        run();
+        for (std::thread &t : threads) {
+            t.join();
+        }
+
+        if (error) {
+            std::rethrow_exception(error);
+        }
+    }
+
+    void region::for_each_chunk_data(chunk_data_callback const &callback,
+                                     chunk_filter const &filter,
+                                     unsigned int n_threads) {
+        for_each_location(
+            filter, n_threads,
+            [&](chunk_location const &loc,
+                nbt::utils::zlib_inflater *inflater) {
+                callback(loc.chunk_x, loc.chunk_z,
+                         inflate_chunk(loc.offset, inflater));
+            });
+    }
+
+    void region::for_each_chunk(chunk_callback const &callback,
+                                chunk_filter const &filter,
+                                unsigned int n_threads) {
+        for_each_location(
+            filter, n_threads,
+            [&](chunk_location const &loc,
+                nbt::utils::zlib_inflater *inflater) {
+                /* Everything of previous chunk is gone by now. */
+                arena &chunk_arena = thread_chunk_arena();
+                chunk_arena.reset();
+
+                std::pmr::vector<std::uint8_t> chunk_data(
+                    chunk_arena.resource());
+                if (!inflate_chunk(loc.offset, inflater, &chunk_data)) {
+                    callback(loc.chunk_x, loc.chunk_z, nullptr);
+                    return;
+                }
+
+                chunk chunk(std::move(chunk_data));
+                callback(loc.chunk_x, loc.chunk_z, &chunk);
+            });
+
+        /* Arenas of the other threads are gone with the threads. */
+        thread_chunk_arena().trim(CHUNK_ARENA_MAX_SIZE);
+    }
+
+    auto region::take_if_updated(int chunk_x, int chunk_z, chunk *chunk)
+        -> bool {
+        return take_chunk(chunk_x, chunk_z, chunk, false);
+    }
+
+    void region::take(int chunk_x, int chunk_z, chunk *chunk) {
+        take_chunk(chunk_x, chunk_z, chunk, true);
+    }
+
+    auto region::take_chunk(int chunk_x, int chunk_z, chunk *chunk,
+                            bool force) -> bool {
+        if (journal_ == nullptr) {
+            return true;
+        }
+
+        if (last_update == nullptr) {
+            last_update =
+                new journal::timestamps(journal_->get_timestamps(name_));
+        }
+
+        int index = chunk_z * nbt::biomes::CHUNK_PER_REGION_WIDTH + chunk_x;
+        std::uint64_t chunk_last_update = chunk->get_last_update();
+        if ((*last_update)[index] >= chunk_last_update) {
+            return force;
+        }
+
+        (*last_update)[index] = chunk_last_update;
+        pending_updates_.emplace_back(index, chunk_last_update);
+        return true;
+    }
 
-            (*last_update)[chunk_z * nbt::biomes::CHUNK_PER_REGION_WIDTH +
-                           chunk_x] = cur_chunk->get_last_update();
+    void region::commit_last_update() {
+        if (journal_ == nullptr) {
+            return;
         }
 
-        return cur_chunk;
+        journal_->commit(name_, pending_updates_);
+        pending_updates_.clear();
     }
 } // namespace pixel_terrain::anvil
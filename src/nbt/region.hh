@@ -4,6 +4,7 @@
 #define REGION_HH
 
 #include <cstdint>
+#include <functional>
 #include <memory>
 #include <string>
 #include <utility>
@@ -11,30 +12,115 @@
 
 #include "nbt/chunk.hh"
 #include "nbt/file.hh"
+#include "nbt/journal.hh"
+#include "nbt/utils.hh"
 #include "utils/path_hack.hh"
 
 namespace pixel_terrain::anvil {
+    struct chunk_location {
+        int chunk_x;
+        int chunk_z;
+        /* offset of chunk payload in region file, in bytes. */
+        std::size_t offset;
+        std::size_t length;
+    };
+
     class region {
         file<unsigned char> *data = nullptr;
         std::size_t len;
-        file<std::uint64_t> *last_update = nullptr;
+        journal *journal_ = nullptr;
+        std::string name_;
+        journal::timestamps *last_update = nullptr;
+        std::vector<journal::update> pending_updates_;
 
         static auto header_offset(int chunk_x, int chunk_z) -> std::size_t;
         auto chunk_location_off(int chunk_x, int chunk_z) -> std::size_t;
         auto chunk_location_sectors(int chunk_x, int chunk_z) -> std::size_t;
+        template <typename Vector>
+        auto inflate_chunk(std::size_t offset,
+                           nbt::utils::zlib_inflater *inflater, Vector *out)
+            -> bool;
+        auto inflate_chunk(std::size_t offset,
+                           nbt::utils::zlib_inflater *inflater)
+            -> std::vector<std::uint8_t> *;
 
     public:
+        /* Callbacks of for_each_chunk_data() and for_each_chunk().  The
+           data or the chunk is nullptr if the chunk is stored but can't be
+           read.  The callback takes ownership of the data, while the chunk
+           lives in memory of the calling thread, which is reused for the
+           next chunk; it is only valid until the callback returns. */
+        using chunk_data_callback = std::function<void(
+            int chunk_x, int chunk_z, std::vector<std::uint8_t> *data)>;
+        using chunk_callback =
+            std::function<void(int chunk_x, int chunk_z, chunk *chunk)>;
+        /* Return true to visit the chunk. */
+        using chunk_filter = std::function<bool(int chunk_x, int chunk_z)>;
+
         /* Construct new region object from given buffer of *.mca file content
          */
         region(std::filesystem::path const &filename);
-        region(std::filesystem::path const &filename,
-               std::filesystem::path const &journal_dir);
+        /* Construct new region object which renders only chunks updated
+           since the last commit recorded in JOURNAL. */
+        region(std::filesystem::path const &filename, journal *journal);
         ~region();
+
+        region(region const &) = delete;
+        auto operator=(region const &) -> region & = delete;
+
         auto chunk_data(int chunk_x, int chunk_z)
             -> std::vector<std::uint8_t> *;
         auto get_chunk(int chunk_x, int chunk_z) -> chunk *;
-        auto get_chunk_if_dirty(int chunk_x, int chunk_z) -> chunk *;
         auto exists_chunk_data(int chunk_x, int chunk_z) -> bool;
+
+        /* Inflate every chunk accepted by FILTER (or every chunk if FILTER
+           is empty) in the order they are stored in region file, and pass
+           them to CALLBACK.  Header is read and inflate context is set up
+           only once for the whole region.  If N_THREADS is more than 1,
+           chunks are distributed across that many threads including the
+           calling one, and CALLBACK is called concurrently.  Exception
+           thrown by CALLBACK is rethrown after all threads finish. */
+        void for_each_chunk_data(chunk_data_callback const &callback,
+                                 chunk_filter const &filter = nullptr,
+                                 unsigned int n_threads = 1);
+        /* Same as for_each_chunk_data(), but pass parsed chunks. */
+        void for_each_chunk(chunk_callback const &callback,
+                            chunk_filter const &filter = nullptr,
+                            unsigned int n_threads = 1);
+
+        /* Return true if CHUNK at the coordinate is updated since the last
+           commit recorded in the journal, and remember its timestamp to be
+           recorded by commit_last_update().  Always true if the region is
+           opened without journal.  Not thread safe. */
+        auto take_if_updated(int chunk_x, int chunk_z, chunk *chunk)
+            -> bool;
+        /* Same as take_if_updated(), but take CHUNK even if it is not
+           updated. */
+        void take(int chunk_x, int chunk_z, chunk *chunk);
+
+        /* Return locations of all chunks stored in the region, sorted by
+           their position in region file. */
+        auto chunk_locations() -> std::vector<chunk_location>;
+
+        /* Start reading region file in background. */
+        void prefetch() const;
+
+        /* Record timestamps of chunks taken by take_if_updated() to the
+           journal.  Call this after the output is saved successfully. */
+        void commit_last_update();
+
+    private:
+        auto take_chunk(int chunk_x, int chunk_z, chunk *chunk, bool force)
+            -> bool;
+
+        using location_visitor = std::function<void(
+            chunk_location const &location,
+            nbt::utils::zlib_inflater *inflater)>;
+        /* Call VISIT for locations of chunks accepted by FILTER, from
+           N_THREADS threads, passing inflate context of the thread. */
+        void for_each_location(chunk_filter const &filter,
+                               unsigned int n_threads,
+                               location_visitor const &visit);
     };
 } // namespace pixel_terrain::anvil
 
@@ -0,0 +1,154 @@
+// SPDX-License-Identifier: MIT
+
+/* Unpackers of BlockStates, specialized for each entry width so that shifts
+   and masks are constants and loops have fixed trip counts.  Compilers can
+   unroll and vectorize them. */
+
+#include <algorithm>
+#include <array>
+#include <bit>
+#include <cstddef>
+#include <cstdint>
+#include <utility>
+
+#include "nbt/unpack.hh"
+
+namespace pixel_terrain::anvil {
+    namespace {
+        constexpr unsigned int MIN_BITS = 4;
+        constexpr unsigned int MAX_BITS = 15;
+        constexpr unsigned int WORD_BITS = 64;
+
+        template <unsigned int Bits>
+        constexpr std::uint64_t MASK = (std::uint64_t(1) << Bits) - 1;
+
+        template <unsigned int Bits>
+        void unpack_packed(std::uint64_t const *words, std::size_t n_words,
+                           std::uint16_t *out) {
+            constexpr unsigned int per_word = WORD_BITS / Bits;
+            constexpr std::size_t n_full_words =
+                BLOCK_STATES_ENTRIES / per_word;
+            constexpr unsigned int n_rest = BLOCK_STATES_ENTRIES % per_word;
+
+            std::size_t n = std::min(n_words, n_full_words);
+            for (std::size_t w = 0; w < n; ++w) {
+                std::uint64_t word = words[w];
+                for (unsigned int i = 0; i < per_word; ++i) {
+                    out[w * per_word + i] = (word >> (i * Bits)) & MASK<Bits>;
+                }
+            }
+            if (n < n_full_words) {
+                std::fill(out + n * per_word, out + BLOCK_STATES_ENTRIES, 0);
+                return;
+            }
+
+            if constexpr (n_rest != 0) {
+                std::uint64_t word =
+                    n_words > n_full_words ? words[n_full_words] : 0;
+                for (unsigned int i = 0; i < n_rest; ++i) {
+                    out[n_full_words * per_word + i] =
+                        (word >> (i * Bits)) & MASK<Bits>;
+                }
+            }
+        }
+
+        /* Extract I-th entry of a group of 64 entries. */
+        template <unsigned int Bits, unsigned int I>
+        inline auto extract_stretched(std::uint64_t const *words)
+            -> std::uint16_t {
+            constexpr unsigned int w = I * Bits / WORD_BITS;
+            constexpr unsigned int offset = I * Bits % WORD_BITS;
+
+            std::uint64_t value = words[w] >> offset;
+            if constexpr (offset + Bits > WORD_BITS) {
+                value |= words[w + 1] << (WORD_BITS - offset);
+            }
+            return value & MASK<Bits>;
+        }
+
+        /* Unpack 64 entries, which take exactly Bits words.  Offsets are
+           expanded to constants for each entry. */
+        template <unsigned int Bits, unsigned int... I>
+        inline void
+        unpack_stretched_group(std::uint64_t const *words, std::uint16_t *out,
+                               std::integer_sequence<unsigned int, I...>
+                               /*unused*/) {
+            ((out[I] = extract_stretched<Bits, I>(words)), ...);
+        }
+
+        template <unsigned int Bits>
+        void unpack_stretched(std::uint64_t const *words, std::size_t n_words,
+                              std::uint16_t *out) {
+            constexpr std::size_t n_groups = BLOCK_STATES_ENTRIES / WORD_BITS;
+
+            if constexpr (WORD_BITS % Bits == 0) {
+                /* No entry spans two words; same as packed layout. */
+                unpack_packed<Bits>(words, n_words, out);
+                return;
+            }
+
+            std::size_t n = std::min(n_words / Bits, n_groups);
+            for (std::size_t g = 0; g < n; ++g) {
+                unpack_stretched_group<Bits>(
+                    words + g * Bits, out + g * WORD_BITS,
+                    std::make_integer_sequence<unsigned int, WORD_BITS>());
+            }
+            if (n < n_groups) {
+                unpack_generic(words, n_words, Bits, true, out, n * WORD_BITS);
+            }
+        }
+
+        template <std::size_t... I>
+        constexpr auto make_unpackers(std::index_sequence<I...> /*unused*/)
+            -> std::array<std::array<unpack_func, 2>, sizeof...(I)> {
+            return {{{&unpack_packed<MIN_BITS + I>,
+                      &unpack_stretched<MIN_BITS + I>}...}};
+        }
+
+        constexpr auto unpackers = make_unpackers(
+            std::make_index_sequence<MAX_BITS - MIN_BITS + 1>());
+    } // namespace
+
+    void unpack_generic(std::uint64_t const *words, std::size_t n_words,
+                        unsigned int bits, bool stretches, std::uint16_t *out,
+                        int begin) {
+        std::uint64_t mask =
+            bits >= WORD_BITS ? ~std::uint64_t(0)
+                              : (std::uint64_t(1) << bits) - 1;
+        unsigned int per_word = stretches ? 0 : WORD_BITS / bits;
+
+        for (int i = begin; i < BLOCK_STATES_ENTRIES; ++i) {
+            std::uint64_t value = 0;
+            if (stretches) {
+                std::uint64_t bit = static_cast<std::uint64_t>(i) * bits;
+                std::size_t w = bit / WORD_BITS;
+                unsigned int offset = bit % WORD_BITS;
+                if (w < n_words) {
+                    value = words[w] >> offset;
+                    if (offset + bits > WORD_BITS && w + 1 < n_words) {
+                        value |= words[w + 1] << (WORD_BITS - offset);
+                    }
+                }
+            } else if (std::size_t w = i / per_word; w < n_words) {
+                value = words[w] >> (i % per_word * bits);
+            }
+            value &= mask;
+
+            /* Such a large index can't be valid anyway. */
+            out[i] = value > UINT16_MAX ? 0 : value;
+        }
+    }
+
+    auto bits_per_entry(std::size_t palette_size) -> unsigned int {
+        return std::max<unsigned int>(
+            MIN_BITS, std::bit_width(std::max<std::size_t>(palette_size, 1) -
+                                     1));
+    }
+
+    auto get_unpacker(unsigned int bits, bool stretches) -> unpack_func {
+        if (bits < MIN_BITS || MAX_BITS < bits) {
+            return nullptr;
+        }
+        return unpackers[bits - MIN_BITS][stretches ? 1 : 0];
+    }
+} // namespace pixel_terrain::anvil
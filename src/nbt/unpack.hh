@@ -0,0 +1,36 @@
+// SPDX-License-Identifier: MIT
+
+#ifndef UNPACK_HH
+#define UNPACK_HH
+
+#include <cstddef>
+#include <cstdint>
+
+namespace pixel_terrain::anvil {
+    /* Number of entries in BlockStates of a section. */
+    inline constexpr int BLOCK_STATES_ENTRIES = 16 * 16 * 16;
+
+    /* Unpack all BLOCK_STATES_ENTRIES palette indices in WORDS to OUT.
+       Words beyond N_WORDS are read as 0. */
+    using unpack_func = void (*)(std::uint64_t const *words,
+                                 std::size_t n_words, std::uint16_t *out);
+
+    /* Bits per entry for a palette of PALETTE_SIZE entries. */
+    [[nodiscard]] auto bits_per_entry(std::size_t palette_size)
+        -> unsigned int;
+
+    /* Return unpacker for entries BITS bits wide, or nullptr if BITS is not
+       supported.  If STRETCHES, entries may span two words (before 1.16);
+       otherwise each word holds as many whole entries as fit and the rest
+       of the word is padding. */
+    [[nodiscard]] auto get_unpacker(unsigned int bits, bool stretches)
+        -> unpack_func;
+
+    /* Slow unpacker for any width, from BEGIN-th entry.  Used for widths
+       get_unpacker() doesn't support and for truncated data. */
+    void unpack_generic(std::uint64_t const *words, std::size_t n_words,
+                        unsigned int bits, bool stretches, std::uint16_t *out,
+                        int begin = 0);
+} // namespace pixel_terrain::anvil
+
+#endif
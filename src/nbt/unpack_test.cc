@@ -0,0 +1,125 @@
+// SPDX-License-Identifier: MIT
+
+#include <cmath>
+#include <cstdint>
+#include <random>
+#include <vector>
+
+#include <boost/test/tools/interface.hpp>
+#include <boost/test/unit_test.hpp>
+#include <boost/test/unit_test_suite.hpp>
+
+#include "nbt/unpack.hh"
+
+using namespace pixel_terrain;
+
+namespace {
+    /* Decoder previously used by chunk::get_block(), kept as reference. */
+    auto reference_unpack(std::vector<std::uint64_t> const &states,
+                          unsigned int bits, bool stretches, int index)
+        -> std::uint64_t {
+        int state;
+        if (stretches) {
+            state = index * bits / 64;
+        } else {
+            state = index / (64 / bits);
+        }
+
+        if (static_cast<std::uint64_t>(state) >= states.size()) {
+            return 0;
+        }
+
+        std::uint64_t data = states[state];
+
+        std::uint64_t shifted_data;
+        if (stretches) {
+            shifted_data = data >> ((bits * index) % 64);
+        } else {
+            shifted_data = data >> (index % (64 / bits) * bits);
+        }
+
+        if (stretches && 64 - ((bits * index) % 64) < bits) {
+            data = states[state + 1];
+
+            int leftover = (bits - ((state + 1) * 64 % bits)) % bits;
+            shifted_data =
+                ((data & (static_cast<std::int64_t>(pow(2, leftover)) - 1))
+                 << (bits - leftover)) |
+                shifted_data;
+        }
+
+        return shifted_data & (static_cast<std::int64_t>(pow(2, bits)) - 1);
+    }
+
+    auto n_words(unsigned int bits, bool stretches) -> std::size_t {
+        if (stretches) {
+            return anvil::BLOCK_STATES_ENTRIES * bits / 64;
+        }
+        std::size_t per_word = 64 / bits;
+        return (anvil::BLOCK_STATES_ENTRIES + per_word - 1) / per_word;
+    }
+
+    auto random_words(std::size_t n, unsigned int seed)
+        -> std::vector<std::uint64_t> {
+        std::mt19937_64 rng(seed);
+        std::vector<std::uint64_t> words(n);
+        for (std::uint64_t &w : words) {
+            w = rng();
+        }
+        return words;
+    }
+
+    void check_unpack(std::vector<std::uint64_t> const &words,
+                      unsigned int bits, bool stretches) {
+        std::vector<std::uint16_t> out(anvil::BLOCK_STATES_ENTRIES);
+        anvil::unpack_func unpack = anvil::get_unpacker(bits, stretches);
+        BOOST_TEST_REQUIRE(unpack != nullptr);
+        unpack(words.data(), words.size(), out.data());
+
+        std::vector<std::uint16_t> generic(anvil::BLOCK_STATES_ENTRIES);
+        anvil::unpack_generic(words.data(), words.size(), bits, stretches,
+                              generic.data());
+
+        for (int i = 0; i < anvil::BLOCK_STATES_ENTRIES; ++i) {
+            std::uint64_t expected =
+                reference_unpack(words, bits, stretches, i);
+            BOOST_TEST_REQUIRE(out[i] == expected,
+                               "bits " << bits << ", index " << i);
+            BOOST_TEST_REQUIRE(generic[i] == expected,
+                               "bits " << bits << ", index " << i);
+        }
+    }
+} // namespace
+
+BOOST_AUTO_TEST_CASE(unpack_matches_reference) {
+    for (unsigned int bits = 4; bits <= 15; ++bits) {
+        for (bool stretches : {false, true}) {
+            check_unpack(random_words(n_words(bits, stretches), bits), bits,
+                         stretches);
+        }
+    }
+}
+
+BOOST_AUTO_TEST_CASE(unpack_truncated) {
+    for (unsigned int bits = 4; bits <= 15; ++bits) {
+        /* Cut at a word boundary in the middle of the section.  For
+           stretched layout, cut where no entry spans the missing word,
+           since the reference decoder reads beyond the end in such case. */
+        std::size_t n = n_words(bits, false) / 2;
+        check_unpack(random_words(n, bits), bits, false);
+        check_unpack({}, bits, false);
+
+        n = n_words(bits, true) / 2 / bits * bits;
+        check_unpack(random_words(n, bits), bits, true);
+        check_unpack({}, bits, true);
+    }
+}
+
+BOOST_AUTO_TEST_CASE(bits_per_entry) {
+    BOOST_TEST(anvil::bits_per_entry(1) == 4);
+    BOOST_TEST(anvil::bits_per_entry(16) == 4);
+    BOOST_TEST(anvil::bits_per_entry(17) == 5);
+    BOOST_TEST(anvil::bits_per_entry(32) == 5);
+    BOOST_TEST(anvil::bits_per_entry(33) == 6);
+    BOOST_TEST(anvil::bits_per_entry(4096) == 12);
+}
@@ -3,6 +3,7 @@
 #include <algorithm>
 #include <filesystem>
 #include <memory>
+#include <memory_resource>
 #include <stdexcept>
 #include <tuple>
 #include <utility>
@@ -17,53 +18,96 @@ namespace pixel_terrain::nbt::utils {
         inline constexpr std::size_t ZLIB_IO_BUF_SIZE = 1024;
     }
 
-    auto zlib_decompress(std::uint8_t *data, std::size_t const len)
-        -> std::vector<std::uint8_t> * {
-        int z_ret;
-        z_stream strm;
-        strm.zalloc = Z_NULL;
-        strm.zfree = Z_NULL;
-        strm.opaque = Z_NULL;
-        strm.avail_in = 0;
-        strm.next_in = Z_NULL;
-        std::array<std::uint8_t, ZLIB_IO_BUF_SIZE> out;
-
-        z_ret = inflateInit(&strm);
-        if (z_ret != Z_OK) {
-            return nullptr;
+    zlib_inflater::zlib_inflater() : strm_(new z_stream) {
+        strm_->zalloc = Z_NULL;
+        strm_->zfree = Z_NULL;
+        strm_->opaque = Z_NULL;
+        strm_->avail_in = 0;
+        strm_->next_in = Z_NULL;
+
+        if (inflateInit(strm_) != Z_OK) {
+            delete strm_;
+            throw std::runtime_error("Failed to initialize zlib");
         }
+    }
 
-        auto *all_out = new std::vector<std::uint8_t>;
+    zlib_inflater::~zlib_inflater() {
+        inflateEnd(strm_);
+        delete strm_;
+    }
 
-        strm.avail_in = len;
-        strm.next_in = data;
+    template <typename Vector>
+    auto zlib_inflater::inflate_to(std::uint8_t const *data, std::size_t len,
+                                   Vector *out) -> bool {
+        if (inflateReset(strm_) != Z_OK) {
+            return false;
+        }
 
-        do {
-            strm.avail_out = ZLIB_IO_BUF_SIZE;
-            strm.next_out = out.data();
+        /* Inflate directly to the result, growing it as needed. */
+        out->resize(std::max(size_hint_, ZLIB_IO_BUF_SIZE));
 
-            z_ret = inflate(&strm, Z_NO_FLUSH);
+        strm_->avail_in = len;
+        strm_->next_in = const_cast<std::uint8_t *>(data);
 
-            if (z_ret == Z_STREAM_ERROR || z_ret == Z_NEED_DICT ||
-                z_ret == Z_DATA_ERROR || z_ret == Z_MEM_ERROR) {
-                inflateEnd(&strm);
+        int z_ret;
+        for (;;) {
+            strm_->next_out = out->data() + strm_->total_out;
+            strm_->avail_out = out->size() - strm_->total_out;
 
-                delete all_out;
-                return nullptr;
+            z_ret = ::inflate(strm_, Z_NO_FLUSH);
+            if (z_ret != Z_OK || strm_->avail_out != 0) {
+                break;
             }
 
-            all_out->insert(all_out->end(), out.begin(),
-                            out.begin() + ZLIB_IO_BUF_SIZE - strm.avail_out);
-        } while (strm.avail_out == 0);
+            out->resize(out->size() * 2);
+        }
 
         if (z_ret != Z_STREAM_END) {
+            out->clear();
+            return false;
+        }
+
+        out->resize(strm_->total_out);
+        size_hint_ = std::max<std::size_t>(size_hint_, strm_->total_out);
+
+        return true;
+    }
+
+    auto zlib_inflater::inflate(std::uint8_t const *data, std::size_t len)
+        -> std::vector<std::uint8_t> * {
+        auto *all_out = new std::vector<std::uint8_t>;
+        if (!inflate_to(data, len, all_out)) {
             delete all_out;
             return nullptr;
         }
+        return all_out;
+    }
 
-        inflateEnd(&strm);
+    auto zlib_inflater::inflate(std::uint8_t const *data, std::size_t len,
+                                std::vector<std::uint8_t> *out) -> bool {
+        return inflate_to(data, len, out);
+    }
 
-        return all_out;
+    auto zlib_inflater::inflate(std::uint8_t const *data, std::size_t len,
+                                std::pmr::vector<std::uint8_t> *out) -> bool {
+        return inflate_to(data, len, out);
+    }
+
+    auto zlib_decompress(std::uint8_t *data, std::size_t const len)
+        -> std::vector<std::uint8_t> * {
+        return zlib_inflater().inflate(data, len);
+    }
+
+    auto zlib_compress(std::uint8_t const *data, std::size_t len)
+        -> std::vector<std::uint8_t> {
+        std::vector<std::uint8_t> out(::compressBound(len));
+        ::uLongf out_len = out.size();
+        if (::compress(out.data(), &out_len, data, len) != Z_OK) {
+            return {};
+        }
+        out.resize(out_len);
+
+        return out;
     }
 
     auto gzip_file_decompress(std::filesystem::path const &path)
@@ -9,9 +9,12 @@
 #include <cstring>
 #include <filesystem>
 #include <memory>
+#include <memory_resource>
 #include <utility>
 #include <vector>
 
+struct z_stream_s;
+
 namespace pixel_terrain::nbt::utils {
     static inline void swap_chars(std::uint8_t *a, std::uint8_t *b) {
         *a ^= *b;
@@ -102,8 +105,41 @@ namespace pixel_terrain::nbt::utils {
         return src;
     }
 
+    /* zlib inflate context which can be reused for many streams, so that
+       inflate state is allocated only once. */
+    class zlib_inflater {
+        z_stream_s *strm_;
+        /* Size of the largest output so far, used as initial buffer size. */
+        std::size_t size_hint_ = 0;
+
+    public:
+        zlib_inflater();
+        ~zlib_inflater();
+
+        zlib_inflater(zlib_inflater const &) = delete;
+        auto operator=(zlib_inflater const &) -> zlib_inflater & = delete;
+
+        /* Inflate LEN bytes of zlib stream DATA.  Returns nullptr if DATA
+           is not a complete zlib stream. */
+        auto inflate(std::uint8_t const *data, std::size_t len)
+            -> std::vector<std::uint8_t> *;
+        /* Same as above, but inflate to OUT, replacing its content.
+           Returns false if DATA is not a complete zlib stream. */
+        auto inflate(std::uint8_t const *data, std::size_t len,
+                     std::vector<std::uint8_t> *out) -> bool;
+        auto inflate(std::uint8_t const *data, std::size_t len,
+                     std::pmr::vector<std::uint8_t> *out) -> bool;
+
+    private:
+        template <typename Vector>
+        auto inflate_to(std::uint8_t const *data, std::size_t len,
+                        Vector *out) -> bool;
+    };
+
     auto zlib_decompress(std::uint8_t *data, std::size_t len)
         -> std::vector<std::uint8_t> *;
+    auto zlib_compress(std::uint8_t const *data, std::size_t len)
+        -> std::vector<std::uint8_t>;
     auto gzip_file_decompress(std::filesystem::path const &path)
         -> std::vector<std::uint8_t> *;
 } // namespace pixel_terrain::nbt::utils
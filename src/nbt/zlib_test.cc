@@ -0,0 +1,61 @@
+// SPDX-License-Identifier: MIT
+
+#include <cstdint>
+#include <vector>
+
+#include <boost/test/tools/interface.hpp>
+#include <boost/test/unit_test.hpp>
+#include <boost/test/unit_test_suite.hpp>
+
+#include "nbt/utils.hh"
+
+using namespace pixel_terrain;
+
+namespace {
+    auto make_data(std::size_t size) -> std::vector<std::uint8_t> {
+        std::vector<std::uint8_t> data(size);
+        for (std::size_t i = 0; i < size; ++i) {
+            data[i] = static_cast<std::uint8_t>(i * 7 + i / 13);
+        }
+        return data;
+    }
+} // namespace
+
+BOOST_AUTO_TEST_CASE(inflater_reuse) {
+    nbt::utils::zlib_inflater inflater;
+
+    /* Large one first so that the next output is smaller than the hint,
+       then larger ones so that the buffer grows. */
+    for (std::size_t size : {100000, 10, 0, 1024, 300000}) {
+        std::vector<std::uint8_t> data = make_data(size);
+        std::vector<std::uint8_t> compressed =
+            nbt::utils::zlib_compress(data.data(), data.size());
+
+        std::vector<std::uint8_t> *result =
+            inflater.inflate(compressed.data(), compressed.size());
+        BOOST_TEST_REQUIRE(result != nullptr);
+        BOOST_TEST(*result == data);
+        delete result;
+    }
+}
+
+BOOST_AUTO_TEST_CASE(inflater_broken_input) {
+    nbt::utils::zlib_inflater inflater;
+    std::vector<std::uint8_t> data = make_data(5000);
+    std::vector<std::uint8_t> compressed =
+        nbt::utils::zlib_compress(data.data(), data.size());
+
+    /* Truncated stream. */
+    BOOST_TEST(inflater.inflate(compressed.data(), compressed.size() / 2) ==
+               nullptr);
+
+    std::vector<std::uint8_t> garbage = {1, 2, 3, 4, 5, 6};
+    BOOST_TEST(inflater.inflate(garbage.data(), garbage.size()) == nullptr);
+
+    /* Still usable after errors. */
+    std::vector<std::uint8_t> *result =
+        inflater.inflate(compressed.data(), compressed.size());
+    BOOST_TEST_REQUIRE(result != nullptr);
+    BOOST_TEST(*result == data);
+    delete result;
+}
@@ -8,6 +8,7 @@
 #include <string>
 
 #include "config.h"
+#include "logger/logger.hh"
 #include "pixel-terrain.hh"
 
 namespace {
@@ -20,8 +21,17 @@ namespace {
         {"image", {&pixel_terrain::image_main, "Generate map image."}},
         {"dump-nbt",
          {&pixel_terrain::dump_nbt_main, "Dump zlib-compressed NBT data."}},
+        {"nbt-query",
+         {&pixel_terrain::nbt_query_main,
+          "Find tags matching a query in NBT files."}},
         {"nbt-to-xml",
          {&pixel_terrain::nbt_to_xml_main, "Convert NBT data into XML."}},
+        {"renderd",
+         {&pixel_terrain::renderd_main,
+          "Render daemon accepting jobs on a socket."}},
+        {"serve-tiles",
+         {&pixel_terrain::serve_tiles_main,
+          "Serve map tiles over HTTP, rendering them on demand."}},
         {"server",
          {&pixel_terrain::server_main, "Altitude and surface block server."}},
         {"world-info",
@@ -108,5 +118,10 @@ auto main(int argc, char **argv) -> int {
         print_help_and_exit(2);
     }
 
+    /* Registered before any subcommand registers its exit handler, so that
+       logs written from those handlers are flushed. */
+    pixel_terrain::logger::start_async_output();
+    std::atexit(&pixel_terrain::logger::stop_async_output);
+
     return (subcommand->second.command_function)(argc - argoff, argv + argoff);
 }
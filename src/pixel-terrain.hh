@@ -6,7 +6,10 @@
 namespace pixel_terrain {
     auto image_main(int argc, char **argv) -> int;
     auto dump_nbt_main(int argc, char **argv) -> int;
+    auto nbt_query_main(int argc, char **argv) -> int;
     auto nbt_to_xml_main(int argc, char **argv) -> int;
+    auto renderd_main(int argc, char **argv) -> int;
+    auto serve_tiles_main(int argc, char **argv) -> int;
     auto server_main(int argc, char **argv) -> int;
     auto world_info_main(int argc, char **argv) -> int;
 } // namespace pixel_terrain
@@ -0,0 +1,199 @@
+// SPDX-License-Identifier: MIT
+
+#include <cstddef>
+#include <cstdio>
+#include <cstdlib>
+#include <filesystem>
+#include <iostream>
+#include <stdexcept>
+#include <string>
+#include <system_error>
+#include <utility>
+#include <vector>
+
+#include <regetopt.h>
+
+#include "config.h"
+#include "image/utils.hh"
+#include "logger/logger.hh"
+#include "pixel-terrain.hh"
+#ifdef OS_LINUX
+#include "server/render_server.hh"
+#endif
+#include "utils/array.hh"
+
+namespace {
+    void print_usage() {
+        std::fputs(&R"(
+usage: pixel-terrain renderd [OPTIONS...]
+  -d, --daemon              Run render daemon as daemon.
+  -s PATH, --socket=PATH    Listen on Unix socket PATH.
+                            (default: /tmp/pixel-terrain-renderd.sock)
+  -a DIR, --allow-dir=DIR   Allow requests to write output and cache in DIR.
+                            May be given more than once; at least one is
+                            required.
+  -g, --group-access        Let the group of the socket send requests too.
+                            Otherwise only the owner can.
+  -j N, --jobs=N            Generate N regions concurrently.
+      --max-memory=SIZE     Limit memory used by regions being generated to
+                            about SIZE bytes. SIZE may end with K, M or G.
+                            This is approximate: each region is estimated
+                            from its chunk sizes, and files read ahead are
+                            left to the page cache.
+  -V, --verbose             Increase log level.
+      --help                Print this usage and exit.
+
+Workers and cache journals are kept while the daemon runs, so each job
+only pays for regions it renders.  Region files are read again for each
+job, since the game rewrites them.  Jobs are run one at a time.  Send
+SIGUSR1 to stop.
+
+PROTOCOL:
+ example request and response:
+ `>' means request and `<' means response
+  >RENDER MMP/1.0
+  >World: /srv/minecraft/world
+  >Dimension: overworld
+  >Output: /srv/map/overworld
+  >Cache-Dir: /srv/map/cache
+  >
+  <MMP/1.0 200
+  <
+  <{"regions": 12, "failed": 0, "elapsed_ms": 3051}
+
+ Fields:
+  World           World directory. (required)
+  Dimension       overworld, nether or end. (default: overworld)
+  Output          Output directory or file. (required)
+  Cache-Dir       Regenerate only regions updated since last time.
+  Outname-Format  Format of output file names, as with `image -F'.
+  Label           Label of the job, shown in logs.
+  Chunks          Regenerate only the chunks, as with `image --chunks'.
+
+ Paths should be absolute, since the daemon runs in `/'.  Output and
+ Cache-Dir must be in a directory given with --allow-dir, after symbolic
+ links in them are resolved.
+
+ Response Codes:
+  200  OK. Every region of the job is written.
+  400  Bad Request. Probably request parse error.
+  403  Forbidden. Output or Cache-Dir is not in allowed directories.
+  404  Not Found. The world has no such dimension.
+  500  Internal Server Error. Some regions of the job could not be read
+       or written; "failed" tells how many.
+)"[1],
+                   stdout);
+    }
+
+    auto long_options = pixel_terrain::make_array<::re_option>(
+        ::re_option{"daemon", re_no_argument, nullptr, 'd'},
+        ::re_option{"socket", re_required_argument, nullptr, 's'},
+        ::re_option{"allow-dir", re_required_argument, nullptr, 'a'},
+        ::re_option{"group-access", re_no_argument, nullptr, 'g'},
+        ::re_option{"jobs", re_required_argument, nullptr, 'j'},
+        ::re_option{"max-memory", re_required_argument, nullptr, 'm'},
+        ::re_option{"verbose", re_no_argument, nullptr, 'V'},
+        ::re_option{"help", re_no_argument, nullptr, 'h'},
+        ::re_option{nullptr, 0, nullptr, 0});
+} // namespace
+
+namespace pixel_terrain {
+    auto renderd_main(int argc, char **argv) -> int {
+        bool daemon_mode = false;
+        std::string socket_path = "/tmp/pixel-terrain-renderd.sock";
+        unsigned int n_jobs = 1;
+        std::size_t max_memory = 0;
+        std::vector<std::filesystem::path> roots;
+        bool group_access = false;
+
+        for (;;) {
+            int opt =
+                regetopt(argc, argv, "ds:a:gj:V", long_options.data(), nullptr);
+            if (opt < 0) {
+                break;
+            }
+
+            switch (opt) {
+            case 'd':
+                daemon_mode = true;
+                break;
+
+            case 's':
+                socket_path = ::re_optarg;
+                break;
+
+            case 'a': {
+                std::error_code ec;
+                std::filesystem::path root =
+                    std::filesystem::canonical(::re_optarg, ec);
+                if (ec || !std::filesystem::is_directory(root)) {
+                    std::cout << ::re_optarg << ": Not a directory.\n";
+                    std::exit(1);
+                }
+                roots.push_back(root);
+            } break;
+
+            case 'g':
+                group_access = true;
+                break;
+
+            case 'j':
+                try {
+                    int n = std::stoi(::re_optarg);
+                    if (n < 1) {
+                        throw std::out_of_range("n_jobs");
+                    }
+                    n_jobs = n;
+                } catch (std::invalid_argument const &) {
+                    std::cout << "Invalid concurrency.\n";
+                    std::exit(1);
+                } catch (std::out_of_range const &) {
+                    std::cout << "Concurrency is out of permitted range.\n";
+                    std::exit(1);
+                }
+                break;
+
+            case 'm': {
+                auto [bytes, ok] = image::parse_memory_size(::re_optarg);
+                if (!ok) {
+                    std::cout << "Invalid memory size.\n";
+                    std::exit(1);
+                }
+                max_memory = bytes;
+            } break;
+
+            case 'V':
+                ++logger::log_level;
+                break;
+
+            case 'h':
+                print_usage();
+                std::exit(0);
+
+            default:
+                return 1;
+            }
+        }
+
+        if (argc - re_optind != 0) {
+            print_usage();
+            std::exit(1);
+        }
+        if (roots.empty()) {
+            std::cout << "No directory is allowed to write; "
+                         "give one with --allow-dir.\n";
+            std::exit(1);
+        }
+
+#ifdef OS_LINUX
+        server::set_render_roots(std::move(roots));
+        server::launch_render_server(daemon_mode, socket_path,
+                                     group_access ? 0660 : 0600, n_jobs,
+                                     max_memory);
+        return 0;
+#else
+        std::cout << "renderd is not supported on this platform.\n";
+        return 1;
+#endif
+    }
+} // namespace pixel_terrain
@@ -0,0 +1,117 @@
+// SPDX-License-Identifier: MIT
+
+#include <cstdio>
+#include <cstdlib>
+#include <iostream>
+#include <stdexcept>
+#include <string>
+#include <thread>
+
+#include <regetopt.h>
+
+#include "config.h"
+#include "logger/logger.hh"
+#include "pixel-terrain.hh"
+#ifdef OS_LINUX
+#include "server/tile_server.hh"
+#endif
+#include "utils/array.hh"
+
+namespace {
+    void print_usage() {
+        std::fputs(&R"(
+usage: pixel-terrain serve-tiles [OPTIONS...] WORLD TILES_DIR
+Serve map tiles of WORLD over HTTP on localhost, saving them to TILES_DIR.
+
+  -p PORT, --port=PORT      Listen on PORT. (default: 8080)
+  -j N, --jobs=N            Handle N requests concurrently.
+  -V, --verbose             Increase log level.
+      --help                Print this usage and exit.
+
+Tiles are served at /DIMENSION/0/X/Z.png, where DIMENSION is overworld,
+nether or end, and X and Z are region coordinates.  Tiles not yet rendered,
+or older than their region files, are rendered before being sent.  ETag of
+a tile changes whenever the game saves any chunk of the region.
+)"[1],
+                   stdout);
+    }
+
+    auto long_options = pixel_terrain::make_array<::re_option>(
+        ::re_option{"port", re_required_argument, nullptr, 'p'},
+        ::re_option{"jobs", re_required_argument, nullptr, 'j'},
+        ::re_option{"verbose", re_no_argument, nullptr, 'V'},
+        ::re_option{"help", re_no_argument, nullptr, 'h'},
+        ::re_option{nullptr, 0, nullptr, 0});
+
+    /* Parse STR as an integer from 1 to MAX, or exit with MESSAGE. */
+    auto parse_positive(char const *str, int max, char const *message)
+        -> int {
+        try {
+            int n = std::stoi(str);
+            if (n < 1 || max < n) {
+                throw std::out_of_range(message);
+            }
+            return n;
+        } catch (std::exception const &) {
+            std::cout << message << '\n';
+            std::exit(1);
+        }
+    }
+} // namespace
+
+namespace pixel_terrain {
+    auto serve_tiles_main(int argc, char **argv) -> int {
+        constexpr int MAX_PORT = 65535;
+        constexpr int MAX_JOBS = 1024;
+        int port = 8080;
+        unsigned int n_jobs = std::thread::hardware_concurrency();
+
+        for (;;) {
+            int opt =
+                regetopt(argc, argv, "p:j:V", long_options.data(), nullptr);
+            if (opt < 0) {
+                break;
+            }
+
+            switch (opt) {
+            case 'p':
+                port = parse_positive(::re_optarg, MAX_PORT, "Invalid port.");
+                break;
+
+            case 'j':
+                n_jobs = parse_positive(::re_optarg, MAX_JOBS,
+                                        "Invalid concurrency.");
+                break;
+
+            case 'V':
+                ++logger::log_level;
+                break;
+
+            case 'h':
+                print_usage();
+                std::exit(0);
+
+            default:
+                return 1;
+            }
+        }
+
+        if (argc - re_optind != 2) {
+            print_usage();
+            std::exit(1);
+        }
+
+#ifdef OS_LINUX
+        server::tile_server_options options;
+        options.world = argv[re_optind];
+        options.tiles_dir = argv[re_optind + 1];
+        options.port = static_cast<unsigned short>(port);
+        options.n_jobs = n_jobs == 0 ? 1 : n_jobs;
+        server::launch_tile_server(options);
+        return 1;
+#else
+        std::cout << "serve-tiles is not supported on this platform.\n";
+        return 1;
+#endif
+    }
+} // namespace pixel_terrain
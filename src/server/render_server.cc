@@ -0,0 +1,204 @@
+// SPDX-License-Identifier: MIT
+
+/* Server to generate map images on request.  The worker pool and cache
+   journals are kept across requests.  Region files are mapped again for
+   each request, since the game rewrites them in place while it runs, and
+   height maps are read from the cache directory as in the image
+   command. */
+
+#include <algorithm>
+#include <chrono>
+#include <cstddef>
+#include <filesystem>
+#include <mutex>
+#include <string>
+#include <system_error>
+#include <utility>
+#include <vector>
+
+#include "image/containers.hh"
+#include "image/image.hh"
+#include "image/utils.hh"
+#include "logger/logger.hh"
+#include "server/render_server.hh"
+#include "server/request.hh"
+#include "server/server_base.hh"
+#include "server/server_unix_socket.hh"
+#include "server/writer.hh"
+
+namespace pixel_terrain::server {
+    namespace {
+        constexpr int RESPONSE_OK = 200;
+        constexpr int RESPONSE_BAD_REQUEST = 400;
+        constexpr int RESPONSE_FORBIDDEN = 403;
+        constexpr int RESPONSE_NOT_FOUND = 404;
+        constexpr int RESPONSE_INTERNAL_ERROR = 500;
+
+        unsigned int generator_jobs;
+        std::size_t generator_memory;
+        std::vector<std::filesystem::path> render_roots;
+
+        /* Created on the first request, since threads don't survive
+           daemon(). */
+        image::image_generator *generator;
+        /* Requests are handled one at a time, since two of them may write
+           the same image. */
+        std::mutex generator_mutex;
+
+        void write_response_code(writer *w, int code) {
+            w->write_data("MMP/1.0 ");
+            w->write_data(code);
+            w->write_data("\r\n\r\n");
+        }
+
+        /* Make options from fields of REQ.  Return RESPONSE_OK, or the
+           response code for the first invalid field. */
+        auto parse_options(request *req, std::string const &dimen,
+                           image::options *options) -> int {
+            std::string out = req->get_request_field("Output");
+            if (out.empty()) {
+                return RESPONSE_BAD_REQUEST;
+            }
+            std::filesystem::path out_path =
+                resolve_under_roots(out, render_roots);
+            if (out_path.empty()) {
+                return RESPONSE_FORBIDDEN;
+            }
+            options->set_out_path(out_path);
+            options->set_is_nether(dimen == "nether");
+
+            std::string cache_dir = req->get_request_field("Cache-Dir");
+            if (!cache_dir.empty()) {
+                std::filesystem::path cache_path =
+                    resolve_under_roots(cache_dir, render_roots);
+                if (cache_path.empty()) {
+                    return RESPONSE_FORBIDDEN;
+                }
+                options->set_cache_dir(cache_path);
+            }
+            options->set_outname_format(
+                req->get_request_field("Outname-Format"));
+            options->set_label(req->get_request_field("Label"));
+
+            std::string chunks = req->get_request_field("Chunks");
+            if (!chunks.empty()) {
+                auto [list, ok] = image::parse_chunk_list(chunks);
+                if (!ok || list.empty()) {
+                    return RESPONSE_BAD_REQUEST;
+                }
+                options->set_chunks(std::move(list));
+            }
+            return RESPONSE_OK;
+        }
+
+        void stop_generator() {
+            std::unique_lock<std::mutex> lock(generator_mutex);
+            if (generator != nullptr) {
+                generator->finish();
+                delete generator;
+                generator = nullptr;
+            }
+        }
+    } // namespace
+
+    auto resolve_under_roots(std::string const &path,
+                             std::vector<std::filesystem::path> const &roots)
+        -> std::filesystem::path {
+        std::filesystem::path p(path);
+        if (!p.is_absolute()) {
+            return {};
+        }
+        std::error_code ec;
+        p = std::filesystem::weakly_canonical(p, ec);
+        if (ec) {
+            return {};
+        }
+
+        for (std::filesystem::path const &root : roots) {
+            /* Compare by components, so that /srv/map is not taken as a
+               parent of /srv/mapfoo. */
+            auto [r, q] = std::mismatch(root.begin(), root.end(), p.begin(),
+                                        p.end());
+            if (r == root.end()) {
+                return p;
+            }
+        }
+        return {};
+    }
+
+    void set_render_roots(std::vector<std::filesystem::path> roots) {
+        render_roots = std::move(roots);
+    }
+
+    void handle_render_request(request *req, writer *w) {
+        if (!req->parse_all() || req->get_method() != "RENDER" ||
+            req->get_protocol() != "MMP" || req->get_version() != "1.0") {
+            write_response_code(w, RESPONSE_BAD_REQUEST);
+            return;
+        }
+
+        std::string world = req->get_request_field("World");
+        std::string dimen = req->get_request_field("Dimension");
+        if (dimen.empty()) {
+            dimen = "overworld";
+        }
+        auto [dir, dimen_ok] = image::dimension_region_dir(world, dimen);
+        if (world.empty() || !dimen_ok) {
+            write_response_code(w, RESPONSE_BAD_REQUEST);
+            return;
+        }
+        image::options options;
+        if (int code = parse_options(req, dimen, &options);
+            code != RESPONSE_OK) {
+            write_response_code(w, code);
+            return;
+        }
+
+        if (!std::filesystem::is_directory(dir)) {
+            write_response_code(w, RESPONSE_NOT_FOUND);
+            return;
+        }
+
+        std::unique_lock<std::mutex> lock(generator_mutex);
+        auto start = std::chrono::steady_clock::now();
+        if (generator == nullptr) {
+            generator =
+                new image::image_generator(generator_jobs, generator_memory,
+                                           generator_jobs);
+            generator->start();
+        }
+
+        generator->add_source(dir, options);
+        std::size_t n_queued = generator->queue_sources();
+        std::size_t n_failed = generator->wait();
+
+        std::chrono::milliseconds elapsed =
+            std::chrono::duration_cast<std::chrono::milliseconds>(
+                std::chrono::steady_clock::now() - start);
+        DLOG("Rendered %zu regions of %s in %lld ms, %zu failed\n",
+             n_queued, dir.string().c_str(),
+             static_cast<long long>(elapsed.count()), n_failed);
+
+        write_response_code(w, n_failed == 0 ? RESPONSE_OK
+                                             : RESPONSE_INTERNAL_ERROR);
+        w->write_data(R"({"regions": )");
+        w->write_data(static_cast<int>(n_queued));
+        w->write_data(R"(, "failed": )");
+        w->write_data(static_cast<int>(n_failed));
+        w->write_data(R"(, "elapsed_ms": )");
+        w->write_data(static_cast<int>(elapsed.count()));
+        w->write_data("}\r\n");
+    }
+
+    void launch_render_server(bool daemon_mode, std::string const &socket_path,
+                              ::mode_t socket_mode, unsigned int n_jobs,
+                              std::size_t max_memory) {
+        generator_jobs = n_jobs;
+        generator_memory = max_memory;
+
+        server_base *s = new server_unix_socket(daemon_mode, socket_path,
+                                                &handle_render_request,
+                                                &stop_generator, socket_mode);
+        s->start_server();
+    }
+} // namespace pixel_terrain::server
@@ -0,0 +1,41 @@
+// SPDX-License-Identifier: MIT
+
+#ifndef RENDER_SERVER_HH
+#define RENDER_SERVER_HH
+
+#include <cstddef>
+#include <filesystem>
+#include <string>
+#include <vector>
+
+#include <sys/types.h>
+
+#include "server/request.hh"
+#include "server/writer.hh"
+
+namespace pixel_terrain::server {
+    /* Return PATH with symbolic links and dot components resolved, or
+       empty path if PATH is relative or not in any of ROOTS, which must
+       be canonical. */
+    auto resolve_under_roots(std::string const &path,
+                             std::vector<std::filesystem::path> const &roots)
+        -> std::filesystem::path;
+
+    /* Directories which RENDER requests may write output and cache into.
+       Requests are rejected until this is set. */
+    void set_render_roots(std::vector<std::filesystem::path> roots);
+
+    /* Generate map image for a RENDER request, and respond when all
+       regions of it are done. */
+    void handle_render_request(request *req, writer *w);
+
+    /* Serve RENDER requests on SOCKET_PATH, which is created with
+       permission SOCKET_MODE.  Regions are generated by a pool of N_JOBS
+       threads using about MAX_MEMORY bytes (or unlimited if 0), which is
+       kept across requests with caches it opened. */
+    void launch_render_server(bool daemon_mode, std::string const &socket_path,
+                              ::mode_t socket_mode, unsigned int n_jobs,
+                              std::size_t max_memory);
+} // namespace pixel_terrain::server
+
+#endif
@@ -0,0 +1,154 @@
+// SPDX-License-Identifier: MIT
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <filesystem>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include <unistd.h>
+
+#include <boost/test/tools/interface.hpp>
+#include <boost/test/unit_test.hpp>
+#include <boost/test/unit_test_suite.hpp>
+
+#include "server/reader.hh"
+#include "server/render_server.hh"
+#include "server/request.hh"
+#include "server/writer_string.hh"
+
+using namespace pixel_terrain::server;
+namespace fs = std::filesystem;
+
+namespace {
+    class string_reader : public reader {
+        std::string data_;
+        std::size_t off_ = 0;
+
+    public:
+        explicit string_reader(std::string data) : data_(std::move(data)) {}
+
+        auto fill_buffer(std::uint8_t *buf, std::size_t len, std::size_t off)
+            -> long int override {
+            if (off_ == data_.size()) {
+                return -1;
+            }
+            std::size_t n = std::min(len - off, data_.size() - off_);
+            for (std::size_t i = 0; i < n; ++i) {
+                buf[off + i] = data_[off_ + i];
+            }
+            off_ += n;
+            return static_cast<long int>(n);
+        }
+    };
+
+    /* Directory tree for a test:
+         TOP/map            allowed root
+         TOP/map/out
+         TOP/map/escape ->  TOP/other
+         TOP/mapfoo
+         TOP/other
+         TOP/world          world without region files */
+    struct test_dirs {
+        fs::path top;
+        fs::path root;
+
+        test_dirs() {
+            top = fs::temp_directory_path() /
+                  ("render_server_test." + std::to_string(::getpid()));
+            fs::create_directories(top / "map" / "out");
+            fs::create_directories(top / "mapfoo");
+            fs::create_directories(top / "other");
+            fs::create_directories(top / "world");
+            fs::create_directory_symlink(top / "other",
+                                         top / "map" / "escape");
+            root = fs::canonical(top / "map");
+            set_render_roots({root});
+        }
+
+        test_dirs(test_dirs const &) = delete;
+        auto operator=(test_dirs const &) -> test_dirs & = delete;
+
+        ~test_dirs() {
+            set_render_roots({});
+            fs::remove_all(top);
+        }
+
+        /* Response line for a RENDER request with FIELDS. */
+        [[nodiscard]] auto render(std::string const &fields) const
+            -> std::string {
+            string_reader r("RENDER MMP/1.0\r\n" + fields + "\r\n");
+            request req(&r);
+            writer_string w;
+            handle_render_request(&req, &w);
+            std::string response = w;
+            return response.substr(0, response.find("\r\n"));
+        }
+    };
+} // namespace
+
+BOOST_AUTO_TEST_CASE(render_resolve_under_roots) {
+    test_dirs d;
+    std::vector<fs::path> roots{d.root};
+
+    BOOST_TEST(resolve_under_roots((d.top / "map").string(), roots) ==
+               d.root);
+    BOOST_TEST(resolve_under_roots((d.top / "map/out").string(), roots) ==
+               d.root / "out");
+    /* Need not exist yet. */
+    BOOST_TEST(resolve_under_roots((d.top / "map/new/x.png").string(),
+                                   roots) == d.root / "new/x.png");
+
+    BOOST_TEST(resolve_under_roots((d.top / "mapfoo").string(), roots)
+                   .empty());
+    BOOST_TEST(resolve_under_roots((d.top / "map/../other").string(), roots)
+                   .empty());
+    BOOST_TEST(resolve_under_roots((d.top / "map/escape/x").string(), roots)
+                   .empty());
+    BOOST_TEST(resolve_under_roots("map/out", roots).empty());
+    BOOST_TEST(resolve_under_roots((d.top / "map/out").string(), {}).empty());
+}
+
+BOOST_AUTO_TEST_CASE(render_request_malformed) {
+    test_dirs d;
+    std::string world = "World: " + (d.top / "world").string() + "\r\n";
+    std::string out = "Output: " + (d.root / "out").string() + "\r\n";
+
+    string_reader r("GET MMP/1.0\r\n" + world + out + "\r\n");
+    request req(&r);
+    writer_string w;
+    handle_render_request(&req, &w);
+    BOOST_TEST(static_cast<std::string>(w) == "MMP/1.0 400\r\n\r\n");
+
+    BOOST_TEST(d.render(out) == "MMP/1.0 400");
+    BOOST_TEST(d.render(world) == "MMP/1.0 400");
+    BOOST_TEST(d.render(world + out + "Dimension: moon\r\n") ==
+               "MMP/1.0 400");
+    BOOST_TEST(d.render(world + out + "Chunks: x\r\n") == "MMP/1.0 400");
+}
+
+BOOST_AUTO_TEST_CASE(render_request_outside_roots) {
+    test_dirs d;
+    std::string world = "World: " + (d.top / "world").string() + "\r\n";
+
+    BOOST_TEST(d.render(world + "Output: " + (d.top / "other").string() +
+                        "\r\n") == "MMP/1.0 403");
+    BOOST_TEST(d.render(world + "Output: " +
+                        (d.top / "map/escape").string() + "\r\n") ==
+               "MMP/1.0 403");
+    BOOST_TEST(d.render(world + "Output: map/out\r\n") == "MMP/1.0 403");
+    BOOST_TEST(d.render(world + "Output: " + (d.root / "out").string() +
+                        "\r\nCache-Dir: " + (d.top / "other").string() +
+                        "\r\n") == "MMP/1.0 403");
+}
+
+BOOST_AUTO_TEST_CASE(render_request_allowed) {
+    test_dirs d;
+    /* Paths are allowed, and the world is checked next. */
+    BOOST_TEST(d.render("World: " + (d.top / "world").string() +
+                        "\r\nOutput: " + (d.root / "out").string() +
+                        "\r\nCache-Dir: " + (d.root / "cache").string() +
+                        "\r\n") == "MMP/1.0 404");
+}
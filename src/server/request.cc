@@ -3,7 +3,8 @@
 #include "server/request.hh"
 
 namespace pixel_terrain::server {
-    request::request(reader *r) : request_reader(r) {}
+    request::request(reader *r, std::size_t max_fields)
+        : request_reader(r), max_fields(max_fields) {}
 
     auto request::parse_sig(std::string const &line) -> bool {
         std::size_t start = 0;
@@ -19,6 +20,15 @@ namespace pixel_terrain::server {
 
         start = end + 1;
 
+        std::size_t space = line.find(' ', start);
+        if (space != std::string::npos) {
+            if (space == start) {
+                return false;
+            }
+            target = line.substr(start, space - start);
+            start = space + 1;
+        }
+
         for (end = start; end < line.size() && line[end] != '/'; ++end) {
         }
         if (end == line.size() || line[end] != '/') {
@@ -113,7 +123,6 @@ namespace pixel_terrain::server {
             fields[key] = val;
 
             /* should be replaced by better way to avoid attack */
-            constexpr std::size_t max_fields = 5;
             if (fields.size() > max_fields) {
                 return false;
             }
@@ -124,6 +133,8 @@ namespace pixel_terrain::server {
 
     auto request::get_method() const noexcept -> std::string { return method; }
 
+    auto request::get_target() const noexcept -> std::string { return target; }
+
     auto request::get_protocol() const noexcept -> std::string {
         return protocol;
     }
@@ -3,6 +3,8 @@
 #ifndef REQUEST_HH
 #define REQUEST_HH
 
+#include <array>
+#include <cstdint>
 #include <string>
 #include <unordered_map>
 
@@ -14,10 +16,13 @@ namespace pixel_terrain::server {
 
         static constexpr std::size_t IO_BUF_SIZE = 2048;
 
+        std::size_t max_fields;
+
         std::array<std::uint8_t, IO_BUF_SIZE> int_buf;
         std::size_t n_in_buf = 0;
 
         std::string method;
+        std::string target;
         std::string protocol;
         std::string version;
 
@@ -27,10 +32,18 @@ namespace pixel_terrain::server {
         auto read_request_line(bool *ok) -> std::string;
 
     public:
-        request(reader *r);
+        /* Requests of MMP have at most this number of fields. */
+        static constexpr std::size_t DEFAULT_MAX_FIELDS = 8;
+
+        /* Read request from R, which is rejected if it has more than
+           MAX_FIELDS fields. */
+        request(reader *r, std::size_t max_fields = DEFAULT_MAX_FIELDS);
 
         auto parse_all() -> bool;
         auto get_method() const noexcept -> std::string;
+        /* Return request target between method and protocol, as in HTTP,
+           or empty string if the request has none. */
+        auto get_target() const noexcept -> std::string;
         auto get_protocol() const noexcept -> std::string;
         auto get_version() const noexcept -> std::string;
         auto get_field_count() const noexcept -> ::size_t;
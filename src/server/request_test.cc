@@ -64,7 +64,15 @@ char const *test_request[] = {"GET MMP/1.0\r\n"
                               "\r\n",
 
                               "GET MMP/1.0\n"
-                              ""};
+                              "",
+
+                              "GET /overworld/0/1/-2.png HTTP/1.1\r\n"
+                              "Host: localhost:8080\r\n"
+                              "If-None-Match: \"0123abcd\"\r\n"
+                              "\r\n",
+
+                              "GET  HTTP/1.1\r\n"
+                              "\r\n"};
 
 class test_reader : public reader {
     std::size_t off = 0;
@@ -188,3 +196,42 @@ BOOST_AUTO_TEST_CASE(non_crlf) {
     delete req;
     delete reader;
 }
+
+BOOST_AUTO_TEST_CASE(request_target) {
+    reader *reader = new test_reader(10); // NOLINT
+    auto *req = new request(reader);
+    BOOST_TEST(req->parse_all());
+    BOOST_TEST(req->get_method() == "GET");
+    BOOST_TEST(req->get_target() == "/overworld/0/1/-2.png");
+    BOOST_TEST(req->get_protocol() == "HTTP");
+    BOOST_TEST(req->get_version() == "1.1");
+    BOOST_TEST(req->get_request_field("If-None-Match") == "\"0123abcd\"");
+    delete req;
+    delete reader;
+}
+
+BOOST_AUTO_TEST_CASE(request_empty_target) {
+    reader *reader = new test_reader(11); // NOLINT
+    auto *req = new request(reader);
+    BOOST_TEST(!req->parse_all());
+    delete req;
+    delete reader;
+}
+
+BOOST_AUTO_TEST_CASE(request_no_target) {
+    reader *reader = new test_reader(0);
+    auto *req = new request(reader);
+    BOOST_TEST(req->parse_all());
+    BOOST_TEST(req->get_target().empty());
+    delete req;
+    delete reader;
+}
+
+BOOST_AUTO_TEST_CASE(more_fields_allowed) {
+    reader *reader = new test_reader(7); // NOLINT
+    auto *req = new request(reader, 16); // NOLINT
+    BOOST_TEST(req->parse_all());
+    BOOST_TEST(req->get_field_count() == 10);
+    delete req;
+    delete reader;
+}
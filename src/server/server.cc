@@ -3,6 +3,7 @@
 /* Server to provide block id and coordinate server. */
 
 #include <algorithm>
+#include <chrono>
 #include <csignal>
 #include <cstdio>
 #include <cstdlib>
@@ -18,6 +19,7 @@
 #include <unordered_map>
 
 #include "logger/logger.hh"
+#include "logger/metrics.hh"
 #include "nbt/region.hh"
 #include "server/request.hh"
 #include "server/server.hh"
@@ -32,8 +34,25 @@ namespace pixel_terrain::server {
     std::string overworld_dir;
     std::string nether_dir;
     std::string end_dir;
+    std::string metrics_file;
 
     namespace {
+        auto request_counter() -> logger::metrics::counter & {
+            static logger::metrics::counter &c = logger::metrics::get_counter(
+                "pixel_terrain_server_requests_total", "Requests handled.");
+            return c;
+        }
+
+        auto request_latency() -> logger::metrics::histogram & {
+            static logger::metrics::histogram &h =
+                logger::metrics::get_histogram(
+                    "pixel_terrain_server_request_duration_seconds",
+                    "Time to handle a request.",
+                    {0.0001, 0.0005, 0.001, 0.005, 0.01, 0.05, 0.1, 0.5, 1,
+                     5});
+            return h;
+        }
+
         constexpr int RESPONSE_INTERNAL_SERVER_ERROR = 500;
         constexpr int RESPONSE_OK = 200;
         constexpr int RESPONSE_NOT_FOUND = 404;
@@ -226,15 +245,16 @@ namespace pixel_terrain::server {
                     break;
                 }
             } else {
-                constexpr int max_y = 255;
+                int max_y = chunk->get_max_height();
+                int min_y = chunk->get_min_height();
 
-                for (int y = max_y; y >= 0; --y) {
+                for (int y = max_y; y >= min_y; --y) {
                     std::string block =
                         chunk->get_block(x_in_chunk, y, z_in_chunk);
                     if (block == "minecraft:air" ||
                         block == "minecraft:cave_air" ||
                         block == "minecraft:void_air") {
-                        if (y == 0) {
+                        if (y == min_y) {
                             response()
                                 .set_response_code(RESPONSE_NOT_FOUND)
                                 ->write_to(w);
@@ -265,6 +285,47 @@ namespace pixel_terrain::server {
             delete r;
         }
 
+        void handle_request_internal(request *req, writer *w) {
+            req->parse_all();
+
+            if (req->get_method() != "GET" ||
+                req->get_protocol() != "MMP" ||
+                req->get_version() != "1.0") {
+                response()
+                    .set_response_code(RESPONSE_BAD_REQUEST)
+                    ->write_to(w);
+                return;
+            }
+
+            std::string dimen = req->get_request_field("Dimension");
+            if (!(dimen == "overworld" || dimen == "nether" ||
+                  dimen == "end")) {
+                response()
+                    .set_response_code(RESPONSE_BAD_REQUEST)
+                    ->write_to(w);
+                return;
+            }
+
+            int x;
+            int z;
+            try {
+                x = stoi(req->get_request_field("Coord-X"));
+                z = stoi(req->get_request_field("Coord-Z"));
+            } catch (std::invalid_argument const &) {
+                response()
+                    .set_response_code(RESPONSE_BAD_REQUEST)
+                    ->write_to(w);
+                return;
+            } catch (std::out_of_range const &) {
+                response()
+                    .set_response_code(RESPONSE_BAD_REQUEST)
+                    ->write_to(w);
+                return;
+            }
+
+            resolve_block(w, dimen, x, z);
+        }
+
     } // namespace
 
     void launch_server(bool daemon_mode) {
@@ -279,35 +340,16 @@ namespace pixel_terrain::server {
         s->start_server();
     }
 
-    void handle_request(request *req, writer *w) {
-        req->parse_all();
-
-        if (req->get_method() != "GET" || req->get_protocol() != "MMP" ||
-            req->get_version() != "1.0") {
-            response().set_response_code(RESPONSE_BAD_REQUEST)->write_to(w);
-            return;
-        }
-
-        std::string dimen = req->get_request_field("Dimension");
-        if (!(dimen == "overworld" || dimen == "nether" || dimen == "end")) {
-            response().set_response_code(RESPONSE_BAD_REQUEST)->write_to(w);
-            return;
-        }
-
-        int x;
-        int z;
-        try {
-            x = stoi(req->get_request_field("Coord-X"));
-            z = stoi(req->get_request_field("Coord-Z"));
-        } catch (std::invalid_argument const &) {
-            response().set_response_code(RESPONSE_BAD_REQUEST)->write_to(w);
-            return;
-        } catch (std::out_of_range const &) {
-            response().set_response_code(RESPONSE_BAD_REQUEST)->write_to(w);
-            return;
-        }
+    void register_metrics() {
+        request_counter();
+        request_latency();
+    }
 
-        resolve_block(w, dimen, x, z);
+    void handle_request(request *req, writer *w) {
+        auto start = std::chrono::steady_clock::now();
+        handle_request_internal(req, w);
+        request_latency().observe(std::chrono::steady_clock::now() - start);
+        request_counter().add();
     }
 
 } // namespace pixel_terrain::server
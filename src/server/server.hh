@@ -3,6 +3,7 @@
 #ifndef SERVER_HH
 #define SERVER_HH
 
+#include <chrono>
 #include <string>
 
 #include "server/request.hh"
@@ -12,6 +13,17 @@ namespace pixel_terrain::server {
     extern std::string overworld_dir;
     extern std::string nether_dir;
     extern std::string end_dir;
+    /* Write metrics to this file if not empty. */
+    extern std::string metrics_file;
+
+    /* Interval to write metrics to metrics_file. */
+    inline constexpr std::chrono::seconds METRICS_INTERVAL(10);
+
+    /* Register request metrics so that they are exported before the first
+       request arrives. */
+    void register_metrics();
+
+    using request_handler = void (*)(request *req, writer *w);
 
     void handle_request(request *req, writer *w);
     void launch_server(bool daemon_mode);
@@ -2,6 +2,7 @@
 
 #include <iostream>
 
+#include "logger/metrics.hh"
 #include "server/reader_generic.hh"
 #include "server/request.hh"
 #include "server/server.hh"
@@ -12,8 +13,16 @@ namespace pixel_terrain::server {
     server_generic::server_generic() {}
 
     void server_generic::start_server() {
+        if (!metrics_file.empty()) {
+            register_metrics();
+            logger::metrics::start_export(metrics_file, METRICS_INTERVAL);
+        }
+
         for (;;) {
-            if (std::cin.bad()) return;
+            if (std::cin.bad()) {
+                logger::metrics::stop_export();
+                return;
+            }
 
             reader *r = new reader_generic();
             request *req = new request(r);
@@ -4,6 +4,8 @@
 #include <cstring>
 #include <iostream>
 #include <mutex>
+#include <string>
+#include <utility>
 
 #include <sys/socket.h>
 #include <sys/stat.h>
@@ -19,31 +21,42 @@
 #include "server/server_unix_socket.hh"
 #include "server/writer.hh"
 #include "server/writer_unix.hh"
+#include "logger/logger.hh"
+#include "logger/metrics.hh"
 #include "utils/threaded_worker.hh"
 
 namespace pixel_terrain::server {
     namespace {
         threaded_worker<int> *worker;
         std::mutex worker_mutex;
+        std::string socket_path;
+        request_handler handler;
+        void (*on_stop)();
 
         void terminate_server() {
-            ::unlink("/tmp/mcmap.sock");
+            ::unlink(socket_path.c_str());
             std::exit(0);
         }
 
-        void handle_signals(sigset_t *sigs) {
+        void handle_signals(sigset_t sigs) {
             int sig;
             for (;;) {
-                if (::sigwait(sigs, &sig) != 0) {
+                if (::sigwait(&sigs, &sig) != 0) {
                     std::exit(1);
                 }
 
                 std::unique_lock<std::mutex> lock(worker_mutex);
                 if (sig == SIGUSR1) {
+                    /* Stop it first since it reads queue depth from the
+                       worker. */
+                    logger::metrics::stop_export();
                     if (worker != nullptr) {
                         worker->finish();
                         delete worker;
                     }
+                    if (on_stop != nullptr) {
+                        on_stop();
+                    }
                     terminate_server();
                 }
             }
@@ -57,7 +70,9 @@ namespace pixel_terrain::server {
             ::sigaddset(&sigs, SIGINT);
             ::pthread_sigmask(SIG_BLOCK, &sigs, nullptr);
 
-            std::thread t(&handle_signals, &sigs);
+            /* Pass by value; SIGS goes out of scope before the thread
+               starts waiting. */
+            std::thread t(&handle_signals, sigs);
             t.detach();
         }
 
@@ -66,7 +81,7 @@ namespace pixel_terrain::server {
             auto *req = new request(r);
             writer *w = new writer_unix(fd);
 
-            handle_request(req, w);
+            handler(req, w);
             delete w;
             delete req;
             delete r;
@@ -75,16 +90,32 @@ namespace pixel_terrain::server {
 
     } // namespace
 
-    server_unix_socket::server_unix_socket(bool const daemon)
-        : daemon_mode(daemon) {}
+    server_unix_socket::server_unix_socket(bool const daemon,
+                                           std::string socket_path,
+                                           request_handler handler,
+                                           void (*on_stop)(),
+                                           ::mode_t socket_mode)
+        : daemon_mode(daemon), socket_path_(std::move(socket_path)),
+          handler_(handler), on_stop_(on_stop), socket_mode_(socket_mode) {}
 
     void server_unix_socket::start_server() {
+        socket_path = socket_path_;
+        handler = handler_;
+        on_stop = on_stop_;
+        if (socket_path.size() >= sizeof(::sockaddr_un::sun_path)) {
+            std::cerr << "socket path is too long\n";
+            std::exit(1);
+        }
+
         if (daemon_mode) {
+            /* Log thread doesn't survive fork(). */
+            logger::stop_async_output();
             if (::daemon(0, 0) == -1) {
                 std::cerr << "cannot run in daemon mode\n";
 
                 std::exit(1);
             }
+            logger::start_async_output();
         }
 
         prepare_signel_handle_thread();
@@ -92,6 +123,15 @@ namespace pixel_terrain::server {
                                           &handle_request_unix);
         worker->start();
 
+        if (!metrics_file.empty()) {
+            register_metrics();
+            logger::metrics::add_gauge_func(
+                "pixel_terrain_server_queue_depth",
+                "Connections waiting for a worker.",
+                [] { return static_cast<double>(worker->queue_size()); });
+            logger::metrics::start_export(metrics_file, METRICS_INTERVAL);
+        }
+
         int ssock;
 
         ::sockaddr_un sa;
@@ -108,19 +148,25 @@ namespace pixel_terrain::server {
         }
 
         sa.sun_family = AF_UNIX;
-        std::strcpy(sa.sun_path, "/tmp/mcmap.sock");
-
-        if (::bind(ssock, reinterpret_cast<::sockaddr *>(&sa),
-                   sizeof(::sockaddr_un)) == -1) {
-            goto fail;
+        std::strcpy(sa.sun_path, socket_path.c_str());
+
+        {
+            /* Create the socket without more permission than SOCKET_MODE_,
+               so that nobody else can connect before chmod(). */
+            ::mode_t old_mask = ::umask(~socket_mode_ & 0777);
+            int bound = ::bind(ssock, reinterpret_cast<::sockaddr *>(&sa),
+                               sizeof(::sockaddr_un));
+            ::umask(old_mask);
+            if (bound == -1) {
+                goto fail;
+            }
         }
 
         if (::listen(ssock, 4) == -1) {
             goto fail;
         }
 
-        if (::chmod("/tmp/mcmap.sock", S_IRUSR | S_IWUSR | S_IRGRP | S_IWGRP |
-                                           S_IROTH | S_IWOTH) == -1) {
+        if (::chmod(socket_path.c_str(), socket_mode_) == -1) {
             goto fail;
         }
 
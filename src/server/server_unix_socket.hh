@@ -3,14 +3,31 @@
 #ifndef SERVER_UNIX_SOCKET_HH
 #define SERVER_UNIX_SOCKET_HH
 
+#include <string>
+
+#include <sys/types.h>
+
+#include "server/server.hh"
 #include "server/server_base.hh"
 
 namespace pixel_terrain::server {
     class server_unix_socket : public server_base {
         bool daemon_mode;
+        std::string socket_path_;
+        request_handler handler_;
+        void (*on_stop_)();
+        ::mode_t socket_mode_;
 
     public:
-        server_unix_socket(bool daemon);
+        /* Serve requests with HANDLER on Unix socket at SOCKET_PATH, which
+           is created with permission SOCKET_MODE.  If ON_STOP is not
+           nullptr, it is called on SIGUSR1 after requests being handled
+           are finished, before the server exits. */
+        server_unix_socket(bool daemon,
+                           std::string socket_path = "/tmp/mcmap.sock",
+                           request_handler handler = &handle_request,
+                           void (*on_stop)() = nullptr,
+                           ::mode_t socket_mode = 0666);
         void start_server() override;
     };
 } // namespace pixel_terrain::server
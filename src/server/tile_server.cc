@@ -0,0 +1,382 @@
+// SPDX-License-Identifier: MIT
+
+/* HTTP server of map tiles, which renders tiles of regions updated since
+   last rendered on request. */
+
+#include <algorithm>
+#include <array>
+#include <cerrno>
+#include <charconv>
+#include <chrono>
+#include <condition_variable>
+#include <csignal>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <filesystem>
+#include <mutex>
+#include <set>
+#include <string>
+#include <string_view>
+#include <system_error>
+#include <tuple>
+#include <utility>
+
+#include <fcntl.h>
+#include <netinet/in.h>
+#include <sys/sendfile.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/time.h>
+#include <unistd.h>
+#include <zlib.h>
+
+#include "image/containers.hh"
+#include "image/utils.hh"
+#include "image/worker.hh"
+#include "logger/logger.hh"
+#include "server/reader_unix.hh"
+#include "server/request.hh"
+#include "server/tile_server.hh"
+#include "server/writer_unix.hh"
+#include "utils/threaded_worker.hh"
+
+namespace pixel_terrain::server {
+    namespace {
+        /* Browsers send more header fields than MMP clients do. */
+        constexpr std::size_t MAX_HTTP_FIELDS = 64;
+        /* Header of region file: locations of chunks, followed by their
+           timestamps, updated by the game whenever it saves a chunk. */
+        constexpr std::size_t LOCATIONS_SIZE = 4096;
+        constexpr std::size_t TIMESTAMPS_SIZE = 4096;
+        /* Browsers open connections in advance which may never send a
+           request.  Without timeout they would keep workers waiting, and
+           once all workers do, no tile is served. */
+        constexpr ::time_t IO_TIMEOUT_SECONDS = 10;
+
+        tile_server_options server_options;
+        image::worker *worker;
+
+        /* Tiles being rendered.  Requests for a tile being rendered wait
+           for it rather than rendering it again. */
+        std::mutex rendering_mutex;
+        std::condition_variable rendering_cond;
+        std::set<std::filesystem::path> rendering;
+
+        auto parse_int(std::string_view str, int *result) -> bool {
+            auto [end, err] =
+                std::from_chars(str.data(), str.data() + str.size(), *result);
+            return err == std::errc() && end == str.data() + str.size();
+        }
+
+        void write_status(writer *w, int code, char const *reason) {
+            w->write_data("HTTP/1.1 ");
+            w->write_data(code);
+            w->write_data(" ");
+            w->write_data(reason);
+            w->write_data("\r\nConnection: close\r\n");
+        }
+
+        void write_empty_response(writer *w, int code, char const *reason) {
+            write_status(w, code, reason);
+            w->write_data("Content-Length: 0\r\n\r\n");
+        }
+
+        /* Make ETag from chunk timestamps of REGION_FILE.  Return false if
+           it can't be read, or its location table has no chunk. */
+        auto region_etag(std::filesystem::path const &region_file)
+            -> std::pair<std::string, bool> {
+            int fd = ::open(region_file.c_str(), O_RDONLY | O_CLOEXEC);
+            if (fd < 0) {
+                return std::make_pair("", false);
+            }
+            std::array<std::uint8_t, LOCATIONS_SIZE + TIMESTAMPS_SIZE> header;
+            ssize_t n_read = ::pread(fd, header.data(), header.size(), 0);
+            ::close(fd);
+            if (n_read != static_cast<ssize_t>(header.size())) {
+                return std::make_pair("", false);
+            }
+            auto locations_end = header.begin() + LOCATIONS_SIZE;
+            if (std::all_of(header.begin(), locations_end,
+                            [](std::uint8_t b) { return b == 0; })) {
+                return std::make_pair("", false);
+            }
+
+            std::array<char, 11> etag;
+            std::snprintf(etag.data(), etag.size(), "\"%08lx\"",
+                          ::crc32(0, &*locations_end, TIMESTAMPS_SIZE));
+            return std::make_pair(std::string(etag.data()), true);
+        }
+
+        auto is_stale(std::filesystem::path const &region_file,
+                      std::filesystem::path const &tile) -> bool {
+            std::error_code ec;
+            auto tile_time = std::filesystem::last_write_time(tile, ec);
+            if (ec) {
+                return true;
+            }
+            auto region_time =
+                std::filesystem::last_write_time(region_file, ec);
+            return ec || tile_time < region_time;
+        }
+
+        /* Render TILE from REGION_FILE.  The image is written to temporary
+           file and renamed, so that clients being sent the old one don't
+           see partially written image. */
+        auto render_tile(std::string const &dimen,
+                         std::filesystem::path const &region_file,
+                         std::filesystem::path const &tile) -> bool {
+            std::filesystem::path temp = tile;
+            temp += ".tmp";
+            std::error_code ec;
+            std::filesystem::create_directories(tile.parent_path(), ec);
+            std::filesystem::remove(temp, ec);
+
+            auto start = std::chrono::steady_clock::now();
+            image::options options;
+            options.set_is_nether(dimen == "nether");
+            image::region_container item(region_file, nullptr, options, temp);
+            if (!worker->generate_region(&item)) {
+                std::filesystem::remove(temp, ec);
+                return false;
+            }
+
+            std::filesystem::rename(temp, tile, ec);
+            if (ec) {
+                return false;
+            }
+            std::chrono::milliseconds elapsed =
+                std::chrono::duration_cast<std::chrono::milliseconds>(
+                    std::chrono::steady_clock::now() - start);
+            ILOG("Rendered %s in %lld ms\n", tile.string().c_str(),
+                 static_cast<long long>(elapsed.count()));
+            return true;
+        }
+
+        /* Render TILE if it is older than REGION_FILE.  Return false if it
+           can't be rendered. */
+        auto prepare_tile(std::string const &dimen,
+                          std::filesystem::path const &region_file,
+                          std::filesystem::path const &tile) -> bool {
+            {
+                std::unique_lock<std::mutex> lock(rendering_mutex);
+                rendering_cond.wait(
+                    lock, [&tile] { return rendering.count(tile) == 0; });
+                if (!is_stale(region_file, tile)) {
+                    return true;
+                }
+                rendering.insert(tile);
+            }
+
+            bool ok = render_tile(dimen, region_file, tile);
+            {
+                std::unique_lock<std::mutex> lock(rendering_mutex);
+                rendering.erase(tile);
+            }
+            rendering_cond.notify_all();
+            return ok;
+        }
+
+        /* Respond to REQ, and set BODY_FD to file to be sent after the
+           header, or -1 if the response has no body. */
+        void handle_tile_request(request *req, writer *w, int *body_fd,
+                                 std::size_t *body_size) {
+            *body_fd = -1;
+            if (!req->parse_all() || req->get_protocol() != "HTTP") {
+                write_empty_response(w, 400, "Bad Request");
+                return;
+            }
+            bool is_head = req->get_method() == "HEAD";
+            if (req->get_method() != "GET" && !is_head) {
+                write_status(w, 405, "Method Not Allowed");
+                w->write_data("Allow: GET, HEAD\r\n"
+                              "Content-Length: 0\r\n\r\n");
+                return;
+            }
+
+            auto [dimen, x, z, ok] = parse_tile_target(req->get_target());
+            if (!ok) {
+                write_empty_response(w, 404, "Not Found");
+                return;
+            }
+            std::string name = "r." + std::to_string(x) + "." +
+                               std::to_string(z);
+            std::filesystem::path region_file =
+                image::dimension_region_dir(server_options.world, dimen)
+                    .first /
+                (name + ".mca");
+            auto [etag, has_chunks] = region_etag(region_file);
+            if (!has_chunks) {
+                write_empty_response(w, 404, "Not Found");
+                return;
+            }
+            if (req->get_request_field("If-None-Match").find(etag) !=
+                std::string::npos) {
+                write_status(w, 304, "Not Modified");
+                w->write_data("ETag: " + etag + "\r\n\r\n");
+                return;
+            }
+
+            std::filesystem::path tile =
+                server_options.tiles_dir / dimen / (name + ".png");
+            /* The region exists, so the tile should. */
+            if (!prepare_tile(dimen, region_file, tile)) {
+                write_empty_response(w, 500, "Internal Server Error");
+                return;
+            }
+            int fd = ::open(tile.c_str(), O_RDONLY | O_CLOEXEC);
+            struct ::stat st;
+            if (fd < 0 || ::fstat(fd, &st) < 0) {
+                if (fd >= 0) {
+                    ::close(fd);
+                }
+                write_empty_response(w, 500, "Internal Server Error");
+                return;
+            }
+
+            write_status(w, 200, "OK");
+            w->write_data("Content-Type: image/png\r\n"
+                          "Cache-Control: no-cache\r\n"
+                          "Content-Length: " +
+                          std::to_string(st.st_size) +
+                          "\r\n"
+                          "ETag: " +
+                          etag + "\r\n\r\n");
+            if (is_head) {
+                ::close(fd);
+                return;
+            }
+            *body_fd = fd;
+            *body_size = st.st_size;
+        }
+
+        void send_file(int sock, int fd, std::size_t size) {
+            ::off_t off = 0;
+            while (static_cast<std::size_t>(off) < size) {
+                ssize_t n_sent = ::sendfile(sock, fd, &off, size - off);
+                if (n_sent < 0 && errno == EINTR) {
+                    continue;
+                }
+                if (n_sent <= 0) {
+                    return;
+                }
+            }
+        }
+
+        void set_io_timeout(int fd) {
+            ::timeval timeout{IO_TIMEOUT_SECONDS, 0};
+            ::setsockopt(fd, SOL_SOCKET, SO_RCVTIMEO, &timeout,
+                         sizeof(timeout));
+            ::setsockopt(fd, SOL_SOCKET, SO_SNDTIMEO, &timeout,
+                         sizeof(timeout));
+        }
+
+        void handle_connection(int const fd) {
+            /* Reading the request fails on timeout, and it is answered
+               with 400. */
+            set_io_timeout(fd);
+            reader *r = new reader_unix(fd);
+            auto *req = new request(r, MAX_HTTP_FIELDS);
+            writer *w = new writer_unix(fd);
+
+            int body_fd;
+            std::size_t body_size;
+            handle_tile_request(req, w, &body_fd, &body_size);
+            /* Header is sent when the writer is deleted. */
+            delete w;
+            if (body_fd >= 0) {
+                send_file(fd, body_fd, body_size);
+                ::close(body_fd);
+            }
+            delete req;
+            delete r;
+            ::close(fd);
+        }
+    } // namespace
+
+    auto parse_tile_target(std::string const &target)
+        -> std::tuple<std::string, int, int, bool> {
+        auto fail = std::make_tuple(std::string(), 0, 0, false);
+
+        std::string_view path(target);
+        path = path.substr(0, path.find('?'));
+        std::array<std::string_view, 4> parts;
+        for (std::string_view &part : parts) {
+            if (path.empty() || path[0] != '/') {
+                return fail;
+            }
+            path.remove_prefix(1);
+            std::size_t end = path.find('/');
+            part = path.substr(0, end);
+            path.remove_prefix(part.size());
+        }
+        if (!path.empty()) {
+            return fail;
+        }
+
+        std::string dimen(parts[0]);
+        if (!image::dimension_region_dir("", dimen).second) {
+            return fail;
+        }
+        std::string_view z_part = parts[3];
+        constexpr std::string_view suffix = ".png";
+        if (z_part.size() <= suffix.size() ||
+            z_part.substr(z_part.size() - suffix.size()) != suffix) {
+            return fail;
+        }
+        z_part.remove_suffix(suffix.size());
+
+        int zoom;
+        int x;
+        int z;
+        if (!parse_int(parts[1], &zoom) || zoom != 0 ||
+            !parse_int(parts[2], &x) || !parse_int(z_part, &z)) {
+            return fail;
+        }
+        return std::make_tuple(dimen, x, z, true);
+    }
+
+    void launch_tile_server(tile_server_options const &options) {
+        server_options = options;
+        /* Clients may close connection while a tile is being sent. */
+        std::signal(SIGPIPE, SIG_IGN);
+        worker = new image::worker;
+
+        auto *pool =
+            new threaded_worker<int>(options.n_jobs, &handle_connection);
+        pool->start();
+
+        int ssock = ::socket(AF_INET, SOCK_STREAM | SOCK_CLOEXEC, 0);
+        if (ssock == -1) {
+            std::perror("serve-tiles");
+            std::exit(1);
+        }
+        int reuse = 1;
+        ::setsockopt(ssock, SOL_SOCKET, SO_REUSEADDR, &reuse, sizeof(reuse));
+
+        ::sockaddr_in sa;
+        std::memset(&sa, 0, sizeof(sa));
+        sa.sin_family = AF_INET;
+        sa.sin_port = htons(options.port);
+        sa.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+
+        if (::bind(ssock, reinterpret_cast<::sockaddr *>(&sa), sizeof(sa)) ==
+                -1 ||
+            ::listen(ssock, SOMAXCONN) == -1) {
+            std::perror("serve-tiles");
+            ::close(ssock);
+            pool->finish();
+            delete pool;
+            return;
+        }
+        ILOG("Serving tiles on http://127.0.0.1:%d/\n",
+             static_cast<int>(options.port));
+
+        for (;;) {
+            int fd = ::accept4(ssock, nullptr, nullptr, SOCK_CLOEXEC);
+            if (fd >= 0) {
+                pool->queue_job(fd);
+            }
+        }
+    }
+} // namespace pixel_terrain::server
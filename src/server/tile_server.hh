@@ -0,0 +1,32 @@
+// SPDX-License-Identifier: MIT
+
+#ifndef TILE_SERVER_HH
+#define TILE_SERVER_HH
+
+#include <filesystem>
+#include <string>
+#include <tuple>
+
+namespace pixel_terrain::server {
+    struct tile_server_options {
+        /* World directory to read regions from. */
+        std::filesystem::path world;
+        /* Directory to save rendered tiles to, under a subdirectory for
+           each dimension. */
+        std::filesystem::path tiles_dir;
+        unsigned short port;
+        unsigned int n_jobs;
+    };
+
+    /* Parse request target of a tile in form of /DIMEN/ZOOM/X/Z.png, and
+       return dimension and region coordinate of it.  Only zoom level 0,
+       where a tile is a region, is accepted. */
+    auto parse_tile_target(std::string const &target)
+        -> std::tuple<std::string, int, int, bool>;
+
+    /* Serve tiles over HTTP on localhost.  Tiles not yet rendered, or
+       older than their regions, are rendered before being sent. */
+    void launch_tile_server(tile_server_options const &options);
+} // namespace pixel_terrain::server
+
+#endif
@@ -0,0 +1,38 @@
+// SPDX-License-Identifier: MIT
+
+#include <boost/test/tools/interface.hpp>
+#include <boost/test/unit_test.hpp>
+#include <boost/test/unit_test_suite.hpp>
+
+#include "server/tile_server.hh"
+
+using namespace pixel_terrain::server;
+
+BOOST_AUTO_TEST_CASE(parse_tile_target_normal) {
+    auto [dimen, x, z, ok] = parse_tile_target("/nether/0/-1/20.png");
+    BOOST_TEST(ok);
+    BOOST_TEST(dimen == "nether");
+    BOOST_TEST(x == -1);
+    BOOST_TEST(z == 20);
+}
+
+BOOST_AUTO_TEST_CASE(parse_tile_target_query) {
+    auto [dimen, x, z, ok] = parse_tile_target("/end/0/3/4.png?t=100");
+    BOOST_TEST(ok);
+    BOOST_TEST(dimen == "end");
+    BOOST_TEST(x == 3);
+    BOOST_TEST(z == 4);
+}
+
+BOOST_AUTO_TEST_CASE(parse_tile_target_illegal) {
+    BOOST_TEST(!std::get<3>(parse_tile_target("")));
+    BOOST_TEST(!std::get<3>(parse_tile_target("/")));
+    BOOST_TEST(!std::get<3>(parse_tile_target("/overworld/0/1/2")));
+    BOOST_TEST(!std::get<3>(parse_tile_target("/overworld/0/1/.png")));
+    BOOST_TEST(!std::get<3>(parse_tile_target("/overworld/1/1/2.png")));
+    BOOST_TEST(!std::get<3>(parse_tile_target("/overworld/0/1/2.png/")));
+    BOOST_TEST(!std::get<3>(parse_tile_target("/overworld/0/1x/2.png")));
+    BOOST_TEST(!std::get<3>(parse_tile_target("/overworld/0//2.png")));
+    BOOST_TEST(!std::get<3>(parse_tile_target("/DIM1/0/1/2.png")));
+    BOOST_TEST(!std::get<3>(parse_tile_target("overworld/0/1/2.png")));
+}
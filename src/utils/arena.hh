@@ -0,0 +1,99 @@
+// SPDX-License-Identifier: MIT
+
+#ifndef ARENA_HH
+#define ARENA_HH
+
+/* Memory resource for objects which are freed all at once. */
+
+#include <algorithm>
+#include <cstddef>
+#include <memory>
+#include <memory_resource>
+#include <optional>
+
+namespace pixel_terrain {
+    class arena {
+        /* Upstream of the monotonic resource, counting how much the
+           buffer was short of. */
+        class overflow_counter : public std::pmr::memory_resource {
+            std::size_t bytes_ = 0;
+
+            auto do_allocate(std::size_t bytes, std::size_t alignment)
+                -> void * override {
+                bytes_ += bytes;
+                return std::pmr::new_delete_resource()->allocate(bytes,
+                                                                 alignment);
+            }
+
+            void do_deallocate(void *p, std::size_t bytes,
+                               std::size_t alignment) override {
+                std::pmr::new_delete_resource()->deallocate(p, bytes,
+                                                            alignment);
+            }
+
+            [[nodiscard]] auto
+            do_is_equal(std::pmr::memory_resource const &other) const noexcept
+                -> bool override {
+                return this == &other;
+            }
+
+        public:
+            [[nodiscard]] auto bytes() const -> std::size_t { return bytes_; }
+            void clear() { bytes_ = 0; }
+        };
+
+        std::size_t size_;
+        std::unique_ptr<std::byte[]> buffer_;
+        overflow_counter overflow_;
+        std::optional<std::pmr::monotonic_buffer_resource> resource_;
+
+    public:
+        explicit arena(std::size_t initial_size)
+            : size_(initial_size),
+              buffer_(std::make_unique<std::byte[]>(initial_size)) {
+            resource_.emplace(buffer_.get(), size_, &overflow_);
+        }
+
+        arena(arena const &) = delete;
+        auto operator=(arena const &) -> arena & = delete;
+
+        [[nodiscard]] auto resource() -> std::pmr::memory_resource * {
+            return &*resource_;
+        }
+
+        [[nodiscard]] auto size() const -> std::size_t { return size_; }
+
+        /* Free everything allocated from the arena.  If the buffer was too
+           small since the last reset, it is grown to hold all of that, so
+           that the same amount of allocation is served from the buffer
+           next time. */
+        void reset() {
+            resource_.reset();
+            if (overflow_.bytes() != 0) {
+                size_ += overflow_.bytes();
+                buffer_ = std::make_unique<std::byte[]>(size_);
+                overflow_.clear();
+            }
+            resource_.emplace(buffer_.get(), size_, &overflow_);
+        }
+
+        /* Like reset(), but the buffer is shrunk to MAX_SIZE if it has
+           grown larger than that, so that a single huge allocation does
+           not keep memory for the lifetime of the arena. */
+        void trim(std::size_t max_size) {
+            resource_.reset();
+            std::size_t size =
+                std::min(size_ + overflow_.bytes(), max_size);
+            overflow_.clear();
+            if (size != size_) {
+                /* Free the old buffer before allocating the new one. */
+                buffer_.reset();
+                size_ = size;
+                buffer_ = std::make_unique<std::byte[]>(size_);
+            }
+            resource_.emplace(buffer_.get(), size_, &overflow_);
+        }
+    };
+} // namespace pixel_terrain
+
+#endif
@@ -0,0 +1,43 @@
+// SPDX-License-Identifier: MIT
+
+#include <cstddef>
+
+#include <boost/test/tools/interface.hpp>
+#include <boost/test/unit_test.hpp>
+#include <boost/test/unit_test_suite.hpp>
+
+#include "utils/arena.hh"
+
+using pixel_terrain::arena;
+
+BOOST_AUTO_TEST_CASE(arena_reset_grows_by_overflow) {
+    arena a(1024);
+    (void)a.resource()->allocate(4096, alignof(std::max_align_t));
+    BOOST_TEST(a.size() == 1024);
+
+    a.reset();
+    BOOST_TEST(a.size() >= 4096);
+
+    /* Nothing overflowed since; the size stays. */
+    std::size_t size = a.size();
+    (void)a.resource()->allocate(512, alignof(std::max_align_t));
+    a.reset();
+    BOOST_TEST(a.size() == size);
+}
+
+BOOST_AUTO_TEST_CASE(arena_trim_caps_size) {
+    arena a(1024);
+    (void)a.resource()->allocate(1024 * 1024, alignof(std::max_align_t));
+    a.trim(8192);
+    BOOST_TEST(a.size() == 8192);
+
+    /* A smaller buffer is left as is. */
+    a.trim(16384);
+    BOOST_TEST(a.size() == 8192);
+
+    /* Overflow below the cap grows the buffer like reset(). */
+    (void)a.resource()->allocate(12000, alignof(std::max_align_t));
+    a.trim(16384);
+    BOOST_TEST(a.size() > 8192);
+    BOOST_TEST(a.size() <= 16384);
+}
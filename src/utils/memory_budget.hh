@@ -0,0 +1,72 @@
+// SPDX-License-Identifier: MIT
+
+#ifndef MEMORY_BUDGET_HH
+#define MEMORY_BUDGET_HH
+
+/* Counting limit of memory used by concurrent jobs. */
+
+#include <condition_variable>
+#include <cstddef>
+#include <mutex>
+
+namespace pixel_terrain {
+    class memory_budget {
+        std::size_t limit_;
+        std::size_t used_ = 0;
+        std::mutex mtx_;
+        std::condition_variable cond_;
+
+    public:
+        /* LIMIT of 0 means unlimited. */
+        memory_budget(std::size_t limit) : limit_(limit) {}
+
+        memory_budget(memory_budget const &) = delete;
+        auto operator=(memory_budget const &) -> memory_budget & = delete;
+
+        /* Wait until BYTES can be used without exceeding the limit.  A
+           request larger than the limit is granted when nothing else is
+           in use, so that it doesn't wait forever. */
+        void acquire(std::size_t bytes) {
+            if (limit_ == 0) {
+                return;
+            }
+
+            std::unique_lock<std::mutex> lock(mtx_);
+            cond_.wait(lock, [&] {
+                return used_ == 0 || used_ + bytes <= limit_;
+            });
+            used_ += bytes;
+        }
+
+        void release(std::size_t bytes) {
+            if (limit_ == 0) {
+                return;
+            }
+
+            {
+                std::unique_lock<std::mutex> lock(mtx_);
+                used_ -= bytes;
+            }
+            cond_.notify_all();
+        }
+
+        /* Acquire memory for the lifetime of this object. */
+        class reservation {
+            memory_budget *budget_;
+            std::size_t bytes_;
+
+        public:
+            reservation(memory_budget *budget, std::size_t bytes)
+                : budget_(budget), bytes_(bytes) {
+                budget_->acquire(bytes_);
+            }
+
+            ~reservation() { budget_->release(bytes_); }
+
+            reservation(reservation const &) = delete;
+            auto operator=(reservation const &) -> reservation & = delete;
+        };
+    };
+} // namespace pixel_terrain
+
+#endif
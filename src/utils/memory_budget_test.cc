@@ -0,0 +1,71 @@
+// SPDX-License-Identifier: MIT
+
+#include <atomic>
+#include <chrono>
+#include <future>
+#include <thread>
+
+#include <boost/test/tools/interface.hpp>
+#include <boost/test/unit_test.hpp>
+#include <boost/test/unit_test_suite.hpp>
+
+#include "utils/memory_budget.hh"
+
+using pixel_terrain::memory_budget;
+
+namespace {
+    /* Long enough for a thread which is not blocked to finish. */
+    constexpr std::chrono::milliseconds SETTLE(100);
+} // namespace
+
+BOOST_AUTO_TEST_CASE(memory_budget_acquire_blocks_until_release) {
+    memory_budget budget(100);
+    budget.acquire(60);
+
+    std::atomic<bool> acquired = false;
+    std::thread t([&] {
+        budget.acquire(60);
+        acquired = true;
+    });
+    std::this_thread::sleep_for(SETTLE);
+    BOOST_TEST(!acquired);
+
+    budget.release(60);
+    t.join();
+    BOOST_TEST(acquired);
+    budget.release(60);
+}
+
+BOOST_AUTO_TEST_CASE(memory_budget_oversize_request) {
+    memory_budget budget(100);
+
+    /* Granted since nothing else is in use. */
+    auto oversize = std::async(std::launch::async, [&] {
+        budget.acquire(500);
+    });
+    BOOST_TEST_REQUIRE((oversize.wait_for(std::chrono::seconds(10)) ==
+                        std::future_status::ready));
+
+    /* Others wait until the oversize request is released. */
+    std::atomic<bool> acquired = false;
+    std::thread t([&] {
+        memory_budget::reservation r(&budget, 1);
+        acquired = true;
+    });
+    std::this_thread::sleep_for(SETTLE);
+    BOOST_TEST(!acquired);
+
+    budget.release(500);
+    t.join();
+    BOOST_TEST(acquired);
+}
+
+BOOST_AUTO_TEST_CASE(memory_budget_unlimited) {
+    memory_budget budget(0);
+    budget.acquire(1000);
+    auto second = std::async(std::launch::async, [&] {
+        budget.acquire(1000);
+    });
+    BOOST_TEST((second.wait_for(std::chrono::seconds(10)) ==
+                std::future_status::ready));
+}
@@ -0,0 +1,104 @@
+// SPDX-License-Identifier: MIT
+
+#ifndef OUTPUT_BUFFER_HH
+#define OUTPUT_BUFFER_HH
+
+/* Buffer of text written out in large blocks, which formats numbers with
+   std::to_chars instead of going through streams.  It can also keep the
+   whole text in memory, so that texts made in parallel are written out in
+   order. */
+
+#include <algorithm>
+#include <charconv>
+#include <cstddef>
+#include <cstdio>
+#include <cstring>
+#include <string_view>
+#include <vector>
+
+namespace pixel_terrain {
+    class output_buffer {
+        /* File to write to, or nullptr if text is kept in memory. */
+        std::FILE *out_;
+        std::vector<char> buf_;
+        std::size_t size_ = 0;
+
+        /* Enough for any integer or floating point number. */
+        static constexpr std::size_t MAX_NUMBER_CHARS = 32;
+
+        /* Make room for N chars, and return where they are written. */
+        auto reserve(std::size_t n) -> char * {
+            if (buf_.size() - size_ < n) {
+                if (out_ == nullptr) {
+                    buf_.resize(std::max(buf_.size() * 2, size_ + n));
+                } else {
+                    flush();
+                }
+            }
+            return buf_.data() + size_;
+        }
+
+    public:
+        static constexpr std::size_t DEFAULT_CAPACITY = 1 << 16;
+
+        explicit output_buffer(std::FILE *out,
+                               std::size_t capacity = DEFAULT_CAPACITY)
+            : out_(out), buf_(std::max(capacity, MAX_NUMBER_CHARS)) {}
+
+        /* Keep text in memory, to be taken by text(). */
+        output_buffer() : output_buffer(nullptr) {}
+
+        ~output_buffer() { flush(); }
+
+        output_buffer(output_buffer const &) = delete;
+        auto operator=(output_buffer const &) -> output_buffer & = delete;
+
+        void write(std::string_view str) {
+            if (out_ != nullptr && buf_.size() < str.size()) {
+                flush();
+                std::fwrite(str.data(), 1, str.size(), out_);
+                return;
+            }
+            std::memcpy(reserve(str.size()), str.data(), str.size());
+            size_ += str.size();
+        }
+
+        void put(char c) {
+            *reserve(1) = c;
+            ++size_;
+        }
+
+        /* Write VALUE in shortest form which reads back to the same
+           value. */
+        template <typename T> void write_number(T value) {
+            char *first = reserve(MAX_NUMBER_CHARS);
+            char *last = std::to_chars(first, first + MAX_NUMBER_CHARS, value)
+                             .ptr;
+            size_ += last - first;
+        }
+
+        /* Write VALUE as printf() does with "%.*g". */
+        template <typename T> void write_number(T value, int precision) {
+            char *first = reserve(MAX_NUMBER_CHARS);
+            char *last =
+                std::to_chars(first, first + MAX_NUMBER_CHARS, value,
+                              std::chars_format::general, precision)
+                    .ptr;
+            size_ += last - first;
+        }
+
+        /* Return text kept in memory. */
+        [[nodiscard]] auto text() const -> std::string_view {
+            return std::string_view(buf_.data(), size_);
+        }
+
+        void flush() {
+            if (out_ != nullptr && size_ != 0) {
+                std::fwrite(buf_.data(), 1, size_, out_);
+                size_ = 0;
+            }
+        }
+    };
+} // namespace pixel_terrain
+
+#endif
@@ -37,31 +37,40 @@ namespace pixel_terrain {
     template <typename T> class threaded_worker {
         unsigned int n_workers_;
         std::function<void(T)> handler_;
+        /* Maximum number of waiting jobs, or 0 for unlimited. */
+        std::size_t max_queue_size_;
 
         std::vector<std::thread *> workers_;
-        std::mutex queue_mtx_, signal_mtx_;
+        std::mutex queue_mtx_;
+        /* Notified when a job is queued or finish() is called, waited on
+           with queue_mtx_. */
         std::condition_variable signal_cond_;
+        /* Notified when a job is taken from the queue, waited on with
+           queue_mtx_. */
+        std::condition_variable space_cond_;
+        /* Notified when the last running job finishes with no job
+           waiting, waited on with queue_mtx_. */
+        std::condition_variable idle_cond_;
         bool finished_ = false;
+        /* Number of jobs being handled. */
+        unsigned int n_running_ = 0;
 
         std::queue<T> job_queue_;
 
         auto fetch_job_block() -> worker_signal<T> {
-            for (;;) {
-                std::unique_lock<std::mutex> queue_lock(queue_mtx_);
-                if (job_queue_.empty()) {
-                    if (finished_) {
-                        return worker_signal<T>(signal_type::TERMINATE);
-                    }
-                    queue_lock.unlock();
-
-                    std::unique_lock<std::mutex> signal_lock(signal_mtx_);
-                    signal_cond_.wait(signal_lock);
-                    continue;
-                }
-                T item = job_queue_.front();
-                job_queue_.pop();
-                return worker_signal<T>(signal_type::JOB, item);
+            std::unique_lock<std::mutex> queue_lock(queue_mtx_);
+            signal_cond_.wait(queue_lock, [this] {
+                return !job_queue_.empty() || finished_;
+            });
+            if (job_queue_.empty()) {
+                return worker_signal<T>(signal_type::TERMINATE);
             }
+
+            T item = job_queue_.front();
+            job_queue_.pop();
+            ++n_running_;
+            space_cond_.notify_one();
+            return worker_signal<T>(signal_type::JOB, item);
         }
 
         void handle_jobs_internal() {
@@ -73,12 +82,22 @@ namespace pixel_terrain {
                 }
 
                 handler_(sig.data());
+
+                std::unique_lock<std::mutex> lock(queue_mtx_);
+                if (--n_running_ == 0 && job_queue_.empty()) {
+                    idle_cond_.notify_all();
+                }
             }
         }
 
     public:
-        threaded_worker(unsigned int n_workers, std::function<void(T)> handler)
-            : n_workers_(n_workers), handler_(std::move(handler)) {}
+        /* If MAX_QUEUE_SIZE is not 0, queue_job() blocks while that many
+           jobs are waiting, so that producer doesn't run far ahead of
+           workers. */
+        threaded_worker(unsigned int n_workers, std::function<void(T)> handler,
+                        std::size_t max_queue_size = 0)
+            : n_workers_(n_workers), handler_(std::move(handler)),
+              max_queue_size_(max_queue_size) {}
 
         ~threaded_worker() {
             if (!workers_.empty()) {
@@ -104,20 +123,40 @@ namespace pixel_terrain {
             return true;
         }
 
+        /* Return number of jobs waiting for a worker. */
+        auto queue_size() -> std::size_t {
+            std::unique_lock<std::mutex> lock(queue_mtx_);
+            return job_queue_.size();
+        }
+
         void queue_job(T item) {
             std::unique_lock<std::mutex> lock(queue_mtx_);
+            if (max_queue_size_ != 0 && !workers_.empty()) {
+                space_cond_.wait(lock, [this] {
+                    return job_queue_.size() < max_queue_size_;
+                });
+            }
             job_queue_.push(std::move(item));
             signal_cond_.notify_one();
         }
 
+        /* Wait until all the queued jobs are done.  Workers must have been
+           started. */
+        void wait_idle() {
+            std::unique_lock<std::mutex> lock(queue_mtx_);
+            idle_cond_.wait(lock, [this] {
+                return job_queue_.empty() && n_running_ == 0;
+            });
+        }
+
         void finish() {
             {
                 std::unique_lock<std::mutex> lock(queue_mtx_);
                 finished_ = true;
             }
+            signal_cond_.notify_all();
 
             for (std::thread *th : workers_) {
-                signal_cond_.notify_all();
                 th->join();
                 delete th;
             }
@@ -0,0 +1,88 @@
+// SPDX-License-Identifier: MIT
+
+#include <atomic>
+#include <chrono>
+#include <future>
+#include <thread>
+
+#include <boost/test/tools/interface.hpp>
+#include <boost/test/unit_test.hpp>
+#include <boost/test/unit_test_suite.hpp>
+
+#include "utils/threaded_worker.hh"
+
+using pixel_terrain::threaded_worker;
+
+namespace {
+    /* Long enough for a thread which is not blocked to finish. */
+    constexpr std::chrono::milliseconds SETTLE(100);
+} // namespace
+
+BOOST_AUTO_TEST_CASE(threaded_worker_wait_idle) {
+    std::promise<void> open;
+    std::shared_future<void> gate = open.get_future().share();
+    std::atomic<int> n_done = 0;
+    threaded_worker<int> worker(2, [&](int) {
+        gate.wait();
+        ++n_done;
+    });
+    worker.start();
+    for (int i = 0; i < 4; ++i) {
+        worker.queue_job(i);
+    }
+
+    std::atomic<bool> idle = false;
+    std::thread t([&] {
+        worker.wait_idle();
+        idle = true;
+    });
+    std::this_thread::sleep_for(SETTLE);
+    BOOST_TEST(!idle);
+
+    open.set_value();
+    t.join();
+    BOOST_TEST(idle);
+    /* Jobs are done, not only taken from the queue. */
+    BOOST_TEST(n_done == 4);
+    worker.finish();
+}
+
+BOOST_AUTO_TEST_CASE(threaded_worker_bounded_queue_blocks) {
+    std::promise<void> open;
+    std::shared_future<void> gate = open.get_future().share();
+    std::promise<void> taken;
+    std::atomic<bool> first = true;
+    threaded_worker<int> worker(
+        1,
+        [&](int) {
+            if (first.exchange(false)) {
+                taken.set_value();
+            }
+            gate.wait();
+        },
+        2);
+    worker.start();
+
+    /* One job is being handled, and two are waiting. */
+    worker.queue_job(0);
+    taken.get_future().wait();
+    worker.queue_job(1);
+    worker.queue_job(2);
+    BOOST_TEST(worker.queue_size() == 2U);
+
+    std::atomic<bool> queued = false;
+    std::thread t([&] {
+        worker.queue_job(3);
+        queued = true;
+    });
+    std::this_thread::sleep_for(SETTLE);
+    BOOST_TEST(!queued);
+    BOOST_TEST(worker.queue_size() == 2U);
+
+    open.set_value();
+    t.join();
+    BOOST_TEST(queued);
+    worker.wait_idle();
+    BOOST_TEST(worker.queue_size() == 0U);
+    worker.finish();
+}
@@ -1,6 +1,7 @@
 // SPDX-License-Identifier: MIT
 
 #include <cstdio>
+#include <cstdlib>
 
 #include "utils/threaded_worker.hh"
 
@@ -60,6 +61,25 @@ namespace {
         std::puts("\r\e[JDone.");
     }
 
+    void bounded_queue_test() {
+        std::puts("Running bounded_queue_test");
+        pixel_terrain::threaded_worker<int> worker(
+            max(1, (int)std::thread::hardware_concurrency() - 1), &cb_slow,
+            4);
+        worker.start();
+
+        for (int i = 0; i < 100000; ++i) {
+            worker.queue_job(i);
+            if (worker.queue_size() > 4) {
+                std::puts("\r\e[JQueue grew beyond its limit.");
+                std::exit(1);
+            }
+        }
+
+        worker.finish();
+        std::puts("\r\e[JDone.");
+    }
+
     void few_item_test() {
         std::puts("Running few_item_test");
         pixel_terrain::threaded_worker<int> worker(
@@ -84,6 +104,7 @@ int main(void) {
     fast_test();
     slow_consumer_test();
     slow_producer_test();
+    bounded_queue_test();
     few_item_test();
     zero_item_test();
 }
@@ -1,7 +1,7 @@
 // SPDX-License-Identifier: MIT
 
+#include <algorithm>
 #include <array>
-#include <bits/ranges_algo.h>
 #include <cstdio>
 #include <cstdlib>
 #include <iostream>
@@ -67,11 +67,7 @@ namespace pixel_terrain {
             if (should_satisfy_level == 3 &&
                 parser.get_event_type() == nbt::parser_event::DATA &&
                 parser.get_tag_type() == nbt::TAG_STRING) {
-                std::string name = parser.get_string();
-                /* XXX: Avoid memory leak. (I'll rewrite NBT parser soon; this
-                        is temporary implementation) */
-                parser.next();
-                return name;
+                return std::string(parser.get_string());
             }
 
             throw std::runtime_error("Invalid level.dat");